@@ -0,0 +1,212 @@
+﻿///*****************************************************************************
+///
+/// \file       AffineTransformation.h
+/// \brief      二维仿射变换及映射表缓存
+///
+///             HomMat2D对应Halcon的HHomMat2D，可由RotationMatrix的平面分量构造。
+///             仿射变换在第一次使用时生成定点映射表并放入进程内的LRU缓存，后续帧
+///             使用相同变换时直接复用
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <memory>
+
+#include "ImageMapping.h"
+#include "RotationTransformation.h"
+
+namespace my_cv {
+
+///
+/// \brief 二维齐次仿射变换矩阵
+///
+/// 作用于图像坐标 (x, y) = (列, 行)，y轴向下，角度以逆时针为正
+///
+class HomMat2D
+{
+public:
+  ///
+  /// \brief    单位变换
+  ///
+  HomMat2D()
+    : matrix_(1, 0, 0,
+              0, 1, 0)
+  { }
+  ///
+  /// \brief    构造函数
+  /// \param    [in]  M 2*3仿射矩阵
+  ///
+  explicit HomMat2D(const cv::Matx23d& M)
+    : matrix_(M)
+  { }
+  ///
+  /// \brief    由旋转矩阵构造绕指定中心的平面变换
+  ///
+  /// 取旋转矩阵左上角2*2作为线性部分，即绕z轴旋转的平面分量
+  ///
+  /// \param    [in]  R       旋转矩阵
+  /// \param    [in]  center  旋转中心
+  ///
+  HomMat2D(const my_linear_algebra::RotationMatrix& R, const cv::Point2d& center)
+  {
+    const cv::Matx33d m = R.Matrix();
+    matrix_ = cv::Matx23d(m(0, 0), m(0, 1), center.x - m(0, 0) * center.x - m(0, 1) * center.y,
+                          m(1, 0), m(1, 1), center.y - m(1, 0) * center.x - m(1, 1) * center.y);
+  }
+  ///
+  /// \brief    在当前变换之后追加绕(Px, Py)的旋转
+  /// \param    [in]  Phi 旋转角度（弧度）
+  ///
+  HomMat2D Rotate(const double Phi, const double Px, const double Py) const
+  {
+    const double c = std::cos(Phi);
+    const double s = std::sin(Phi);
+    const HomMat2D R(cv::Matx23d(c, s, Px - c * Px - s * Py,
+                                 -s, c, Py + s * Px - c * Py));
+    return R.Compose(*this);
+  }
+  ///
+  /// \brief    在当前变换之后追加平移
+  ///
+  HomMat2D Translate(const double Tx, const double Ty) const
+  {
+    return HomMat2D(cv::Matx23d(1, 0, Tx,
+                                0, 1, Ty)).Compose(*this);
+  }
+  ///
+  /// \brief    在当前变换之后追加以(Px, Py)为中心的缩放
+  ///
+  HomMat2D Scale(const double Sx, const double Sy, const double Px, const double Py) const
+  {
+    return HomMat2D(cv::Matx23d(Sx, 0, Px - Sx * Px,
+                                0, Sy, Py - Sy * Py)).Compose(*this);
+  }
+  ///
+  /// \brief    复合变换，先作用right再作用this
+  ///
+  HomMat2D Compose(const HomMat2D& right) const
+  {
+    const cv::Matx23d& a = matrix_;
+    const cv::Matx23d& b = right.matrix_;
+    return HomMat2D(cv::Matx23d(
+      a(0, 0) * b(0, 0) + a(0, 1) * b(1, 0), a(0, 0) * b(0, 1) + a(0, 1) * b(1, 1),
+      a(0, 0) * b(0, 2) + a(0, 1) * b(1, 2) + a(0, 2),
+      a(1, 0) * b(0, 0) + a(1, 1) * b(1, 0), a(1, 0) * b(0, 1) + a(1, 1) * b(1, 1),
+      a(1, 0) * b(0, 2) + a(1, 1) * b(1, 2) + a(1, 2)));
+  }
+  ///
+  /// \brief    逆变换
+  ///
+  HomMat2D Invert() const
+  {
+    const cv::Matx23d& m = matrix_;
+    const double det = m(0, 0) * m(1, 1) - m(0, 1) * m(1, 0);
+    if (std::fabs(det) < DBL_EPSILON)
+      CV_Error(cv::Error::StsBadArg, "HomMat2D is singular");
+
+    const double a = m(1, 1) / det, b = -m(0, 1) / det;
+    const double c = -m(1, 0) / det, d = m(0, 0) / det;
+    return HomMat2D(cv::Matx23d(a, b, -a * m(0, 2) - b * m(1, 2),
+                                c, d, -c * m(0, 2) - d * m(1, 2)));
+  }
+  ///
+  /// \brief    变换一个点
+  ///
+  cv::Point2d AffineTransPoint(const cv::Point2d& p) const
+  {
+    return cv::Point2d(matrix_(0, 0) * p.x + matrix_(0, 1) * p.y + matrix_(0, 2),
+                       matrix_(1, 0) * p.x + matrix_(1, 1) * p.y + matrix_(1, 2));
+  }
+
+  const cv::Matx23d& Matrix() const { return matrix_; }
+
+private:
+  cv::Matx23d matrix_;  ///< 2*3仿射矩阵
+};
+
+class AffineMapRunner : public cv::ParallelLoopBody
+{
+public:
+  AffineMapRunner(const cv::Matx23d& _inverse, FixedPointMap& _map)
+    : inverse(_inverse), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const cv::Matx23d& m = inverse;
+    for (int i = range.start; i < range.end; i++)
+    {
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      const double x0 = m(0, 1) * i + m(0, 2);
+      const double y0 = m(1, 1) * i + m(1, 2);
+      for (int j = 0; j < map.xy.cols; j++)
+        StoreMapEntry(x0 + m(0, 0) * j, y0 + m(1, 0) * j, xy + 2 * j, frac + j);
+    }
+  }
+
+private:
+  cv::Matx23d inverse;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    生成仿射变换的定点映射表
+/// \param    [in]  HomMat    源图像到目标图像的变换
+/// \param    [in]  src_size  源图像尺寸
+/// \param    [in]  dst_size  目标图像尺寸
+///
+static FixedPointMap GenAffineMap(const HomMat2D& HomMat, const cv::Size& src_size,
+                                  const cv::Size& dst_size)
+{
+  CV_Assert(src_size.width < SHRT_MAX && src_size.height < SHRT_MAX);
+
+  FixedPointMap map;
+  map.src_size = src_size;
+  map.xy.create(dst_size, CV_16SC2);
+  map.frac.create(dst_size, CV_16UC1);
+  cv::parallel_for_(cv::Range(0, dst_size.height),
+                    AffineMapRunner(HomMat.Invert().Matrix(), map),
+                    dst_size.area() / (double)(1 << 16));
+  return map;
+}
+
+struct AffineMapKey
+{
+  cv::Matx23d matrix;
+  cv::Size src_size;
+  cv::Size dst_size;
+
+  bool operator == (const AffineMapKey& other) const
+  {
+    return matrix == other.matrix && src_size == other.src_size && dst_size == other.dst_size;
+  }
+};
+
+typedef FixedPointMapCache<AffineMapKey> AffineMapCache;
+
+///
+/// \brief    从缓存获取仿射变换的映射表，未命中时生成
+///
+static std::shared_ptr<const FixedPointMap> CachedAffineMap(const HomMat2D& HomMat,
+                                                            const cv::Size& src_size,
+                                                            const cv::Size& dst_size)
+{
+  const AffineMapKey key = { HomMat.Matrix(), src_size, dst_size };
+  return AffineMapCache::Instance().Get(key, [&]() {
+    return GenAffineMap(HomMat, src_size, dst_size);
+  });
+}
+
+} // my_cv
@@ -0,0 +1,270 @@
+﻿///*****************************************************************************
+///
+/// \file       AsyncImageWriter.h
+/// \brief      异步图像写入
+///
+///             检测线程只把图像和文件名放入有界队列，由后台工作线程编码并写盘，避免
+///             成批保存NG图时阻塞检测线程导致丢触发。队列满时可选择等待、丢弃新图像
+///             或丢弃最旧的图像；各格式的编码参数可单独设置，并统计队列深度、丢弃数
+///             和写入延时
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LosslessCodec.h"
+#include "RawImageFile.h"
+
+namespace my_cv {
+
+///
+/// \brief 队列满时的处理方式
+///
+enum WriterOverflow
+{
+  kWriterBlock,       ///< 提交线程等待队列有空位
+  kWriterDropNewest,  ///< 丢弃正在提交的图像
+  kWriterDropOldest   ///< 丢弃队列中最旧的图像
+};
+
+struct AsyncWriterParams
+{
+  AsyncWriterParams()
+    : queue_capacity(64), workers(2), overflow(kWriterDropNewest)
+  {
+    // Fast PNG compression, the default level 3 costs several times more CPU for a few percent
+    format_params[".png"] = std::vector<int>{ cv::IMWRITE_PNG_COMPRESSION, 1 };
+    format_params[".jpg"] = std::vector<int>{ cv::IMWRITE_JPEG_QUALITY, 95 };
+  }
+
+  size_t queue_capacity;   ///< 队列中等待写入的最大图像数
+  int workers;             ///< 工作线程数
+  WriterOverflow overflow;
+  /// 按小写扩展名（如".png"）设置的cv::imwrite参数
+  std::map<std::string, std::vector<int> > format_params;
+};
+
+///
+/// \brief 写入统计，延时从提交开始计算到文件写完
+///
+struct AsyncWriterMetrics
+{
+  AsyncWriterMetrics()
+    : queue_depth(0), max_queue_depth(0), submitted(0), written(0), dropped(0), failed(0),
+      mean_latency_ms(0), max_latency_ms(0)
+  { }
+
+  size_t queue_depth;      ///< 当前等待写入的图像数
+  size_t max_queue_depth;
+  uint64_t submitted;
+  uint64_t written;
+  uint64_t dropped;        ///< 因队列满被丢弃的图像数
+  uint64_t failed;         ///< 编码或写文件失败的图像数
+  double mean_latency_ms;
+  double max_latency_ms;
+};
+
+///
+/// \brief 有界队列加工作线程的异步图像写入器，析构时写完队列中的全部图像
+///
+class AsyncImageWriter
+{
+public:
+  explicit AsyncImageWriter(const AsyncWriterParams& params = AsyncWriterParams())
+    : params_(params), busy_(0), closed_(false), latency_sum_ms_(0)
+  {
+    CV_Assert(params_.queue_capacity > 0 && params_.workers > 0);
+    for (int k = 0; k < params_.workers; k++)
+      workers_.push_back(std::thread(&AsyncImageWriter::Work, this));
+  }
+
+  ~AsyncImageWriter()
+  {
+    Close();
+  }
+
+  ///
+  /// \brief    提交图像
+  ///
+  /// 写入器持有image的引用而不复制像素，提交后调用者不应再原地修改该图像
+  ///
+  /// \param    [in]  storage  image引用外部内存时持有该内存的对象
+  /// \return   图像被丢弃或写入器已关闭时返回false
+  ///
+  bool Submit(const std::string& file_name, const cv::Mat& image,
+              const std::shared_ptr<const void>& storage = std::shared_ptr<const void>())
+  {
+    CV_Assert(!image.empty());
+    Job job;
+    job.file_name = file_name;
+    job.image = image;
+    job.storage = storage;
+    job.submitted = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closed_)
+      return false;
+    metrics_.submitted++;
+    if (queue_.size() >= params_.queue_capacity)
+    {
+      if (params_.overflow == kWriterBlock)
+        not_full_.wait(lock, [this] { return closed_ || queue_.size() < params_.queue_capacity; });
+      else if (params_.overflow == kWriterDropOldest)
+      {
+        queue_.pop_front();
+        metrics_.dropped++;
+      }
+      else
+      {
+        metrics_.dropped++;
+        return false;
+      }
+      if (closed_)
+        return false;
+    }
+    queue_.push_back(job);
+    metrics_.max_queue_depth = std::max(metrics_.max_queue_depth, queue_.size());
+    not_empty_.notify_one();
+    return true;
+  }
+
+  ///
+  /// \brief    等待队列中和正在写入的图像全部写完
+  ///
+  void Flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && busy_ == 0; });
+  }
+
+  ///
+  /// \brief    写完队列中的图像并结束工作线程，之后的提交返回false
+  ///
+  void Close()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_)
+        return;
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+    for (size_t k = 0; k < workers_.size(); k++)
+      workers_[k].join();
+    workers_.clear();
+  }
+
+  AsyncWriterMetrics Metrics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AsyncWriterMetrics metrics = metrics_;
+    metrics.queue_depth = queue_.size();
+    const uint64_t finished = metrics.written + metrics.failed;
+    metrics.mean_latency_ms = finished > 0 ? latency_sum_ms_ / finished : 0;
+    return metrics;
+  }
+
+  ///
+  /// \brief    同步写文件，.simg为原生图像文件，.simz为无损压缩文件，
+  ///           其他格式使用params中对应扩展名的参数
+  ///
+  static bool WriteImageFile(const std::string& file_name, const cv::Mat& image,
+                             const AsyncWriterParams& params)
+  {
+    // Any exception, including bad_alloc from the encoders, counts as a failed write
+    try
+    {
+      if (IsRawImageFile(file_name))
+        return WriteRawImage(file_name, image, NULL);
+      if (IsLosslessImageFile(file_name))
+        return WriteLosslessImage(file_name, image);
+      std::map<std::string, std::vector<int> >::const_iterator it =
+        params.format_params.find(ImageFileExtension(file_name));
+      return it != params.format_params.end() ? cv::imwrite(file_name, image, it->second)
+                                              : cv::imwrite(file_name, image);
+    }
+    catch (...)
+    {
+      return false;
+    }
+  }
+
+private:
+  struct Job
+  {
+    std::string file_name;
+    cv::Mat image;
+    std::shared_ptr<const void> storage;
+    std::chrono::steady_clock::time_point submitted;
+  };
+
+  AsyncImageWriter(const AsyncImageWriter&);
+  AsyncImageWriter& operator=(const AsyncImageWriter&);
+
+  void Work()
+  {
+    for (;;)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+        if (queue_.empty())
+          return;
+        job = queue_.front();
+        queue_.pop_front();
+        busy_++;
+      }
+      not_full_.notify_one();
+
+      const bool ok = WriteImageFile(job.file_name, job.image, params_);
+      const double latency_ms = std::chrono::duration<double, std::milli>(
+                                  std::chrono::steady_clock::now() - job.submitted).count();
+      // Release the pixels before reporting completion so that Flush implies they are unused
+      job = Job();
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      (ok ? metrics_.written : metrics_.failed)++;
+      latency_sum_ms_ += latency_ms;
+      metrics_.max_latency_ms = std::max(metrics_.max_latency_ms, latency_ms);
+      busy_--;
+      if (queue_.empty() && busy_ == 0)
+        idle_.notify_all();
+    }
+  }
+
+  const AsyncWriterParams params_;
+  std::vector<std::thread> workers_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::condition_variable idle_;
+  std::deque<Job> queue_;
+  int busy_;                ///< Jobs taken by workers and not finished
+  bool closed_;
+  AsyncWriterMetrics metrics_;
+  double latency_sum_ms_;
+};
+
+} // my_cv
@@ -0,0 +1,235 @@
+﻿///*****************************************************************************
+///
+/// \file       AutoThreshold.h
+/// \brief      由灰度直方图自动确定阈值
+///
+///             提供Otsu（最大类间方差）、Triangle及平滑直方图极小值分割，阈值只在
+///             [lo, hi]灰度带内计算，可用于threshold2的带阈值自动模式
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "GrayStatistics.h"
+#include "SRegion.h"
+
+namespace my_cv {
+
+///
+/// \brief    Otsu阈值
+/// \param    [in]  histogram  256级直方图
+/// \param    [in]  lo         灰度带下限
+/// \param    [in]  hi         灰度带上限
+/// \return   暗类的最大灰度t，暗类为[lo, t]，亮类为[t + 1, hi]
+///
+static int OtsuThreshold(const int64_t* histogram, const int lo, const int hi)
+{
+  double n = 0, sum = 0;
+  for (int g = lo; g <= hi; g++)
+  {
+    n += (double)histogram[g];
+    sum += (double)histogram[g] * g;
+  }
+  if (n == 0)
+    return lo;
+
+  const double mu = sum / n;
+  double q1 = 0, m1 = 0, best = -1;
+  int t = lo;
+  for (int g = lo; g < hi; g++)
+  {
+    const double p = histogram[g] / n;
+    q1 += p;
+    m1 += g * p;
+    const double q2 = 1 - q1;
+    if (q1 < FLT_EPSILON || q2 < FLT_EPSILON)
+      continue;
+    const double d = m1 / q1 - (mu - m1) / q2;
+    const double sigma = q1 * q2 * d * d;
+    if (sigma > best)
+    {
+      best = sigma;
+      t = g;
+    }
+  }
+  return t;
+}
+
+///
+/// \brief    Triangle阈值，适合单峰且目标占比很小的直方图
+/// \return   暗类的最大灰度t
+///
+static int TriangleThreshold(const int64_t* histogram, const int lo, const int hi)
+{
+  int left = lo, right = hi;
+  while (left < hi && histogram[left] == 0)
+    left++;
+  while (right > lo && histogram[right] == 0)
+    right--;
+  if (left >= right)
+    return left;
+
+  int peak = left;
+  for (int g = left; g <= right; g++)
+    if (histogram[g] > histogram[peak])
+      peak = g;
+
+  // The triangle is spanned towards the longer tail of the histogram
+  const bool flip = peak - left > right - peak;
+  const int end = flip ? left : right;
+  const double dx = end - peak;
+  const double dy = -(double)histogram[peak];
+  const int step = flip ? -1 : 1;
+
+  double best = -1;
+  int t = peak;
+  for (int g = peak; g != end; g += step)
+  {
+    const double distance = dy * (g - peak) - dx * ((double)histogram[g] - histogram[peak]);
+    if (std::fabs(distance) > best)
+    {
+      best = std::fabs(distance);
+      t = g;
+    }
+  }
+  return flip ? t - 1 : t;
+}
+
+///
+/// \brief    高斯平滑直方图后取极小值作为分割阈值
+/// \param    [in]  Sigma  平滑的高斯标准差（灰度级）
+/// \return   升序排列的阈值，第k类为(t[k - 1], t[k]]
+///
+static std::vector<int> HistogramMinima(const int64_t* histogram, const double Sigma)
+{
+  std::vector<double> smooth(kGrayLevels, 0.0);
+  const int radius = std::max(1, cvCeil(3 * Sigma));
+  std::vector<double> kernel(2 * radius + 1);
+  for (int k = -radius; k <= radius; k++)
+    kernel[k + radius] = Sigma > 0 ? std::exp(-0.5 * k * k / (Sigma * Sigma)) : (k == 0);
+  for (int g = 0; g < kGrayLevels; g++)
+  {
+    double s = 0, w = 0;
+    for (int k = -radius; k <= radius; k++)
+    {
+      const int x = g + k;
+      if (x < 0 || x >= kGrayLevels)
+        continue;
+      s += kernel[k + radius] * histogram[x];
+      w += kernel[k + radius];
+    }
+    smooth[g] = s / w;
+  }
+
+  int first = 0, last = kGrayLevels - 1;
+  while (first < last && histogram[first] == 0)
+    first++;
+  while (last > first && histogram[last] == 0)
+    last--;
+
+  // A minimum is the centre of a plateau that is lower than both neighbours
+  std::vector<int> minima;
+  int g = first + 1;
+  while (g < last)
+  {
+    if (smooth[g] < smooth[g - 1])
+    {
+      int plateau = g;
+      while (plateau + 1 < last && smooth[plateau + 1] == smooth[g])
+        plateau++;
+      if (plateau + 1 <= last && smooth[plateau + 1] > smooth[g])
+        minima.push_back((g + plateau) / 2);
+      g = plateau + 1;
+    }
+    else
+    {
+      g++;
+    }
+  }
+  return minima;
+}
+
+class GrayClassRegionsRunner : public cv::ParallelLoopBody
+{
+public:
+  GrayClassRegionsRunner(const cv::Mat& _image, const std::vector<int>& _lut, int _stripe_rows,
+                         std::vector<std::vector<std::vector<RegionRun> > >& _stripes)
+    : image(_image), lut(_lut), stripe_rows(_stripe_rows), stripes(_stripes)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int s = range.start; s < range.end; s++)
+    {
+      std::vector<std::vector<RegionRun> >& classes = stripes[s];
+      const int row1 = std::min(image.rows, (s + 1) * stripe_rows);
+      for (int i = s * stripe_rows; i < row1; i++)
+      {
+        const uchar* p = image.ptr<uchar>(i);
+        int j = 0;
+        while (j < image.cols)
+        {
+          const int c = lut[p[j]];
+          const int begin = j;
+          while (j < image.cols && lut[p[j]] == c)
+            j++;
+          if (c >= 0)
+          {
+            const RegionRun run = { i, begin, j };
+            classes[c].push_back(run);
+          }
+        }
+      }
+    }
+  }
+
+private:
+  cv::Mat image;
+  const std::vector<int>& lut;
+  int stripe_rows;
+  std::vector<std::vector<std::vector<RegionRun> > >& stripes;
+};
+
+///
+/// \brief    按灰度类别查找表将图像一次遍历分成多个区域
+/// \param    [in]  image     CV_8UC1图像
+/// \param    [in]  lut       256项，灰度对应的类别序号，-1表示不属于任何类别
+/// \param    [in]  nclasses  类别数
+///
+static std::vector<SRegion> GrayClassRegions(const cv::Mat& image, const std::vector<int>& lut,
+                                             const int nclasses)
+{
+  CV_Assert(image.type() == CV_8UC1 && (int)lut.size() == kGrayLevels);
+
+  const int stripe_rows = 64;
+  const int nstripes = (image.rows + stripe_rows - 1) / stripe_rows;
+  std::vector<std::vector<std::vector<RegionRun> > > stripes(
+    nstripes, std::vector<std::vector<RegionRun> >(nclasses));
+  cv::parallel_for_(cv::Range(0, nstripes),
+                    GrayClassRegionsRunner(image, lut, stripe_rows, stripes));
+
+  std::vector<SRegion> regions(nclasses);
+  std::vector<std::vector<RegionRun> > parts(nstripes);
+  for (int c = 0; c < nclasses; c++)
+  {
+    for (int s = 0; s < nstripes; s++)
+      parts[s].swap(stripes[s][c]);
+    regions[c] = SRegion(ConcatRuns(parts));
+  }
+  return regions;
+}
+
+} // my_cv
@@ -0,0 +1,363 @@
+﻿///*****************************************************************************
+///
+/// \file       Camera.h
+/// \brief      相机采集抽象与模拟相机
+///
+///             Camera在后台线程中连续采集到N个复用的缓冲中，GrabImageAsync取出
+///             已采集完的帧，使曝光和传输与图像处理重叠进行。每帧带有帧号和时间戳，
+///             帧号不连续表示丢帧。具体相机只需实现打开、关闭和等待一帧三个接口；
+///             SimulatedCamera按设定帧率循环输出文件或生成的图案，用于没有相机时
+///             对整个流程做压力测试
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ImageSequence.h"
+
+namespace my_cv {
+
+///
+/// \brief 采集到的一帧
+///
+struct CameraFrame
+{
+  CameraFrame()
+    : frame_number(0)
+  { }
+
+  cv::Mat image;
+  std::shared_ptr<const void> storage;  ///< 采集缓冲，释放后缓冲回到相机
+  uint64_t frame_number;                ///< 从1开始，包括丢弃的帧
+  std::chrono::steady_clock::time_point timestamp;  ///< 采集完成的时间
+};
+
+struct CameraMetrics
+{
+  CameraMetrics()
+    : grabbed(0), delivered(0), overwritten(0), lost(0)
+  { }
+
+  uint64_t grabbed;      ///< 相机输出的帧数
+  uint64_t delivered;    ///< GrabImageAsync取走的帧数
+  uint64_t overwritten;  ///< 未被取走即被新帧替换的帧数
+  uint64_t lost;         ///< 所有缓冲都被占用而无处存放的帧数
+};
+
+///
+/// \brief 相机基类
+///
+/// 派生类的析构函数必须调用Close，以便在派生部分析构前停止采集线程
+///
+class Camera
+{
+public:
+  explicit Camera(const int buffer_count)
+    : buffer_count_(buffer_count), pool_(std::make_shared<FrameBufferPool>(buffer_count)),
+      opened_(false), running_(false), frame_number_(0)
+  {
+    CV_Assert(buffer_count >= 2);
+  }
+
+  virtual ~Camera()
+  {
+    CV_DbgAssert(!running_);
+  }
+
+  bool Open()
+  {
+    std::lock_guard<std::mutex> lock(control_);
+    return OpenLocked();
+  }
+
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(control_);
+    GrabStopLocked();
+    if (opened_)
+      CloseDevice();
+    opened_ = false;
+  }
+
+  ///
+  /// \brief    开始连续采集，可由多个线程同时调用
+  ///
+  bool GrabStart()
+  {
+    std::lock_guard<std::mutex> lock(control_);
+    if (running_)
+      return true;
+    if (!OpenLocked())
+      return false;
+    running_ = true;
+    thread_ = std::thread(&Camera::Acquire, this);
+    return true;
+  }
+
+  ///
+  /// \brief    停止采集并丢弃还未取走的帧
+  ///
+  void GrabStop()
+  {
+    std::lock_guard<std::mutex> lock(control_);
+    GrabStopLocked();
+  }
+
+  ///
+  /// \brief    取最早的已采集帧，未开始采集时自动开始
+  /// \param    [in]  timeout_ms  等待时间，负数表示一直等待
+  /// \return   超时、相机无法打开或采集被停止时返回false
+  ///
+  bool GrabImageAsync(CameraFrame& frame, const int timeout_ms)
+  {
+    if (!running_ && !GrabStart())
+      return false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto has_frame = [this] { return !ready_.empty() || !running_; };
+    if (timeout_ms < 0)
+      arrived_.wait(lock, has_frame);
+    else if (!arrived_.wait_for(lock, std::chrono::milliseconds(timeout_ms), has_frame))
+      return false;
+    // Woken by GrabStop or Close
+    if (ready_.empty())
+      return false;
+    frame = ready_.front();
+    ready_.pop_front();
+    metrics_.delivered++;
+    return true;
+  }
+
+  ///
+  /// \brief    丢弃已采集的帧，等待调用之后完成采集的新帧
+  ///
+  bool GrabImage(CameraFrame& frame, const int timeout_ms)
+  {
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.clear();
+    }
+    while (GrabImageAsync(frame, timeout_ms))
+      if (frame.timestamp >= start)
+        return true;
+    return false;
+  }
+
+  CameraMetrics Metrics() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return metrics_;
+  }
+
+protected:
+  virtual bool OpenDevice() = 0;
+  virtual void CloseDevice() = 0;
+
+  ///
+  /// \brief    等待相机输出下一帧并写入buffer，buffer可能已有上一次的尺寸和类型
+  /// \return   timeout_ms内没有新帧时返回false
+  ///
+  virtual bool WaitFrame(cv::Mat& buffer, const int timeout_ms) = 0;
+
+private:
+  Camera(const Camera&);
+  Camera& operator=(const Camera&);
+
+  bool OpenLocked()
+  {
+    if (!opened_)
+      opened_ = OpenDevice();
+    return opened_;
+  }
+
+  void GrabStopLocked()
+  {
+    if (!running_)
+      return;
+    running_ = false;
+    thread_.join();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.clear();
+    }
+    arrived_.notify_all();
+  }
+
+  void Acquire()
+  {
+    cv::Mat scratch;
+    while (running_)
+    {
+      std::shared_ptr<cv::Mat> buffer = pool_->TryTake(buffer_count_);
+      if (!buffer)
+      {
+        // Recycle the oldest frame nobody has taken yet
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!ready_.empty())
+        {
+          ready_.pop_front();
+          metrics_.overwritten++;
+        }
+      }
+      if (!buffer)
+        buffer = pool_->TryTake(buffer_count_);
+
+      // Poll so that GrabStop is noticed within the timeout
+      cv::Mat& target = buffer ? *buffer : scratch;
+      if (!WaitFrame(target, 100))
+        continue;
+
+      CameraFrame frame;
+      frame.frame_number = ++frame_number_;
+      frame.timestamp = std::chrono::steady_clock::now();
+      std::lock_guard<std::mutex> lock(mutex_);
+      metrics_.grabbed++;
+      if (!buffer)
+      {
+        metrics_.lost++;
+        continue;
+      }
+      frame.image = *buffer;
+      frame.storage = buffer;
+      ready_.push_back(frame);
+      arrived_.notify_one();
+    }
+  }
+
+  const int buffer_count_;
+  std::shared_ptr<FrameBufferPool> pool_;
+  std::mutex control_;     ///< Serializes Open, Close, GrabStart and GrabStop
+  bool opened_;
+  std::atomic<bool> running_;
+  std::thread thread_;
+  uint64_t frame_number_;  ///< Acquisition thread only
+
+  mutable std::mutex mutex_;
+  std::condition_variable arrived_;
+  std::deque<CameraFrame> ready_;
+  CameraMetrics metrics_;
+};
+
+///
+/// \brief 模拟相机，循环输出一组图像文件，没有文件时输出随帧号移动的灰度图案
+///
+class SimulatedCamera : public Camera
+{
+public:
+  ///
+  /// \param    [in]  files         图像文件，打开时全部读入内存；为空时生成图案
+  /// \param    [in]  fps           帧率，不大于0时尽快输出
+  /// \param    [in]  size          图案尺寸
+  /// \param    [in]  type          图案类型，CV_8U或CV_16U，1或3通道
+  /// \param    [in]  buffer_count  采集缓冲数
+  ///
+  SimulatedCamera(const std::vector<std::string>& files, const double fps,
+                  const cv::Size& size = cv::Size(2448, 2048), const int type = CV_8UC1,
+                  const int buffer_count = 4)
+    : Camera(buffer_count), files_(files), fps_(fps), size_(size), type_(type), next_(0)
+  { }
+
+  ~SimulatedCamera()
+  {
+    Close();
+  }
+
+protected:
+  bool OpenDevice() CV_OVERRIDE
+  {
+    images_.clear();
+    std::vector<uchar> bytes;
+    for (size_t k = 0; k < files_.size(); k++)
+    {
+      cv::Mat buffer, image;
+      std::shared_ptr<const void> storage;
+      if (!ImageSequenceReader::ReadFrame(files_[k], buffer, image, storage, bytes))
+        return false;
+      images_.push_back(image.clone());
+    }
+    next_ = 0;
+    tick_ = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void CloseDevice() CV_OVERRIDE
+  {
+    images_.clear();
+  }
+
+  bool WaitFrame(cv::Mat& buffer, const int timeout_ms) CV_OVERRIDE
+  {
+    if (fps_ > 0)
+    {
+      const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+      if (tick_ > deadline)
+      {
+        std::this_thread::sleep_until(deadline);
+        return false;
+      }
+      std::this_thread::sleep_until(tick_);
+      tick_ += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                 std::chrono::duration<double>(1.0 / fps_));
+    }
+
+    // The copy stands in for the sensor-to-host transfer
+    if (!images_.empty())
+      images_[next_ % images_.size()].copyTo(buffer);
+    else
+      DrawPattern(buffer, next_);
+    next_++;
+    return true;
+  }
+
+private:
+  void DrawPattern(cv::Mat& buffer, const uint64_t n) const
+  {
+    buffer.create(size_, type_);
+    const int cn = buffer.channels();
+    const int shift = (int)(n * 4);
+    for (int i = 0; i < buffer.rows; i++)
+    {
+      if (buffer.depth() == CV_16U)
+      {
+        ushort* row = buffer.ptr<ushort>(i);
+        for (int j = 0; j < buffer.cols * cn; j++)
+          row[j] = (ushort)(((j / cn + shift) * 16 + i * 8) & 0xffff);
+      }
+      else
+      {
+        uchar* row = buffer.ptr<uchar>(i);
+        for (int j = 0; j < buffer.cols * cn; j++)
+          row[j] = (uchar)((j / cn + shift + i / 2) & 0xff);
+      }
+    }
+  }
+
+  const std::vector<std::string> files_;
+  const double fps_;
+  const cv::Size size_;
+  const int type_;
+  std::vector<cv::Mat> images_;
+  uint64_t next_;
+  std::chrono::steady_clock::time_point tick_;  ///< Scheduled time of the next frame
+};
+
+} // my_cv
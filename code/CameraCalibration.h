@@ -0,0 +1,246 @@
+﻿///*****************************************************************************
+///
+/// \file       CameraCalibration.h
+/// \brief      面阵相机模型及畸变校正映射表
+///
+///             相机参数与Halcon面阵除法模型（division）一致，位姿沿用RotationMatrix
+///             的角度约定。映射表按行并行生成，输出定点格式，由MapImage分块应用
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <climits>
+#include <cmath>
+#include <string>
+
+#include "ImageMapping.h"
+#include "RotationTransformation.h"
+
+namespace my_cv {
+
+///
+/// \brief 面阵相机内参（除法畸变模型）
+///
+/// 理想像点 (u, v) 与畸变像点 (ũ, ṽ) 的关系为 u = ũ / (1 + Kappa * (ũ² + ṽ²))，
+/// 像平面坐标单位为米，像素坐标 列 = ũ / Sx + Cx，行 = ṽ / Sy + Cy
+///
+struct CameraParam
+{
+  double Focus = 0;   ///< 焦距（米）
+  double Kappa = 0;   ///< 径向畸变系数（1/米²）
+  double Sx = 0;      ///< 像元宽（米）
+  double Sy = 0;      ///< 像元高（米）
+  double Cx = 0;      ///< 主点列坐标（像素）
+  double Cy = 0;      ///< 主点行坐标（像素）
+  int ImageWidth = 0;
+  int ImageHeight = 0;
+
+  cv::Size ImageSize() const { return cv::Size(ImageWidth, ImageHeight); }
+
+  ///
+  /// \brief    像素坐标 -> 理想（无畸变）像平面坐标
+  ///
+  cv::Point2d Undistort(const double col, const double row) const
+  {
+    const double u = (col - Cx) * Sx;
+    const double v = (row - Cy) * Sy;
+    const double k = 1 / (1 + Kappa * (u * u + v * v));
+    return cv::Point2d(u * k, v * k);
+  }
+  ///
+  /// \brief    理想像平面坐标 -> 像素坐标
+  /// \return   超出畸变模型定义域时返回false
+  ///
+  bool Distort(const cv::Point2d& p, double& col, double& row) const
+  {
+    const double d = 1 - 4 * Kappa * (p.x * p.x + p.y * p.y);
+    if (d < 0)
+      return false;
+    const double k = 2 / (1 + std::sqrt(d));
+    col = p.x * k / Sx + Cx;
+    row = p.y * k / Sy + Cy;
+    return true;
+  }
+};
+
+///
+/// \brief 相机位姿，将世界坐标变换到相机坐标：Pc = R * Pw + T
+///
+struct CameraPose
+{
+  my_linear_algebra::RotationMatrix Rotation;
+  cv::Vec3d Translation;
+
+  CameraPose()
+    : Translation(0, 0, 0)
+  { }
+  ///
+  /// \brief    构造函数
+  /// \param    [in]  T      平移（米）
+  /// \param    [in]  Alpha  绕x轴旋转角度
+  /// \param    [in]  Beta   绕y轴旋转角度
+  /// \param    [in]  Gamma  绕z轴旋转角度
+  ///
+  CameraPose(const cv::Vec3d& T, const double Alpha, const double Beta, const double Gamma)
+    : Rotation(Alpha, Beta, Gamma), Translation(T)
+  { }
+};
+
+static void CheckCameraParam(const CameraParam& CamParam)
+{
+  if (CamParam.Focus <= 0 || CamParam.Sx <= 0 || CamParam.Sy <= 0 ||
+      CamParam.ImageWidth <= 0 || CamParam.ImageHeight <= 0)
+    CV_Error(cv::Error::StsBadArg, "Invalid camera parameters");
+  CV_Assert(CamParam.ImageWidth < SHRT_MAX && CamParam.ImageHeight < SHRT_MAX);
+}
+
+static FixedPointMap CreateFixedPointMap(const cv::Size& src_size, const cv::Size& dst_size,
+                                         const std::string& MapType)
+{
+  FixedPointMap map;
+  map.src_size = src_size;
+  map.bilinear = IsBilinearInterpolation(MapType);
+  map.xy.create(dst_size, CV_16SC2);
+  map.frac.create(dst_size, CV_16UC1);
+  return map;
+}
+
+class RadialDistortionMapRunner : public cv::ParallelLoopBody
+{
+public:
+  RadialDistortionMapRunner(const CameraParam& _in, const CameraParam& _out, FixedPointMap& _map)
+    : in(_in), out(_out), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    // Both cameras share the optical centre, only the focal length and distortion differ
+    const double ratio = in.Focus / out.Focus;
+    for (int i = range.start; i < range.end; i++)
+    {
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      for (int j = 0; j < map.xy.cols; j++)
+      {
+        double col = -1, row = -1;
+        if (!in.Distort(out.Undistort(j, i) * ratio, col, row))
+          col = row = -2;
+        StoreMapEntry(col, row, xy + 2 * j, frac + j);
+      }
+    }
+  }
+
+private:
+  CameraParam in;
+  CameraParam out;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    生成改变相机内参（畸变、焦距、主点）的映射表
+///
+/// 对应Halcon的gen_radial_distortion_map，映射后的图像如同用CamParamOut拍摄
+///
+/// \param    [in]  CamParamIn   源图像的相机参数
+/// \param    [in]  CamParamOut  目标图像的相机参数，决定目标图像尺寸
+/// \param    [in]  MapType      "bilinear"或"nearest_neighbor"
+///
+static FixedPointMap GenRadialDistortionMap(const CameraParam& CamParamIn,
+                                            const CameraParam& CamParamOut,
+                                            const std::string& MapType)
+{
+  CheckCameraParam(CamParamIn);
+  CheckCameraParam(CamParamOut);
+
+  FixedPointMap map = CreateFixedPointMap(CamParamIn.ImageSize(), CamParamOut.ImageSize(),
+                                          MapType);
+  cv::parallel_for_(cv::Range(0, CamParamOut.ImageHeight),
+                    RadialDistortionMapRunner(CamParamIn, CamParamOut, map),
+                    map.Size().area() / (double)(1 << 16));
+  return map;
+}
+
+class WorldPlaneMapRunner : public cv::ParallelLoopBody
+{
+public:
+  WorldPlaneMapRunner(const CameraParam& _camera, const CameraPose& _pose, double _scale,
+                      FixedPointMap& _map)
+    : camera(_camera), R(_pose.Rotation.Matrix()), T(_pose.Translation), scale(_scale), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      // Points of one output row lie on a straight line in the camera frame
+      const double y = i * scale;
+      const double x0 = R(0, 1) * y + T[0], y0 = R(1, 1) * y + T[1], z0 = R(2, 1) * y + T[2];
+      const double dx = R(0, 0) * scale, dy = R(1, 0) * scale, dz = R(2, 0) * scale;
+      for (int j = 0; j < map.xy.cols; j++)
+      {
+        const double z = z0 + dz * j;
+        double col = -2, row = -2;
+        if (z > 0)
+        {
+          const double f = camera.Focus / z;
+          camera.Distort(cv::Point2d((x0 + dx * j) * f, (y0 + dy * j) * f), col, row);
+        }
+        StoreMapEntry(col, row, xy + 2 * j, frac + j);
+      }
+    }
+  }
+
+private:
+  CameraParam camera;
+  cv::Matx33d R;
+  cv::Vec3d T;
+  double scale;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    生成图像到世界平面（z = 0）的校正映射表
+///
+/// 对应Halcon的gen_image_to_world_plane_map。目标图像左上角为WorldPose的原点，
+/// 列沿世界x轴、行沿世界y轴，每个像素对应Scale米
+///
+/// \param    [in]  CamParam      相机参数
+/// \param    [in]  WorldPose     世界平面相对相机的位姿
+/// \param    [in]  WidthIn       源图像宽
+/// \param    [in]  HeightIn      源图像高
+/// \param    [in]  WidthMapped   目标图像宽
+/// \param    [in]  HeightMapped  目标图像高
+/// \param    [in]  Scale         目标图像像素尺寸（米）
+/// \param    [in]  MapType       "bilinear"或"nearest_neighbor"
+///
+static FixedPointMap GenImageToWorldPlaneMap(const CameraParam& CamParam,
+                                             const CameraPose& WorldPose,
+                                             const int WidthIn, const int HeightIn,
+                                             const int WidthMapped, const int HeightMapped,
+                                             const double Scale, const std::string& MapType)
+{
+  CheckCameraParam(CamParam);
+  CV_Assert(WidthIn > 0 && HeightIn > 0 && WidthIn < SHRT_MAX && HeightIn < SHRT_MAX);
+  CV_Assert(WidthMapped > 0 && HeightMapped > 0);
+  if (Scale <= 0)
+    CV_Error(cv::Error::StsBadArg, "Scale must be positive");
+
+  FixedPointMap map = CreateFixedPointMap(cv::Size(WidthIn, HeightIn),
+                                          cv::Size(WidthMapped, HeightMapped), MapType);
+  cv::parallel_for_(cv::Range(0, HeightMapped),
+                    WorldPlaneMapRunner(CamParam, WorldPose, Scale, map),
+                    map.Size().area() / (double)(1 << 16));
+  return map;
+}
+
+} // my_cv
@@ -0,0 +1,229 @@
+﻿///*****************************************************************************
+///
+/// \file       ChannelPlanes.h
+/// \brief      交错存储与平面存储之间的通道转换
+///
+///             多通道图像按平面存储时，每个通道是一幅单通道图像；解交错得到的各通道
+///             位于同一块连续内存中，访问单个通道只返回视图，不需要分配和复制。交错
+///             到平面的转换按行并行，每次用SIMD解交错16个8位像素或8个16位像素，
+///             平面到交错反之
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <vector>
+
+namespace my_cv {
+
+///
+/// \brief 平面存储的多通道图像
+///
+struct ImagePlanes
+{
+  std::vector<cv::Mat> planes;  ///< 每个通道一幅单通道图像
+
+  size_t Bytes() const
+  {
+    size_t bytes = 0;
+    for (size_t k = 0; k < planes.size(); k++)
+      bytes += planes[k].total() * planes[k].elemSize();
+    return bytes;
+  }
+};
+
+#if CV_SIMD128
+template <typename T>
+struct PlaneVector;
+
+template <>
+struct PlaneVector<uchar>
+{
+  typedef cv::v_uint8x16 type;
+};
+
+template <>
+struct PlaneVector<ushort>
+{
+  typedef cv::v_uint16x8 type;
+};
+#endif
+
+///
+/// \brief    解交错一行
+///
+template <typename T>
+static void SplitRow(const T* src, T* const* dst, const int n, const int cn)
+{
+  int j = 0;
+#if CV_SIMD128
+  typedef typename PlaneVector<T>::type V;
+  const int step = V::nlanes;
+  if (cn == 2)
+  {
+    for (; j <= n - step; j += step)
+    {
+      V a, b;
+      cv::v_load_deinterleave(src + 2 * j, a, b);
+      cv::v_store(dst[0] + j, a);
+      cv::v_store(dst[1] + j, b);
+    }
+  }
+  else if (cn == 3)
+  {
+    for (; j <= n - step; j += step)
+    {
+      V a, b, c;
+      cv::v_load_deinterleave(src + 3 * j, a, b, c);
+      cv::v_store(dst[0] + j, a);
+      cv::v_store(dst[1] + j, b);
+      cv::v_store(dst[2] + j, c);
+    }
+  }
+  else if (cn == 4)
+  {
+    for (; j <= n - step; j += step)
+    {
+      V a, b, c, d;
+      cv::v_load_deinterleave(src + 4 * j, a, b, c, d);
+      cv::v_store(dst[0] + j, a);
+      cv::v_store(dst[1] + j, b);
+      cv::v_store(dst[2] + j, c);
+      cv::v_store(dst[3] + j, d);
+    }
+  }
+#endif
+  for (; j < n; j++)
+    for (int k = 0; k < cn; k++)
+      dst[k][j] = src[cn * j + k];
+}
+
+///
+/// \brief    交错一行
+///
+template <typename T>
+static void MergeRow(const T* const* src, T* dst, const int n, const int cn)
+{
+  int j = 0;
+#if CV_SIMD128
+  typedef typename PlaneVector<T>::type V;
+  const int step = V::nlanes;
+  if (cn == 2)
+  {
+    for (; j <= n - step; j += step)
+      cv::v_store_interleave(dst + 2 * j, cv::v_load(src[0] + j), cv::v_load(src[1] + j));
+  }
+  else if (cn == 3)
+  {
+    for (; j <= n - step; j += step)
+      cv::v_store_interleave(dst + 3 * j, cv::v_load(src[0] + j), cv::v_load(src[1] + j),
+                             cv::v_load(src[2] + j));
+  }
+  else if (cn == 4)
+  {
+    for (; j <= n - step; j += step)
+      cv::v_store_interleave(dst + 4 * j, cv::v_load(src[0] + j), cv::v_load(src[1] + j),
+                             cv::v_load(src[2] + j), cv::v_load(src[3] + j));
+  }
+#endif
+  for (; j < n; j++)
+    for (int k = 0; k < cn; k++)
+      dst[cn * j + k] = src[k][j];
+}
+
+///
+/// \brief 交错与平面互相转换，split为true时interleaved -> planes
+///
+class PlaneConvertRunner : public cv::ParallelLoopBody
+{
+public:
+  PlaneConvertRunner(const cv::Mat& _interleaved, const std::vector<cv::Mat>& _planes,
+                     const bool _split)
+    : interleaved(_interleaved), planes(_planes), split(_split)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int cn = (int)planes.size();
+    for (int i = range.start; i < range.end; i++)
+    {
+      if (interleaved.depth() == CV_8U)
+        ConvertRow<uchar>(i, cn);
+      else
+        ConvertRow<ushort>(i, cn);
+    }
+  }
+
+private:
+  template <typename T>
+  void ConvertRow(const int i, const int cn) const
+  {
+    T* rows[CV_CN_MAX];
+    for (int k = 0; k < cn; k++)
+      rows[k] = const_cast<T*>(planes[k].ptr<T>(i));
+    T* p = const_cast<T*>(interleaved.ptr<T>(i));
+    if (split)
+      SplitRow(p, rows, interleaved.cols, cn);
+    else
+      MergeRow(rows, p, interleaved.cols, cn);
+  }
+
+  cv::Mat interleaved;
+  const std::vector<cv::Mat>& planes;
+  bool split;
+};
+
+///
+/// \brief    交错存储转为平面存储，所有通道分配在同一块内存中
+/// \param    [in]  src  CV_8U或CV_16U图像，其他深度使用cv::split
+///
+static ImagePlanes SplitPlanes(const cv::Mat& src)
+{
+  const int cn = src.channels();
+  // One allocation, every plane is a row range of it
+  const cv::Mat block(src.rows * cn, src.cols, src.depth());
+  ImagePlanes result;
+  for (int k = 0; k < cn; k++)
+    result.planes.push_back(block.rowRange(k * src.rows, (k + 1) * src.rows));
+
+  if (cn == 1)
+    src.copyTo(result.planes[0]);
+  else if (src.depth() == CV_8U || src.depth() == CV_16U)
+    cv::parallel_for_(cv::Range(0, src.rows), PlaneConvertRunner(src, result.planes, true),
+                      src.total() * cn / (double)(1 << 16));
+  else
+    cv::split(src, result.planes);
+  return result;
+}
+
+///
+/// \brief    单通道图像交错为多通道图像
+/// \param    [in]  planes  尺寸和深度相同的单通道图像
+///
+static void MergePlanes(const std::vector<cv::Mat>& planes, cv::Mat& dst)
+{
+  CV_Assert(!planes.empty() && (int)planes.size() <= CV_CN_MAX);
+  for (size_t k = 0; k < planes.size(); k++)
+  {
+    CV_Assert(planes[k].channels() == 1);
+    CV_Assert(planes[k].size() == planes[0].size() && planes[k].depth() == planes[0].depth());
+  }
+
+  const int cn = (int)planes.size();
+  cv::Mat result(planes[0].size(), CV_MAKETYPE(planes[0].depth(), cn));
+  if (planes[0].depth() == CV_8U || planes[0].depth() == CV_16U)
+    cv::parallel_for_(cv::Range(0, result.rows), PlaneConvertRunner(result, planes, false),
+                      result.total() * cn / (double)(1 << 16));
+  else
+    cv::merge(planes, result);
+  dst = result;
+}
+
+} // my_cv
@@ -0,0 +1,464 @@
+﻿///*****************************************************************************
+///
+/// \file       ColorClassLut.h
+/// \brief      颜色分类查找表
+///
+///             由带类别标记的样本训练box、gmm或knn分类器，再编译为每通道BitDepth位的
+///             三维查找表，分类时每个像素只需一次查表。查表索引用SIMD每次计算16个像素，
+///             结果按行条带并行编码为每个类别的游程区域
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "SRegion.h"
+
+namespace my_cv {
+
+/// 查找表中不属于任何类别的值
+static const uchar kClassLutReject = 255;
+
+///
+/// \brief 编译后的三维颜色分类查找表
+///
+/// 索引为(b >> shift) << 2 * BitDepth | (g >> shift) << BitDepth | (r >> shift)
+///
+class ClassLut
+{
+public:
+  ClassLut()
+    : bit_depth_(0), num_classes_(0)
+  { }
+
+  ClassLut(const int BitDepth, const int NumClasses)
+    : bit_depth_(BitDepth), num_classes_(NumClasses),
+      table_(1, 1 << (3 * BitDepth), CV_8UC1, cv::Scalar(kClassLutReject))
+  {
+    CV_Assert(BitDepth >= 1 && BitDepth <= 8);
+    CV_Assert(NumClasses >= 1 && NumClasses < kClassLutReject);
+  }
+
+  int BitDepth() const { return bit_depth_; }
+  int Shift() const { return 8 - bit_depth_; }
+  int NumClasses() const { return num_classes_; }
+  bool Empty() const { return table_.empty(); }
+
+  uchar* Table() { return table_.ptr<uchar>(); }
+  const uchar* Table() const { return table_.ptr<uchar>(); }
+
+  ///
+  /// \brief    单元(qb, qg, qr)中心的颜色
+  ///
+  cv::Vec3d CellCenter(const int qb, const int qg, const int qr) const
+  {
+    const double half = ((1 << Shift()) - 1) / 2.0;
+    return cv::Vec3d((qb << Shift()) + half, (qg << Shift()) + half, (qr << Shift()) + half);
+  }
+
+  int CellIndex(const int qb, const int qg, const int qr) const
+  {
+    return (qb << (2 * bit_depth_)) | (qg << bit_depth_) | qr;
+  }
+
+private:
+  int bit_depth_;
+  int num_classes_;
+  cv::Mat table_;
+};
+
+///
+/// \brief 编译查找表：把分类函数应用到每个单元的中心颜色，按b平面并行
+///
+template <typename Classify>
+class CompileClassLutRunner : public cv::ParallelLoopBody
+{
+public:
+  CompileClassLutRunner(ClassLut& _lut, const Classify& _classify)
+    : lut(_lut), classify(_classify)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int cells = 1 << lut.BitDepth();
+    for (int qb = range.start; qb < range.end; qb++)
+      for (int qg = 0; qg < cells; qg++)
+        for (int qr = 0; qr < cells; qr++)
+          lut.Table()[lut.CellIndex(qb, qg, qr)] = classify(lut.CellCenter(qb, qg, qr));
+  }
+
+private:
+  ClassLut& lut;
+  Classify classify;
+};
+
+///
+/// \brief box分类：样本包围盒外扩margin，落在多个盒内时取中心最近的类别
+///
+class BoxClassifier
+{
+public:
+  BoxClassifier(const std::vector<std::vector<cv::Vec3b> >& samples, const double margin)
+  {
+    for (size_t c = 0; c < samples.size(); c++)
+    {
+      cv::Vec3d lo(255, 255, 255), hi(0, 0, 0);
+      for (size_t k = 0; k < samples[c].size(); k++)
+        for (int ch = 0; ch < 3; ch++)
+        {
+          lo[ch] = std::min(lo[ch], (double)samples[c][k][ch]);
+          hi[ch] = std::max(hi[ch], (double)samples[c][k][ch]);
+        }
+      lower.push_back(lo - cv::Vec3d::all(margin));
+      upper.push_back(hi + cv::Vec3d::all(margin));
+    }
+  }
+
+  uchar operator () (const cv::Vec3d& color) const
+  {
+    uchar best = kClassLutReject;
+    double best_distance = std::numeric_limits<double>::max();
+    for (size_t c = 0; c < lower.size(); c++)
+    {
+      bool inside = true;
+      for (int ch = 0; ch < 3; ch++)
+        inside = inside && color[ch] >= lower[c][ch] && color[ch] <= upper[c][ch];
+      if (!inside)
+        continue;
+      const double distance = cv::norm(color - (lower[c] + upper[c]) * 0.5);
+      if (distance < best_distance)
+      {
+        best_distance = distance;
+        best = (uchar)c;
+      }
+    }
+    return best;
+  }
+
+private:
+  std::vector<cv::Vec3d> lower;
+  std::vector<cv::Vec3d> upper;
+};
+
+///
+/// \brief gmm分类：每个类别一个全协方差高斯分量，取似然最大的类别，
+///        马氏距离超过max_distance时拒识
+///
+class GaussClassifier
+{
+public:
+  GaussClassifier(const std::vector<std::vector<cv::Vec3b> >& samples, const double max_distance)
+    : max_distance2(max_distance * max_distance)
+  {
+    for (size_t c = 0; c < samples.size(); c++)
+    {
+      const double n = (double)samples[c].size();
+      std::vector<cv::Vec3d> colors(samples[c].begin(), samples[c].end());
+      cv::Vec3d mean(0, 0, 0);
+      for (size_t k = 0; k < colors.size(); k++)
+        mean += colors[k];
+      mean *= 1.0 / n;
+
+      // Unit regularisation keeps flat single-colour classes invertible
+      cv::Matx33d covariance = cv::Matx33d::eye();
+      for (size_t k = 0; k < colors.size(); k++)
+      {
+        const cv::Vec3d d = colors[k] - mean;
+        for (int a = 0; a < 3; a++)
+          for (int b = 0; b < 3; b++)
+            covariance(a, b) += d[a] * d[b] / n;
+      }
+      means.push_back(mean);
+      inverses.push_back(covariance.inv());
+      log_dets.push_back(std::log(cv::determinant(covariance)));
+    }
+  }
+
+  uchar operator () (const cv::Vec3d& color) const
+  {
+    uchar best = kClassLutReject;
+    double best_score = std::numeric_limits<double>::max();
+    for (size_t c = 0; c < means.size(); c++)
+    {
+      const cv::Vec3d d = color - means[c];
+      const double distance2 = d.dot(inverses[c] * d);
+      if (distance2 > max_distance2)
+        continue;
+      const double score = distance2 + log_dets[c];
+      if (score < best_score)
+      {
+        best_score = score;
+        best = (uchar)c;
+      }
+    }
+    return best;
+  }
+
+private:
+  double max_distance2;
+  std::vector<cv::Vec3d> means;
+  std::vector<cv::Matx33d> inverses;
+  std::vector<double> log_dets;
+};
+
+///
+/// \brief    knn：样本所在单元按多数投票取类别，再按6邻域广度优先向外传播，
+///           传播距离（城市街区距离，单位为灰度）超过max_distance的单元拒识
+///
+static void CompileNearestClassLut(const std::vector<std::vector<cv::Vec3b> >& samples,
+                                   const double max_distance, ClassLut& lut)
+{
+  const int cells = 1 << lut.BitDepth();
+  const int shift = lut.Shift();
+  const int nclasses = lut.NumClasses();
+  const size_t ncells = (size_t)1 << (3 * lut.BitDepth());
+
+  // Sorting (cell, class) keys keeps the vote count proportional to the samples, not the cells
+  std::vector<size_t> keys;
+  for (int c = 0; c < nclasses; c++)
+    for (size_t k = 0; k < samples[c].size(); k++)
+    {
+      const cv::Vec3b& s = samples[c][k];
+      keys.push_back((size_t)lut.CellIndex(s[0] >> shift, s[1] >> shift, s[2] >> shift) *
+                     nclasses + c);
+    }
+  std::sort(keys.begin(), keys.end());
+
+  uchar* table = lut.Table();
+  std::vector<int> steps(ncells, -1);
+  std::deque<int> queue;
+  for (size_t k = 0; k < keys.size(); )
+  {
+    const size_t cell = keys[k] / nclasses;
+    int best = -1;
+    size_t best_votes = 0;
+    while (k < keys.size() && keys[k] / nclasses == cell)
+    {
+      const size_t begin = k;
+      while (k < keys.size() && keys[k] == keys[begin])
+        k++;
+      if (k - begin > best_votes)
+      {
+        best_votes = k - begin;
+        best = (int)(keys[begin] % nclasses);
+      }
+    }
+    table[cell] = (uchar)best;
+    steps[cell] = 0;
+    queue.push_back((int)cell);
+  }
+
+  const int max_steps = (int)std::floor(max_distance / (1 << shift));
+  const int mask = cells - 1;
+  while (!queue.empty())
+  {
+    const int cell = queue.front();
+    queue.pop_front();
+    if (steps[cell] >= max_steps)
+      continue;
+    const int q[3] = { cell >> (2 * lut.BitDepth()), (cell >> lut.BitDepth()) & mask,
+                       cell & mask };
+    for (int axis = 0; axis < 3; axis++)
+      for (int delta = -1; delta <= 1; delta += 2)
+      {
+        int n[3] = { q[0], q[1], q[2] };
+        n[axis] += delta;
+        if (n[axis] < 0 || n[axis] >= cells)
+          continue;
+        const int next = lut.CellIndex(n[0], n[1], n[2]);
+        if (steps[next] >= 0)
+          continue;
+        steps[next] = steps[cell] + 1;
+        table[next] = table[cell];
+        queue.push_back(next);
+      }
+  }
+}
+
+///
+/// \brief 带类别标记的颜色样本
+///
+class ColorClassSamples
+{
+public:
+  ///
+  /// \brief    添加样本，区域组的第c个区域内的像素属于类别c
+  /// \param    [in]  image  CV_8UC3 BGR图像
+  ///
+  void Add(const cv::Mat& image, const std::vector<SRegion>& ClassRegions)
+  {
+    CV_Assert(image.type() == CV_8UC3);
+    CV_Assert(ClassRegions.size() < kClassLutReject);
+    if (samples_.size() < ClassRegions.size())
+      samples_.resize(ClassRegions.size());
+    for (size_t c = 0; c < ClassRegions.size(); c++)
+    {
+      const std::vector<RegionRun>& runs = ClassRegions[c].Clip(image.size()).Runs();
+      for (size_t k = 0; k < runs.size(); k++)
+      {
+        const cv::Vec3b* p = image.ptr<cv::Vec3b>(runs[k].Row);
+        samples_[c].insert(samples_[c].end(), p + runs[k].ColumnBegin, p + runs[k].ColumnEnd);
+      }
+    }
+  }
+
+  int NumClasses() const { return (int)samples_.size(); }
+
+  size_t NumSamples(const int ClassID) const { return samples_[ClassID].size(); }
+
+  ///
+  /// \brief    训练并编译为查找表
+  /// \param    [in]  Mode         "box"、"gmm"或"knn"
+  /// \param    [in]  MaxDistance  box为包围盒外扩的灰度，gmm为拒识的马氏距离，
+  ///                              knn为拒识的灰度距离
+  /// \param    [in]  BitDepth     每通道的位数，6位时查找表为256KB
+  ///
+  ClassLut CreateClassLut(const std::string& Mode, const double MaxDistance,
+                          const int BitDepth) const
+  {
+    CV_Assert(!samples_.empty());
+    for (size_t c = 0; c < samples_.size(); c++)
+      if (samples_[c].empty())
+        CV_Error(cv::Error::StsBadArg, "Every class needs samples");
+
+    ClassLut lut(BitDepth, NumClasses());
+    const cv::Range planes(0, 1 << BitDepth);
+    if (Mode == "box")
+      cv::parallel_for_(planes, CompileClassLutRunner<BoxClassifier>(
+                                  lut, BoxClassifier(samples_, MaxDistance)));
+    else if (Mode == "gmm")
+      cv::parallel_for_(planes, CompileClassLutRunner<GaussClassifier>(
+                                  lut, GaussClassifier(samples_, MaxDistance)));
+    else if (Mode == "knn")
+      CompileNearestClassLut(samples_, MaxDistance, lut);
+    else
+      CV_Error(cv::Error::StsBadArg, "Unsupported mode: " + Mode);
+    return lut;
+  }
+
+private:
+  std::vector<std::vector<cv::Vec3b> > samples_;
+};
+
+///
+/// \brief    查表得到一行的类别
+///
+static void ClassifyLutRow(const uchar* bgr, const int n, const ClassLut& lut, uchar* labels)
+{
+  const uchar* table = lut.Table();
+  const int shift = lut.Shift();
+  const int bits = lut.BitDepth();
+  int j = 0;
+#if CV_SIMD128
+  unsigned index[16];
+  for (; j <= n - 16; j += 16)
+  {
+    cv::v_uint8x16 b8, g8, r8;
+    cv::v_load_deinterleave(bgr + 3 * j, b8, g8, r8);
+    cv::v_uint16x8 b[2], g[2], r[2];
+    cv::v_expand(b8, b[0], b[1]);
+    cv::v_expand(g8, g[0], g[1]);
+    cv::v_expand(r8, r[0], r[1]);
+    for (int h = 0; h < 2; h++)
+    {
+      // 3 * BitDepth can exceed 16 bits, so the index is assembled in 32-bit lanes
+      const cv::v_uint16x8 qb = b[h] >> shift, qg = g[h] >> shift, qr = r[h] >> shift;
+      cv::v_uint32x4 b0, b1, g0, g1, r0, r1;
+      cv::v_expand(qb, b0, b1);
+      cv::v_expand(qg, g0, g1);
+      cv::v_expand(qr, r0, r1);
+      cv::v_store(index + 8 * h, (b0 << (2 * bits)) | (g0 << bits) | r0);
+      cv::v_store(index + 8 * h + 4, (b1 << (2 * bits)) | (g1 << bits) | r1);
+    }
+    for (int k = 0; k < 16; k++)
+      labels[j + k] = table[index[k]];
+  }
+#endif
+  for (; j < n; j++)
+    labels[j] = table[lut.CellIndex(bgr[3 * j] >> shift, bgr[3 * j + 1] >> shift,
+                                    bgr[3 * j + 2] >> shift)];
+}
+
+class ClassLutRegionsRunner : public cv::ParallelLoopBody
+{
+public:
+  ClassLutRegionsRunner(const cv::Mat& _image, const ClassLut& _lut, int _stripe_rows,
+                        std::vector<std::vector<std::vector<RegionRun> > >& _stripes)
+    : image(_image), lut(_lut), stripe_rows(_stripe_rows), stripes(_stripes)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    std::vector<uchar> labels(image.cols);
+    for (int s = range.start; s < range.end; s++)
+    {
+      std::vector<std::vector<RegionRun> >& classes = stripes[s];
+      const int row1 = std::min(image.rows, (s + 1) * stripe_rows);
+      for (int i = s * stripe_rows; i < row1; i++)
+      {
+        ClassifyLutRow(image.ptr<uchar>(i), image.cols, lut, &labels[0]);
+        int j = 0;
+        while (j < image.cols)
+        {
+          const uchar c = labels[j];
+          const int begin = j;
+          while (j < image.cols && labels[j] == c)
+            j++;
+          if (c != kClassLutReject)
+          {
+            const RegionRun run = { i, begin, j };
+            classes[c].push_back(run);
+          }
+        }
+      }
+    }
+  }
+
+private:
+  cv::Mat image;
+  const ClassLut& lut;
+  int stripe_rows;
+  std::vector<std::vector<std::vector<RegionRun> > >& stripes;
+};
+
+///
+/// \brief    用查找表分类，一次遍历得到每个类别的区域
+/// \param    [in]  image  CV_8UC3 BGR图像
+///
+static std::vector<SRegion> ClassifyClassLut(const cv::Mat& image, const ClassLut& lut)
+{
+  CV_Assert(image.type() == CV_8UC3 && !lut.Empty());
+
+  const int nclasses = lut.NumClasses();
+  const int stripe_rows = 64;
+  const int nstripes = (image.rows + stripe_rows - 1) / stripe_rows;
+  std::vector<std::vector<std::vector<RegionRun> > > stripes(
+    nstripes, std::vector<std::vector<RegionRun> >(nclasses));
+  cv::parallel_for_(cv::Range(0, nstripes),
+                    ClassLutRegionsRunner(image, lut, stripe_rows, stripes));
+
+  std::vector<SRegion> regions(nclasses);
+  std::vector<std::vector<RegionRun> > parts(nstripes);
+  for (int c = 0; c < nclasses; c++)
+  {
+    for (int s = 0; s < nstripes; s++)
+      parts[s].swap(stripes[s][c]);
+    regions[c] = SRegion(ConcatRuns(parts));
+  }
+  return regions;
+}
+
+} // my_cv
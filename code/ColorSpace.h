@@ -0,0 +1,337 @@
+﻿///*****************************************************************************
+///
+/// \file       ColorSpace.h
+/// \brief      颜色空间变换与颜色阈值
+///
+///             BGR到HSV/HSI的变换每次用SIMD在浮点通道中计算16个像素，色调取值0~255
+///             对应0~2π（与cv::COLOR_BGR2HSV_FULL相同），HSI的色调与HSV相同。颜色
+///             阈值在同一遍中逐行变换并检查各通道范围，变换结果只存在于寄存器中，
+///             不生成变换后的图像
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "LocalThreshold.h"
+#include "SRegion.h"
+
+namespace my_cv {
+
+enum ColorSpace
+{
+  kColorHsv,
+  kColorHsi,
+  kColorCielab
+};
+
+///
+/// \brief    解析"hsv"、"hsi"、"cielab"
+///
+static ColorSpace ParseColorSpace(const std::string& Space)
+{
+  if (Space == "hsv")
+    return kColorHsv;
+  if (Space == "hsi")
+    return kColorHsi;
+  if (Space == "cielab")
+    return kColorCielab;
+  CV_Error(cv::Error::StsBadArg, "Unsupported color space: " + Space);
+}
+
+///
+/// \brief    一个像素的色调、饱和度与明度/亮度，与SIMD版本逐步相同以保证结果一致
+///
+static inline void HueSaturation(const float b, const float g, const float r, const bool hsi,
+                                 int& h, int& s, int& x)
+{
+  const float v = std::max(std::max(r, g), b);
+  const float m = std::min(std::min(r, g), b);
+  const float diff = v - m;
+  const float raw = v == r ? g - b : v == g ? b - r + 2 * diff : r - g + 4 * diff;
+  float hue = raw * (256.f / 6) / std::max(diff, 1.f);
+  hue = hue < 0 ? hue + 256.f : hue;
+  h = cv::saturate_cast<uchar>(cvRound(hue));
+  if (hsi)
+  {
+    const float sum = r + g + b;
+    s = sum == 0 ? 0 : cv::saturate_cast<uchar>(cvRound(255.f - m * 765.f / std::max(sum, 1.f)));
+    x = cvRound(sum / 3.f);
+  }
+  else
+  {
+    s = cvRound(diff * 255.f / std::max(v, 1.f));
+    x = (int)v;
+  }
+}
+
+#if CV_SIMD128
+static inline void HueSaturation4(const cv::v_float32x4& b, const cv::v_float32x4& g,
+                                  const cv::v_float32x4& r, const bool hsi, cv::v_int32x4& h,
+                                  cv::v_int32x4& s, cv::v_int32x4& x)
+{
+  const cv::v_float32x4 zero = cv::v_setzero_f32(), one = cv::v_setall_f32(1.f);
+  const cv::v_float32x4 v = cv::v_max(cv::v_max(r, g), b);
+  const cv::v_float32x4 m = cv::v_min(cv::v_min(r, g), b);
+  const cv::v_float32x4 diff = v - m;
+  const cv::v_float32x4 two = cv::v_setall_f32(2.f), four = cv::v_setall_f32(4.f);
+  const cv::v_float32x4 raw = cv::v_select(v == r, g - b,
+                                           cv::v_select(v == g, b - r + two * diff,
+                                                        r - g + four * diff));
+  cv::v_float32x4 hue = raw * cv::v_setall_f32(256.f / 6) / cv::v_max(diff, one);
+  hue = cv::v_select(hue < zero, hue + cv::v_setall_f32(256.f), hue);
+  h = cv::v_round(hue);
+  if (hsi)
+  {
+    const cv::v_float32x4 sum = r + g + b;
+    const cv::v_float32x4 sat = cv::v_setall_f32(255.f) -
+                                m * cv::v_setall_f32(765.f) / cv::v_max(sum, one);
+    s = cv::v_round(cv::v_select(sum == zero, zero, sat));
+    x = cv::v_round(sum / cv::v_setall_f32(3.f));
+  }
+  else
+  {
+    s = cv::v_round(diff * cv::v_setall_f32(255.f) / cv::v_max(v, one));
+    x = cv::v_round(v);
+  }
+}
+
+static inline void ExpandToFloat(const cv::v_uint8x16& a, cv::v_float32x4 f[4])
+{
+  cv::v_uint16x8 w0, w1;
+  cv::v_expand(a, w0, w1);
+  cv::v_uint32x4 d0, d1, d2, d3;
+  cv::v_expand(w0, d0, d1);
+  cv::v_expand(w1, d2, d3);
+  f[0] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d0));
+  f[1] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d1));
+  f[2] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d2));
+  f[3] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d3));
+}
+
+static inline cv::v_uint8x16 PackToUchar(const cv::v_int32x4 v[4])
+{
+  return cv::v_pack_u(cv::v_pack(v[0], v[1]), cv::v_pack(v[2], v[3]));
+}
+
+///
+/// \brief    16个BGR像素的色调、饱和度与明度/亮度
+///
+static inline void HueSaturation16(const uchar* bgr, const bool hsi, cv::v_uint8x16& h,
+                                   cv::v_uint8x16& s, cv::v_uint8x16& x)
+{
+  cv::v_uint8x16 b8, g8, r8;
+  cv::v_load_deinterleave(bgr, b8, g8, r8);
+  cv::v_float32x4 b[4], g[4], r[4];
+  ExpandToFloat(b8, b);
+  ExpandToFloat(g8, g);
+  ExpandToFloat(r8, r);
+  cv::v_int32x4 hi[4], si[4], xi[4];
+  for (int k = 0; k < 4; k++)
+    HueSaturation4(b[k], g[k], r[k], hsi, hi[k], si[k], xi[k]);
+  h = PackToUchar(hi);
+  s = PackToUchar(si);
+  x = PackToUchar(xi);
+}
+#endif
+
+///
+/// \brief    BGR一行变换为HSV或HSI，输出交错存储
+///
+static void HueSaturationRow(const uchar* bgr, uchar* dst, const int n, const bool hsi)
+{
+  int j = 0;
+#if CV_SIMD128
+  for (; j <= n - 16; j += 16)
+  {
+    cv::v_uint8x16 h, s, x;
+    HueSaturation16(bgr + 3 * j, hsi, h, s, x);
+    cv::v_store_interleave(dst + 3 * j, h, s, x);
+  }
+#endif
+  for (; j < n; j++)
+  {
+    int h, s, x;
+    HueSaturation(bgr[3 * j], bgr[3 * j + 1], bgr[3 * j + 2], hsi, h, s, x);
+    dst[3 * j] = (uchar)h;
+    dst[3 * j + 1] = (uchar)s;
+    dst[3 * j + 2] = (uchar)x;
+  }
+}
+
+///
+/// \brief    HSI一行变换为BGR，色调按六边形分段反算
+///
+static void HsiToBgrRow(const uchar* hsi, uchar* dst, const int n)
+{
+  for (int j = 0; j < n; j++)
+  {
+    const float h6 = hsi[3 * j] * (6.f / 256);
+    const float intensity = hsi[3 * j + 2];
+    const float m = intensity * (1.f - hsi[3 * j + 1] / 255.f);
+    const int sector = std::min((int)h6, 5);
+    const float f = h6 - sector;
+    // In every sector the middle component rises or falls linearly between min and max
+    const float rising = (sector & 1) == 0 ? f : 1.f - f;
+    const float diff = 3.f * (intensity - m) / (1.f + rising);
+    const float max = m + diff, mid = m + rising * diff;
+    float r, g, b;
+    switch (sector)
+    {
+    case 0: r = max; g = mid; b = m; break;
+    case 1: r = mid; g = max; b = m; break;
+    case 2: r = m; g = max; b = mid; break;
+    case 3: r = m; g = mid; b = max; break;
+    case 4: r = mid; g = m; b = max; break;
+    default: r = max; g = m; b = mid; break;
+    }
+    dst[3 * j] = cv::saturate_cast<uchar>(b);
+    dst[3 * j + 1] = cv::saturate_cast<uchar>(g);
+    dst[3 * j + 2] = cv::saturate_cast<uchar>(r);
+  }
+}
+
+class ColorTransRunner : public cv::ParallelLoopBody
+{
+public:
+  ColorTransRunner(const cv::Mat& _src, cv::Mat& _dst, ColorSpace _space, bool _inverse)
+    : src(_src), dst(_dst), space(_space), inverse(_inverse)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      if (inverse)
+        HsiToBgrRow(src.ptr<uchar>(i), dst.ptr<uchar>(i), src.cols);
+      else
+        HueSaturationRow(src.ptr<uchar>(i), dst.ptr<uchar>(i), src.cols, space == kColorHsi);
+    }
+  }
+
+private:
+  cv::Mat src;
+  cv::Mat& dst;
+  ColorSpace space;
+  bool inverse;
+};
+
+///
+/// \brief    BGR图像变换到其他颜色空间，通道依次为H、S、V/I或L、a、b
+/// \param    [in]  src  CV_8UC3 BGR图像
+///
+static void TransFromBgr(const cv::Mat& src, cv::Mat& dst, const ColorSpace space)
+{
+  CV_Assert(src.type() == CV_8UC3);
+  cv::Mat result(src.size(), CV_8UC3);
+  if (space == kColorCielab)
+    cv::cvtColor(src, result, cv::COLOR_BGR2Lab);
+  else
+    cv::parallel_for_(cv::Range(0, src.rows), ColorTransRunner(src, result, space, false),
+                      src.total() / (double)(1 << 16));
+  dst = result;
+}
+
+///
+/// \brief    TransFromBgr的逆变换
+///
+static void TransToBgr(const cv::Mat& src, cv::Mat& dst, const ColorSpace space)
+{
+  CV_Assert(src.type() == CV_8UC3);
+  cv::Mat result(src.size(), CV_8UC3);
+  if (space == kColorCielab)
+    cv::cvtColor(src, result, cv::COLOR_Lab2BGR);
+  else if (space == kColorHsv)
+    cv::cvtColor(src, result, cv::COLOR_HSV2BGR_FULL);
+  else
+    cv::parallel_for_(cv::Range(0, src.rows), ColorTransRunner(src, result, space, true),
+                      src.total() / (double)(1 << 16));
+  dst = result;
+}
+
+///
+/// \brief 颜色阈值的一行：变换到HSV/HSI并检查三个通道是否都在范围内
+///
+/// 色调的下限大于上限时表示跨过0的区间（如红色的250~5）
+///
+class ColorBoxRow
+{
+public:
+  ColorBoxRow(const cv::Mat& _image, const ColorSpace space, const std::vector<double>& Min,
+              const std::vector<double>& Max)
+    : image(_image), hsi(space == kColorHsi), hue_wrap(Min[0] > Max[0])
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      lo[c] = cv::saturate_cast<uchar>(std::ceil(Min[c]));
+      hi[c] = cv::saturate_cast<uchar>(std::floor(Max[c]));
+    }
+  }
+
+  void operator () (const int i, uchar* row) const
+  {
+    const uchar* bgr = image.ptr<uchar>(i);
+    const int n = image.cols;
+    int j = 0;
+#if CV_SIMD128
+    const cv::v_uint8x16 lo0 = cv::v_setall_u8(lo[0]), hi0 = cv::v_setall_u8(hi[0]);
+    const cv::v_uint8x16 lo1 = cv::v_setall_u8(lo[1]), hi1 = cv::v_setall_u8(hi[1]);
+    const cv::v_uint8x16 lo2 = cv::v_setall_u8(lo[2]), hi2 = cv::v_setall_u8(hi[2]);
+    for (; j <= n - 16; j += 16)
+    {
+      cv::v_uint8x16 h, s, x;
+      HueSaturation16(bgr + 3 * j, hsi, h, s, x);
+      const cv::v_uint8x16 in_h = hue_wrap ? ((h >= lo0) | (h <= hi0)) : ((h >= lo0) & (h <= hi0));
+      cv::v_store(row + j, in_h & (s >= lo1) & (s <= hi1) & (x >= lo2) & (x <= hi2));
+    }
+#endif
+    for (; j < n; j++)
+    {
+      int h, s, x;
+      HueSaturation(bgr[3 * j], bgr[3 * j + 1], bgr[3 * j + 2], hsi, h, s, x);
+      const bool in_h = hue_wrap ? (h >= lo[0] || h <= hi[0]) : (h >= lo[0] && h <= hi[0]);
+      row[j] = in_h && s >= lo[1] && s <= hi[1] && x >= lo[2] && x <= hi[2] ? 255 : 0;
+    }
+  }
+
+private:
+  cv::Mat image;
+  bool hsi;
+  bool hue_wrap;
+  uchar lo[3];
+  uchar hi[3];
+};
+
+///
+/// \brief    颜色阈值，等价于TransFromBgr后对各通道阈值取交，但不生成变换后的图像
+/// \param    [in]  image  CV_8UC3 BGR图像
+/// \param    [in]  space  kColorHsv或kColorHsi
+/// \param    [in]  Min    三个通道的下限
+/// \param    [in]  Max    三个通道的上限，色调下限大于上限时为跨过0的区间
+/// \param    [out] mask    非NULL时输出CV_8UC1掩膜
+/// \param    [out] region  非NULL时输出游程区域
+///
+static void ColorThreshold(const cv::Mat& image, const ColorSpace space,
+                           const std::vector<double>& Min, const std::vector<double>& Max,
+                           cv::Mat* mask, SRegion* region)
+{
+  CV_Assert(image.type() == CV_8UC3);
+  CV_Assert(Min.size() == 3 && Max.size() == 3);
+  if (space != kColorHsv && space != kColorHsi)
+    CV_Error(cv::Error::StsBadArg, "Color threshold supports hsv and hsi only");
+
+  RunLocalThreshold(image.size(), ColorBoxRow(image, space, Min, Max), mask, region);
+}
+
+} // my_cv
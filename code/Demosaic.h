@@ -0,0 +1,445 @@
+﻿///*****************************************************************************
+///
+/// \file       Demosaic.h
+/// \brief      Bayer彩色滤波阵列插值
+///
+///             相机输出Bayer原始数据（RG8为CV_8UC1，RG12为CV_16UC1），由本地按行条带并行
+///             插值，输出BGR三通道图像，或直接输出灰度/单一通道而不生成三通道中间图像。
+///             双线性插值用SIMD每次处理一整段像素，按列奇偶选择各通道的估计值；方向插值
+///             先沿梯度较小的方向估计绿色（Hamilton-Adams），再插值色差得到红色和蓝色。
+///             边界按BORDER_REFLECT_101延拓，不改变Bayer排列
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace my_cv {
+
+/// 行缓冲左右延拓的像素数
+static const int kBayerPad = 2;
+/// 行缓冲环的行数，方向插值需要上下各3行
+static const int kBayerRing = 7;
+
+///
+/// \brief 插值结果的输出形式
+///
+enum BayerOutput
+{
+  kBayerBgr,    ///< BGR三通道
+  kBayerGray,   ///< 灰度，0.299R + 0.587G + 0.114B
+  kBayerRed,
+  kBayerGreen,
+  kBayerBlue
+};
+
+///
+/// \brief 红色像素在2x2单元中的位置
+///
+struct BayerPattern
+{
+  int red_x;
+  int red_y;
+
+  /// 第i行中红色或蓝色像素所在列的奇偶
+  int ColorColumn(const int i) const { return (i & 1) == red_y ? red_x : 1 - red_x; }
+  bool RedRow(const int i) const { return (i & 1) == red_y; }
+};
+
+///
+/// \brief    解析"bayer_rg"、"bayer_gr"、"bayer_gb"、"bayer_bg"，名称为第一行前两个像素
+///
+static BayerPattern ParseCfaType(const std::string& CFAType)
+{
+  const BayerPattern rg = { 0, 0 }, gr = { 1, 0 }, gb = { 0, 1 }, bg = { 1, 1 };
+  if (CFAType == "bayer_rg")
+    return rg;
+  if (CFAType == "bayer_gr")
+    return gr;
+  if (CFAType == "bayer_gb")
+    return gb;
+  if (CFAType == "bayer_bg")
+    return bg;
+  CV_Error(cv::Error::StsBadArg, "Unsupported CFA type: " + CFAType);
+}
+
+///
+/// \brief    解析"bilinear"或"bilinear_dir"，后者为方向插值
+///
+static bool IsDirectionalDemosaic(const std::string& Interpolation)
+{
+  if (Interpolation == "bilinear")
+    return false;
+  if (Interpolation == "bilinear_dir")
+    return true;
+  CV_Error(cv::Error::StsBadArg, "Unsupported interpolation: " + Interpolation);
+}
+
+///
+/// \brief    解析"gray"、"red"、"green"、"blue"
+///
+static BayerOutput ParseBayerChannel(const std::string& Channel)
+{
+  if (Channel == "gray")
+    return kBayerGray;
+  if (Channel == "red")
+    return kBayerRed;
+  if (Channel == "green")
+    return kBayerGreen;
+  if (Channel == "blue")
+    return kBayerBlue;
+  CV_Error(cv::Error::StsBadArg, "Unsupported channel: " + Channel);
+}
+
+///
+/// \brief    将第i行（可越界）复制到行缓冲并左右延拓，row指向第0列
+///
+template <typename T>
+static void PadBayerRow(const cv::Mat& src, const int i, T* row)
+{
+  const T* s = src.ptr<T>(cv::borderInterpolate(i, src.rows, cv::BORDER_REFLECT_101));
+  std::copy(s, s + src.cols, row);
+  for (int k = 1; k <= kBayerPad; k++)
+  {
+    row[-k] = s[cv::borderInterpolate(-k, src.cols, cv::BORDER_REFLECT_101)];
+    row[src.cols - 1 + k] =
+      s[cv::borderInterpolate(src.cols - 1 + k, src.cols, cv::BORDER_REFLECT_101)];
+  }
+}
+
+template <typename T>
+static inline void EmitBayerPixel(T* dst, const int j, const int r, const int g, const int b,
+                                  const BayerOutput output)
+{
+  switch (output)
+  {
+  case kBayerBgr:
+    dst[3 * j] = (T)b;
+    dst[3 * j + 1] = (T)g;
+    dst[3 * j + 2] = (T)r;
+    break;
+  case kBayerGray:
+    dst[j] = (T)((77 * r + 150 * g + 29 * b + 128) >> 8);
+    break;
+  case kBayerRed:
+    dst[j] = (T)r;
+    break;
+  case kBayerGreen:
+    dst[j] = (T)g;
+    break;
+  case kBayerBlue:
+    dst[j] = (T)b;
+    break;
+  }
+}
+
+///
+/// \brief    双线性插值一行中从j0起的像素
+/// \param    [in]  color_x  本行红色或蓝色像素所在列的奇偶
+/// \param    [in]  red_row  本行是否含红色像素
+///
+template <typename T>
+static void BilinearBayerRow(const T* up, const T* cur, const T* down, const int j0,
+                             const int cols, const int color_x, const bool red_row,
+                             const BayerOutput output, T* dst)
+{
+  for (int j = j0; j < cols; j++)
+  {
+    const int h = cur[j - 1] + cur[j + 1];
+    const int v = up[j] + down[j];
+    int own, g, other;
+    if ((j & 1) == color_x)
+    {
+      own = cur[j];
+      g = (h + v + 2) >> 2;
+      other = (up[j - 1] + up[j + 1] + down[j - 1] + down[j + 1] + 2) >> 2;
+    }
+    else
+    {
+      own = (h + 1) >> 1;
+      g = cur[j];
+      other = (v + 1) >> 1;
+    }
+    EmitBayerPixel(dst, j, red_row ? own : other, g, red_row ? other : own, output);
+  }
+}
+
+#if CV_SIMD128
+///
+/// \brief 双线性插值的SIMD类型：8位数据在16位通道中计算，16位数据在32位通道中计算
+///
+template <typename T>
+struct BayerVector;
+
+template <>
+struct BayerVector<uchar>
+{
+  typedef cv::v_uint8x16 Narrow;
+  typedef cv::v_uint16x8 Wide;
+  static Wide Load(const uchar* p) { return cv::v_load_expand(p); }
+  static Wide Setall(const unsigned v) { return cv::v_setall_u16((ushort)v); }
+};
+
+template <>
+struct BayerVector<ushort>
+{
+  typedef cv::v_uint16x8 Narrow;
+  typedef cv::v_uint32x4 Wide;
+  static Wide Load(const ushort* p) { return cv::v_load_expand(p); }
+  static Wide Setall(const unsigned v) { return cv::v_setall_u32(v); }
+};
+
+///
+/// \brief    双线性插值一行，每次处理Narrow::nlanes个像素，返回已处理的列数
+///
+/// 所有候选值（水平、垂直、十字、对角均值）都按整段计算，再按列奇偶选择，
+/// 灰度和单通道输出直接由寄存器中的三个通道得到
+///
+template <typename T>
+static int BilinearBayerRowSimd(const T* up, const T* cur, const T* down, const int cols,
+                                const int color_x, const bool red_row, const BayerOutput output,
+                                T* dst)
+{
+  typedef BayerVector<T> V;
+  typedef typename V::Wide W;
+  typedef typename W::lane_type Lane;
+  const int half = W::nlanes;
+
+  // Lane k covers column j + k and every block starts on an even column
+  Lane bits[W::nlanes];
+  for (int k = 0; k < W::nlanes; k++)
+    bits[k] = (k & 1) == color_x ? (Lane)~(Lane)0 : (Lane)0;
+  const W mask = cv::v_load(bits);
+  const W one = V::Setall(1), two = V::Setall(2);
+
+  int j = 0;
+  for (; j <= cols - 2 * half; j += 2 * half)
+  {
+    W r[2], g[2], b[2];
+    for (int k = 0; k < 2; k++)
+    {
+      const int x = j + k * half;
+      const W c = V::Load(cur + x);
+      const W h = V::Load(cur + x - 1) + V::Load(cur + x + 1);
+      const W v = V::Load(up + x) + V::Load(down + x);
+      const W d = V::Load(up + x - 1) + V::Load(up + x + 1) + V::Load(down + x - 1) +
+                  V::Load(down + x + 1);
+      const W own = cv::v_select(mask, c, (h + one) >> 1);
+      const W other = cv::v_select(mask, (d + two) >> 2, (v + one) >> 1);
+      g[k] = cv::v_select(mask, (h + v + two) >> 2, c);
+      r[k] = red_row ? own : other;
+      b[k] = red_row ? other : own;
+    }
+
+    switch (output)
+    {
+    case kBayerBgr:
+      cv::v_store_interleave(dst + 3 * j, cv::v_pack(b[0], b[1]), cv::v_pack(g[0], g[1]),
+                             cv::v_pack(r[0], r[1]));
+      break;
+    case kBayerGray:
+    {
+      // 77 + 150 + 29 = 256, so the weighted sum of 8-bit data still fits 16 bits
+      const W wr = V::Setall(77), wg = V::Setall(150), wb = V::Setall(29);
+      const W round = V::Setall(128);
+      const W y0 = (r[0] * wr + g[0] * wg + b[0] * wb + round) >> 8;
+      const W y1 = (r[1] * wr + g[1] * wg + b[1] * wb + round) >> 8;
+      cv::v_store(dst + j, cv::v_pack(y0, y1));
+      break;
+    }
+    case kBayerRed:
+      cv::v_store(dst + j, cv::v_pack(r[0], r[1]));
+      break;
+    case kBayerGreen:
+      cv::v_store(dst + j, cv::v_pack(g[0], g[1]));
+      break;
+    case kBayerBlue:
+      cv::v_store(dst + j, cv::v_pack(b[0], b[1]));
+      break;
+    }
+  }
+  return j;
+}
+#endif
+
+///
+/// \brief    方向插值第一步：估计一行的绿色
+/// \param    [in]  rows   该行及上下各2行，rows[2]为该行
+/// \param    [out] green  长cols + 2，green[-1]和green[cols]为延拓值
+///
+template <typename T>
+static void DirectionalGreenRow(const T* const rows[5], const int cols, const int color_x,
+                                const int maxval, int* green)
+{
+  const T* c2 = rows[2];
+  for (int j = 1 - color_x; j < cols; j += 2)
+    green[j] = c2[j];
+  for (int j = color_x; j < cols; j += 2)
+  {
+    const int c = c2[j];
+    const int lap_h = 2 * c - c2[j - 2] - c2[j + 2];
+    const int lap_v = 2 * c - rows[0][j] - rows[4][j];
+    const int dh = std::abs(c2[j - 1] - c2[j + 1]) + std::abs(lap_h);
+    const int dv = std::abs(rows[1][j] - rows[3][j]) + std::abs(lap_v);
+    // Four times the estimate along each direction, corrected by the colour Laplacian
+    const int gh = 2 * (c2[j - 1] + c2[j + 1]) + lap_h;
+    const int gv = 2 * (rows[1][j] + rows[3][j]) + lap_v;
+    const int g4 = dh < dv ? gh : dv < dh ? gv : (gh + gv) >> 1;
+    green[j] = std::min(std::max((g4 + 2) >> 2, 0), maxval);
+  }
+  green[-1] = green[cols > 1 ? 1 : 0];
+  green[cols] = green[cols > 1 ? cols - 2 : 0];
+}
+
+///
+/// \brief    方向插值第二步：由色差的双线性插值得到红色和蓝色
+///
+template <typename T>
+static void DirectionalChromaRow(const T* up, const T* cur, const T* down, const int* gu,
+                                 const int* gc, const int* gd, const int cols, const int color_x,
+                                 const bool red_row, const int maxval, const BayerOutput output,
+                                 T* dst)
+{
+  for (int j = 0; j < cols; j++)
+  {
+    const int g = gc[j];
+    int own, other;
+    if ((j & 1) == color_x)
+    {
+      own = cur[j];
+      other = g + ((up[j - 1] - gu[j - 1] + up[j + 1] - gu[j + 1] + down[j - 1] - gd[j - 1] +
+                    down[j + 1] - gd[j + 1] + 2) >> 2);
+    }
+    else
+    {
+      own = g + ((cur[j - 1] - gc[j - 1] + cur[j + 1] - gc[j + 1] + 1) >> 1);
+      other = g + ((up[j] - gu[j] + down[j] - gd[j] + 1) >> 1);
+    }
+    own = std::min(std::max(own, 0), maxval);
+    other = std::min(std::max(other, 0), maxval);
+    EmitBayerPixel(dst, j, red_row ? own : other, g, red_row ? other : own, output);
+  }
+}
+
+///
+/// \brief 按行条带插值，每个条带维护延拓后的原始行和绿色行的环形缓冲
+///
+template <typename T>
+class DemosaicRunner : public cv::ParallelLoopBody
+{
+public:
+  DemosaicRunner(const cv::Mat& _src, cv::Mat& _dst, const BayerPattern& _pattern,
+                 const bool _directional, const BayerOutput _output)
+    : src(_src), dst(_dst), pattern(_pattern), directional(_directional), output(_output)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int cols = src.cols;
+    const int stride = cols + 2 * kBayerPad;
+    const int reach = directional ? 3 : 1;
+    const int maxval = src.depth() == CV_8U ? UCHAR_MAX : USHRT_MAX;
+    std::vector<T> raw((size_t)kBayerRing * stride);
+    std::vector<int> green(directional ? 3 * (size_t)(cols + 2) : 0);
+
+    for (int k = range.start - reach; k < range.start + reach; k++)
+      PadBayerRow(src, k, RawRow(raw, k, stride));
+    if (directional)
+    {
+      for (int k = range.start - 1; k <= range.start; k++)
+        FillGreenRow(raw, green, k, stride, maxval);
+    }
+
+    for (int i = range.start; i < range.end; i++)
+    {
+      PadBayerRow(src, i + reach, RawRow(raw, i + reach, stride));
+      const T* up = RawRow(raw, i - 1, stride);
+      const T* cur = RawRow(raw, i, stride);
+      const T* down = RawRow(raw, i + 1, stride);
+      const int color_x = pattern.ColorColumn(i);
+      const bool red_row = pattern.RedRow(i);
+      T* d = dst.ptr<T>(i);
+      if (directional)
+      {
+        FillGreenRow(raw, green, i + 1, stride, maxval);
+        DirectionalChromaRow(up, cur, down, GreenRow(green, i - 1), GreenRow(green, i),
+                             GreenRow(green, i + 1), cols, color_x, red_row, maxval, output, d);
+      }
+      else
+      {
+        int j = 0;
+#if CV_SIMD128
+        j = BilinearBayerRowSimd(up, cur, down, cols, color_x, red_row, output, d);
+#endif
+        BilinearBayerRow(up, cur, down, j, cols, color_x, red_row, output, d);
+      }
+    }
+  }
+
+private:
+  static T* RawRow(const std::vector<T>& raw, const int k, const int stride)
+  {
+    return const_cast<T*>(&raw[(size_t)((k % kBayerRing + kBayerRing) % kBayerRing) * stride]) +
+           kBayerPad;
+  }
+
+  int* GreenRow(const std::vector<int>& green, const int k) const
+  {
+    return const_cast<int*>(&green[(size_t)((k % 3 + 3) % 3) * (src.cols + 2)]) + 1;
+  }
+
+  void FillGreenRow(const std::vector<T>& raw, const std::vector<int>& green, const int k,
+                    const int stride, const int maxval) const
+  {
+    const T* const rows[5] = { RawRow(raw, k - 2, stride), RawRow(raw, k - 1, stride),
+                               RawRow(raw, k, stride), RawRow(raw, k + 1, stride),
+                               RawRow(raw, k + 2, stride) };
+    DirectionalGreenRow(rows, src.cols, pattern.ColorColumn(k), maxval, GreenRow(green, k));
+  }
+
+  cv::Mat src;
+  cv::Mat& dst;
+  BayerPattern pattern;
+  bool directional;
+  BayerOutput output;
+};
+
+///
+/// \brief    Bayer插值
+/// \param    [in]  src            CV_8UC1或CV_16UC1原始图像，宽高不小于2
+/// \param    [out] dst            与src深度相同，kBayerBgr时为三通道，否则为单通道
+/// \param    [in]  CFAType        "bayer_rg"、"bayer_gr"、"bayer_gb"或"bayer_bg"
+/// \param    [in]  Interpolation  "bilinear"或"bilinear_dir"
+/// \param    [in]  output         输出形式
+///
+static void DemosaicBayer(const cv::Mat& src, cv::Mat& dst, const std::string& CFAType,
+                          const std::string& Interpolation, const BayerOutput output)
+{
+  CV_Assert(src.type() == CV_8UC1 || src.type() == CV_16UC1);
+  CV_Assert(src.rows >= 2 && src.cols >= 2);
+  const BayerPattern pattern = ParseCfaType(CFAType);
+  const bool directional = IsDirectionalDemosaic(Interpolation);
+
+  cv::Mat result(src.size(), CV_MAKETYPE(src.depth(), output == kBayerBgr ? 3 : 1));
+  const double nstripes = src.total() / (double)(1 << 16);
+  if (src.depth() == CV_8U)
+    cv::parallel_for_(cv::Range(0, src.rows),
+                      DemosaicRunner<uchar>(src, result, pattern, directional, output), nstripes);
+  else
+    cv::parallel_for_(cv::Range(0, src.rows),
+                      DemosaicRunner<ushort>(src, result, pattern, directional, output), nstripes);
+  dst = result;
+}
+
+} // my_cv
@@ -0,0 +1,188 @@
+﻿///*****************************************************************************
+///
+/// \file       DerivedDataCache.h
+/// \brief      图像派生数据缓存
+///
+///             积分图、直方图、金字塔、梯度等由同一帧图像派生的数据在第一次使用时
+///             生成，之后由各算子共用。每项持有生成时图像数据的引用，图像被替换
+///             后自动失效，且旧数据的地址不会被新帧复用而误命中；总字节数超过
+///             上限时淘汰最久未使用的项
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace my_cv {
+
+///
+/// \brief Sobel梯度，CV_16SC1
+///
+struct ImageGradient
+{
+  cv::Mat dx;
+  cv::Mat dy;
+
+  size_t Bytes() const { return dx.total() * dx.elemSize() + dy.total() * dy.elemSize(); }
+};
+
+///
+/// \brief 一幅图像的派生数据缓存
+///
+/// 线程安全，同一键的并发未命中只会多计算一次，不影响结果。缓存的类型需提供Bytes()
+///
+class DerivedDataCache
+{
+public:
+  DerivedDataCache()
+    : max_bytes_(DefaultLimit()), bytes_(0)
+  { }
+
+  ///
+  /// \brief    新建缓存的默认字节数上限，默认256MB
+  ///
+  static void SetDefaultLimit(const size_t max_bytes) { DefaultLimitRef() = max_bytes; }
+  static size_t DefaultLimit() { return DefaultLimitRef(); }
+
+  ///
+  /// \brief    设置字节数上限，0表示不缓存，超出时淘汰最久未使用的项
+  ///
+  void SetLimit(const size_t max_bytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    Evict(0);
+  }
+
+  ///
+  /// \brief    清空缓存，图像数据被原地修改后调用
+  ///
+  void Invalidate()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    bytes_ = 0;
+  }
+
+  size_t Bytes() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+  }
+
+  ///
+  /// \brief    查找派生数据，未命中或图像已变化时调用build()生成
+  /// \param    [in]  image  派生数据的来源图像
+  /// \param    [in]  key    数据种类及参数
+  /// \param    [in]  build  返回T的生成函数
+  ///
+  template <typename T, typename Build>
+  std::shared_ptr<const T> Get(const cv::Mat& image, const std::string& key, Build build)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (std::list<Entry>::iterator it = entries_.begin(); it != entries_.end(); )
+      {
+        if (!it->IsFrom(image))
+        {
+          // The frame behind this entry is gone, drop it on the way
+          bytes_ -= it->bytes;
+          it = entries_.erase(it);
+          continue;
+        }
+        if (it->key == key)
+        {
+          entries_.splice(entries_.begin(), entries_, it);
+          return std::static_pointer_cast<const T>(entries_.front().data);
+        }
+        ++it;
+      }
+    }
+
+    std::shared_ptr<const T> data = std::make_shared<T>(build());
+    Put(image, key, data);
+    return data;
+  }
+
+  ///
+  /// \brief    放入已知的派生数据，例如由各通道合成图像时，各通道即为其平面存储
+  ///
+  template <typename T>
+  void Put(const cv::Mat& image, const std::string& key, const std::shared_ptr<const T>& data)
+  {
+    const size_t bytes = data->Bytes();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::list<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+    {
+      if (it->key == key && it->IsFrom(image))
+      {
+        bytes_ -= it->bytes;
+        entries_.erase(it);
+        break;
+      }
+    }
+    if (bytes > max_bytes_)
+      return;
+    Evict(bytes);
+    Entry entry;
+    entry.key = key;
+    entry.data = data;
+    entry.bytes = bytes;
+    entry.source = image;
+    entries_.push_front(entry);
+    bytes_ += bytes;
+  }
+
+private:
+  struct Entry
+  {
+    std::string key;
+    std::shared_ptr<const void> data;
+    size_t bytes;
+    // Only refcounted pixels are pinned by this header. Mapped files, camera buffers and
+    // ring slots are not, which is safe only because every acquisition installs a new cache
+    cv::Mat source;
+
+    bool IsFrom(const cv::Mat& image) const
+    {
+      return source.data == image.data && source.size() == image.size() &&
+             source.type() == image.type() && source.step == image.step;
+    }
+  };
+
+  static std::atomic<size_t>& DefaultLimitRef()
+  {
+    static std::atomic<size_t> limit((size_t)256 << 20);
+    return limit;
+  }
+
+  // Makes room for an entry of the given size
+  void Evict(const size_t incoming)
+  {
+    while (!entries_.empty() && bytes_ + incoming > max_bytes_)
+    {
+      bytes_ -= entries_.back().bytes;
+      entries_.pop_back();
+    }
+  }
+
+  mutable std::mutex mutex_;
+  std::list<Entry> entries_;
+  size_t max_bytes_;
+  size_t bytes_;
+};
+
+} // my_cv
@@ -0,0 +1,383 @@
+﻿///*****************************************************************************
+///
+/// \file       GaussPyramid.h
+/// \brief      高斯图像金字塔
+///
+///             所有层在一次级联的逐行扫描中生成：上一层每产生一行就立即参与下一
+///             层的计算，数据始终停留在缓存中。除原图外的各层共用一块连续内存，
+///             每层是这块内存的一个ROI视图
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace my_cv {
+
+///
+/// \brief 金字塔降采样核，5个抽头对应偏移 -2..2
+///
+struct PyramidKernel
+{
+  int weights[5];
+  int shift;      ///< 水平、垂直两次滤波后的归一化右移位数
+};
+
+///
+/// \brief    由Halcon的模式名得到降采样核
+/// \param    [in]  Mode  "weighted"（与cv::pyrDown相同的5x5高斯）、"constant"（2x2均值）、
+///                       "nearest_neighbor"（直接抽样）
+///
+static PyramidKernel PyramidKernelForMode(const std::string& Mode)
+{
+  if (Mode == "weighted")
+  {
+    PyramidKernel k = { { 1, 4, 6, 4, 1 }, 8 };
+    return k;
+  }
+  if (Mode == "constant")
+  {
+    PyramidKernel k = { { 0, 0, 1, 1, 0 }, 2 };
+    return k;
+  }
+  if (Mode == "nearest_neighbor")
+  {
+    PyramidKernel k = { { 0, 0, 1, 0, 0 }, 0 };
+    return k;
+  }
+  CV_Error(cv::Error::StsBadArg, "Unsupported pyramid mode: " + Mode);
+}
+
+class GaussPyramidRunner : public cv::ParallelLoopBody
+{
+public:
+  ///
+  /// \param    [in]  _levels   各层图像，levels[base]为输入，其余为待写入的视图
+  /// \param    [in]  _base     输入层
+  /// \param    [in]  _top      最后生成的层
+  /// \param    [in]  _bands    顶层按行划分的条带数
+  ///
+  GaussPyramidRunner(std::vector<cv::Mat>& _levels, int _base, int _top, int _bands,
+                     const PyramidKernel& _kernel)
+    : levels(_levels), base(_base), top(_top), bands(_bands), kernel(_kernel)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int band = range.start; band < range.end; band++)
+      RunBand(band);
+  }
+
+private:
+  ///
+  /// \brief 条带的级联状态，每层保存最近5行水平滤波结果
+  ///
+  struct BandState
+  {
+    std::vector<cv::Range> owned;               ///< 每层由本条带写出的行
+    std::vector<cv::Range> required;            ///< 每层需要计算的行（含重叠行）
+    std::vector<int> next;                      ///< 每层下一个待计算的行
+    std::vector<std::vector<ushort> > ring;     ///< 每层的5行环形缓冲
+    std::vector<std::vector<uchar> > scratch;   ///< 不属于本条带的行的临时存放
+  };
+
+  void RunBand(int band) const
+  {
+    BandState state;
+    const int n = top + 1;
+    state.owned.resize(n);
+    state.required.resize(n);
+    state.next.resize(n);
+    state.ring.resize(n);
+    state.scratch.resize(n);
+
+    // Rows at each level nest inside twice the rows of the level above
+    const int top_rows = levels[top].rows;
+    state.owned[top] = cv::Range(band * top_rows / bands, (band + 1) * top_rows / bands);
+    state.required[top] = state.owned[top];
+    for (int l = top - 1; l >= base; l--)
+    {
+      const int rows = levels[l].rows;
+      state.owned[l] = cv::Range(std::min(state.owned[l + 1].start * 2, rows),
+                                 std::min(state.owned[l + 1].end * 2, rows));
+      state.required[l] = cv::Range(std::max(state.required[l + 1].start * 2 - 2, 0),
+                                    std::min(state.required[l + 1].end * 2 + 1, rows));
+    }
+    if (band == bands - 1)
+      for (int l = base; l <= top; l++)
+        state.owned[l].end = levels[l].rows;
+
+    for (int l = base; l < top; l++)
+    {
+      state.ring[l].resize(5 * (size_t)levels[l + 1].cols);
+      state.next[l + 1] = state.required[l + 1].start;
+      state.scratch[l + 1].resize(levels[l + 1].cols);
+    }
+
+    const cv::Mat& src = levels[base];
+    for (int k = state.required[base].start; k < state.required[base].end; k++)
+      Push(state, base, k, src.ptr<uchar>(k));
+  }
+
+  ///
+  /// \brief    送入第level层的第k行，并计算由此可以完成的上一层各行
+  ///
+  void Push(BandState& state, int level, int k, const uchar* row) const
+  {
+    if (level == top)
+      return;
+
+    const int rows = levels[level].rows;
+    const int width = levels[level + 1].cols;
+    std::vector<ushort>& ring = state.ring[level];
+    FilterRow(row, levels[level].cols, &ring[(size_t)(k % 5) * width], width);
+
+    int& r = state.next[level + 1];
+    while (r < state.required[level + 1].end && std::min(2 * r + 2, rows - 1) <= k)
+    {
+      const ushort* taps[5];
+      for (int t = 0; t < 5; t++)
+      {
+        const int j = cv::borderInterpolate(2 * r - 2 + t, rows, cv::BORDER_REFLECT_101);
+        taps[t] = &ring[(size_t)(j % 5) * width];
+      }
+
+      const bool owned = r >= state.owned[level + 1].start && r < state.owned[level + 1].end;
+      uchar* out = owned ? levels[level + 1].ptr<uchar>(r) : state.scratch[level + 1].data();
+      CombineRows(taps, out, width);
+      Push(state, level + 1, r, out);
+      r++;
+    }
+  }
+
+  ///
+  /// \brief    水平滤波并隔点抽样
+  ///
+  void FilterRow(const uchar* src, int n, ushort* dst, int m) const
+  {
+    const int* w = kernel.weights;
+    // Interior outputs read src[2x - 2 .. 2x + 2] without reflection
+    const int x_begin = std::min(1, m);
+    const int x_end = std::max(std::min((n - 3) / 2 + 1, m), x_begin);
+
+    for (int x = 0; x < x_begin; x++)
+      dst[x] = FilterBorder(src, n, x);
+
+    int x = x_begin;
+#if CV_SIMD128
+    const cv::v_uint16x8 w0 = cv::v_setall_u16((ushort)w[0]), w1 = cv::v_setall_u16((ushort)w[1]),
+                         w2 = cv::v_setall_u16((ushort)w[2]), w3 = cv::v_setall_u16((ushort)w[3]),
+                         w4 = cv::v_setall_u16((ushort)w[4]);
+    for (; x <= (n - 34) / 2 && x + 16 <= x_end; x += 16)
+    {
+      const uchar* p = src + 2 * x - 2;
+      cv::v_uint8x16 e0, o0, e1, o1, e2, o2;
+      cv::v_load_deinterleave(p, e0, o0);
+      cv::v_load_deinterleave(p + 2, e1, o1);
+      cv::v_load_deinterleave(p + 4, e2, o2);
+
+      cv::v_uint16x8 e0l, e0h, o0l, o0h, e1l, e1h, o1l, o1h, e2l, e2h;
+      cv::v_expand(e0, e0l, e0h);
+      cv::v_expand(o0, o0l, o0h);
+      cv::v_expand(e1, e1l, e1h);
+      cv::v_expand(o1, o1l, o1h);
+      cv::v_expand(e2, e2l, e2h);
+
+      cv::v_store(dst + x, cv::v_mul_wrap(e0l, w0) + cv::v_mul_wrap(o0l, w1) +
+                  cv::v_mul_wrap(e1l, w2) + cv::v_mul_wrap(o1l, w3) + cv::v_mul_wrap(e2l, w4));
+      cv::v_store(dst + x + 8, cv::v_mul_wrap(e0h, w0) + cv::v_mul_wrap(o0h, w1) +
+                  cv::v_mul_wrap(e1h, w2) + cv::v_mul_wrap(o1h, w3) + cv::v_mul_wrap(e2h, w4));
+    }
+#endif
+    for (; x < x_end; x++)
+    {
+      const uchar* p = src + 2 * x - 2;
+      dst[x] = (ushort)(w[0] * p[0] + w[1] * p[1] + w[2] * p[2] + w[3] * p[3] + w[4] * p[4]);
+    }
+    for (; x < m; x++)
+      dst[x] = FilterBorder(src, n, x);
+  }
+
+  ushort FilterBorder(const uchar* src, int n, int x) const
+  {
+    int sum = 0;
+    for (int t = 0; t < 5; t++)
+      if (kernel.weights[t])
+        sum += kernel.weights[t] * src[cv::borderInterpolate(2 * x - 2 + t, n, cv::BORDER_REFLECT_101)];
+    return (ushort)sum;
+  }
+
+  ///
+  /// \brief    垂直滤波、舍入并饱和到8位
+  ///
+  void CombineRows(const ushort* taps[5], uchar* dst, int width) const
+  {
+    const int* w = kernel.weights;
+    const int shift = kernel.shift;
+    const int delta = shift > 0 ? 1 << (shift - 1) : 0;
+
+    int x = 0;
+#if CV_SIMD128
+    const cv::v_uint16x8 w0 = cv::v_setall_u16((ushort)w[0]), w1 = cv::v_setall_u16((ushort)w[1]),
+                         w2 = cv::v_setall_u16((ushort)w[2]), w3 = cv::v_setall_u16((ushort)w[3]),
+                         w4 = cv::v_setall_u16((ushort)w[4]);
+    const cv::v_uint16x8 d = cv::v_setall_u16((ushort)delta);
+    for (; x <= width - 16; x += 16)
+    {
+      cv::v_uint16x8 lo = d, hi = d;
+      lo += cv::v_mul_wrap(cv::v_load(taps[0] + x), w0) + cv::v_mul_wrap(cv::v_load(taps[1] + x), w1) +
+            cv::v_mul_wrap(cv::v_load(taps[2] + x), w2) + cv::v_mul_wrap(cv::v_load(taps[3] + x), w3) +
+            cv::v_mul_wrap(cv::v_load(taps[4] + x), w4);
+      hi += cv::v_mul_wrap(cv::v_load(taps[0] + x + 8), w0) + cv::v_mul_wrap(cv::v_load(taps[1] + x + 8), w1) +
+            cv::v_mul_wrap(cv::v_load(taps[2] + x + 8), w2) + cv::v_mul_wrap(cv::v_load(taps[3] + x + 8), w3) +
+            cv::v_mul_wrap(cv::v_load(taps[4] + x + 8), w4);
+      cv::v_store(dst + x, cv::v_pack(lo >> shift, hi >> shift));
+    }
+#endif
+    for (; x < width; x++)
+    {
+      const int sum = w[0] * taps[0][x] + w[1] * taps[1][x] + w[2] * taps[2][x] +
+                      w[3] * taps[3][x] + w[4] * taps[4][x];
+      dst[x] = cv::saturate_cast<uchar>((sum + delta) >> shift);
+    }
+  }
+
+  std::vector<cv::Mat>& levels;
+  int base;
+  int top;
+  int bands;
+  PyramidKernel kernel;
+};
+
+///
+/// \brief 高斯图像金字塔
+///
+/// 第0层为输入图像本身（不拷贝），其余各层按经典的金字塔拼图方式放在同一块
+/// 内存中：第1层在左侧，第2层及以后在其右侧自上而下排列
+///
+class GaussPyramid
+{
+public:
+  GaussPyramid()
+  { }
+
+  ///
+  /// \brief    生成金字塔
+  /// \param    [in]  src       输入图像
+  /// \param    [in]  Mode      降采样模式，见PyramidKernelForMode
+  /// \param    [in]  NumLevels 层数（含原图），0为一直缩小到1个像素
+  ///
+  void Build(const cv::Mat& src, const std::string& Mode, const int NumLevels = 0)
+  {
+    CV_Assert(!src.empty());
+    const PyramidKernel kernel = PyramidKernelForMode(Mode);
+
+    mode_ = Mode;
+    levels_.clear();
+    levels_.push_back(src);
+
+    std::vector<cv::Size> sizes;
+    cv::Size size = src.size();
+    while ((NumLevels <= 0 || (int)sizes.size() + 1 < NumLevels) &&
+           (size.width > 1 || size.height > 1))
+    {
+      size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+      sizes.push_back(size);
+    }
+    if (sizes.empty())
+    {
+      buffer_.release();
+      return;
+    }
+
+    // Level 1 on the left, the others stacked in a column on its right
+    const int column = AlignSize(sizes[0].width);
+    int stacked = 0, stacked_width = 0;
+    for (size_t l = 1; l < sizes.size(); l++)
+    {
+      stacked += sizes[l].height;
+      stacked_width = std::max(stacked_width, sizes[l].width);
+    }
+    buffer_.create(std::max(sizes[0].height, stacked), AlignSize(column + stacked_width),
+                   src.type());
+
+    levels_.push_back(buffer_(cv::Rect(cv::Point(0, 0), sizes[0])));
+    int row = 0;
+    for (size_t l = 1; l < sizes.size(); l++)
+    {
+      levels_.push_back(buffer_(cv::Rect(cv::Point(column, row), sizes[l])));
+      row += sizes[l].height;
+    }
+
+    const int top = (int)levels_.size() - 1;
+    if (src.type() != CV_8UC1)
+    {
+      for (int l = 1; l <= top; l++)
+        DownsampleGeneric(levels_[l - 1], levels_[l], Mode);
+      return;
+    }
+
+    // Split the large levels into parallel bands, the halo rows each band
+    // recomputes double with every level so the small ones run in one band
+    const int threads = std::max(cv::getNumThreads(), 1);
+    int split = top;
+    while (split > 1 && levels_[split].rows < 32 * threads)
+      split--;
+
+    const int bands = std::max(std::min(threads * 2, levels_[split].rows / 16), 1);
+    cv::parallel_for_(cv::Range(0, bands),
+                      GaussPyramidRunner(levels_, 0, split, bands, kernel));
+    if (split < top)
+    {
+      GaussPyramidRunner(levels_, split, top, 1, kernel)(cv::Range(0, 1));
+    }
+  }
+
+  bool Empty() const { return levels_.empty(); }
+  int NumLevels() const { return (int)levels_.size(); }
+  const std::string& Mode() const { return mode_; }
+  const cv::Mat& Level(const int level) const { return levels_[level]; }
+  const std::vector<cv::Mat>& Levels() const { return levels_; }
+  size_t Bytes() const { return buffer_.total() * buffer_.elemSize(); }
+  ///
+  /// \brief    金字塔是否由image生成（同一块像素数据、同样的尺寸）
+  ///
+  bool IsBuiltFrom(const cv::Mat& image) const
+  {
+    return !levels_.empty() && levels_[0].data == image.data &&
+           levels_[0].size() == image.size() && levels_[0].type() == image.type();
+  }
+
+private:
+  static int AlignSize(int width)
+  {
+    return (width + 15) & ~15;
+  }
+
+  static void DownsampleGeneric(const cv::Mat& src, cv::Mat dst, const std::string& Mode)
+  {
+    // dst is a view into the shared buffer, OpenCV writes into it in place
+    if (Mode == "weighted")
+      cv::pyrDown(src, dst, dst.size());
+    else if (Mode == "constant")
+      cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_AREA);
+    else
+      cv::resize(src, dst, dst.size(), 0, 0, cv::INTER_NEAREST);
+  }
+
+  std::string mode_;
+  cv::Mat buffer_;                ///< 第1层及以后各层共用的内存
+  std::vector<cv::Mat> levels_;   ///< 各层视图，levels_[0]为输入图像
+};
+
+} // my_cv
@@ -0,0 +1,285 @@
+﻿///*****************************************************************************
+///
+/// \file       GrayStatistics.h
+/// \brief      灰度直方图及其统计量
+///
+///             一次遍历同时得到灰度直方图、最小/最大值（可按百分比裁剪）、均值、
+///             标准差和熵。8位图像的各统计量均可由直方图精确推出，因此只需累加
+///             直方图：任务按行条带或游程分块并行，每个任务使用私有的4路交错子
+///             直方图计数，最后用SIMD归并
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "SRegion.h"
+
+namespace my_cv {
+
+static const int kGrayLevels = 256;
+/// 每个统计任务大约处理的像素数
+static const int kHistogramTaskPixels = 1 << 16;
+
+///
+/// \brief 一个区域的灰度统计结果
+///
+struct GrayStatistics
+{
+  std::vector<int64_t> histogram;  ///< 绝对直方图
+  int64_t count = 0;   ///< 像素数
+  double min = 0;      ///< 按百分比裁剪后的最小灰度
+  double max = 0;      ///< 按百分比裁剪后的最大灰度
+  double range = 0;    ///< max - min
+  double mean = 0;
+  double deviation = 0;
+  double entropy = 0;
+  double anisotropy = 0;
+
+  size_t Bytes() const { return histogram.size() * sizeof(int64_t); }
+
+  ///
+  /// \brief    相对直方图
+  ///
+  std::vector<double> Relative() const
+  {
+    std::vector<double> relative(histogram.size(), 0.0);
+    if (count > 0)
+      for (size_t g = 0; g < histogram.size(); g++)
+        relative[g] = (double)histogram[g] / count;
+    return relative;
+  }
+};
+
+///
+/// \brief    统计一段连续像素，4个子直方图交错计数以避免相邻像素同值时的写后读依赖
+///
+static inline void CountGrayLevels(const uchar* p, const int n, uint32_t* sub)
+{
+  int j = 0;
+  for (; j <= n - 4; j += 4)
+  {
+    sub[p[j]]++;
+    sub[kGrayLevels + p[j + 1]]++;
+    sub[2 * kGrayLevels + p[j + 2]]++;
+    sub[3 * kGrayLevels + p[j + 3]]++;
+  }
+  for (; j < n; j++)
+    sub[p[j]]++;
+}
+
+///
+/// \brief    将4个子直方图归并并累加到histogram
+///
+static inline void MergeGrayLevels(const uint32_t* sub, int64_t* histogram)
+{
+  int g = 0;
+#if CV_SIMD128
+  for (; g < kGrayLevels; g += 4)
+  {
+    const cv::v_uint32x4 sum = cv::v_load(sub + g) + cv::v_load(sub + kGrayLevels + g) +
+                               cv::v_load(sub + 2 * kGrayLevels + g) +
+                               cv::v_load(sub + 3 * kGrayLevels + g);
+    cv::v_uint64x2 lo, hi;
+    cv::v_expand(sum, lo, hi);
+    uint64_t* h = (uint64_t*)(histogram + g);
+    cv::v_store(h, cv::v_load(h) + lo);
+    cv::v_store(h + 2, cv::v_load(h + 2) + hi);
+  }
+#endif
+  for (; g < kGrayLevels; g++)
+    histogram[g] += (int64_t)sub[g] + sub[kGrayLevels + g] + sub[2 * kGrayLevels + g] +
+                    sub[3 * kGrayLevels + g];
+}
+
+///
+/// \brief 一个统计任务：整幅图像的一个行条带，或某个区域的一段游程
+///
+struct HistogramTask
+{
+  int slot;           ///< 结果序号
+  int row_begin;      ///< 整幅图像时的行范围
+  int row_end;
+  size_t run_begin;   ///< 区域时的游程范围
+  size_t run_end;
+};
+
+class GrayHistogramRunner : public cv::ParallelLoopBody
+{
+public:
+  GrayHistogramRunner(const cv::Mat& _image, const std::vector<SRegion>* _regions,
+                      const std::vector<HistogramTask>& _tasks, std::vector<int64_t>& _partial)
+    : image(_image), regions(_regions), tasks(_tasks), partial(_partial)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    std::vector<uint32_t> sub(4 * kGrayLevels);
+    for (int t = range.start; t < range.end; t++)
+    {
+      const HistogramTask& task = tasks[t];
+      std::fill(sub.begin(), sub.end(), 0u);
+      if (regions == NULL)
+      {
+        for (int i = task.row_begin; i < task.row_end; i++)
+          CountGrayLevels(image.ptr<uchar>(i), image.cols, &sub[0]);
+      }
+      else
+      {
+        const std::vector<RegionRun>& runs = (*regions)[task.slot].Runs();
+        for (size_t k = task.run_begin; k < task.run_end; k++)
+          CountGrayLevels(image.ptr<uchar>(runs[k].Row) + runs[k].ColumnBegin,
+                          runs[k].ColumnEnd - runs[k].ColumnBegin, &sub[0]);
+      }
+      MergeGrayLevels(&sub[0], &partial[(size_t)t * kGrayLevels]);
+    }
+  }
+
+private:
+  cv::Mat image;
+  const std::vector<SRegion>* regions;
+  const std::vector<HistogramTask>& tasks;
+  std::vector<int64_t>& partial;
+};
+
+///
+/// \brief    由直方图计算各统计量
+/// \param    [in]  Percent  MinMaxGray两端各裁剪的百分比
+///
+static void FinishGrayStatistics(GrayStatistics& stats, const double Percent)
+{
+  const std::vector<int64_t>& h = stats.histogram;
+  stats.count = 0;
+  double sum = 0, sum2 = 0;
+  for (int g = 0; g < kGrayLevels; g++)
+  {
+    stats.count += h[g];
+    sum += (double)h[g] * g;
+    sum2 += (double)h[g] * g * g;
+  }
+  if (stats.count == 0)
+    return;
+
+  const double n = (double)stats.count;
+  stats.mean = sum / n;
+  stats.deviation = std::sqrt(std::max(0.0, sum2 / n - stats.mean * stats.mean));
+
+  const double cut = n * std::min(std::max(Percent, 0.0), 50.0) / 100;
+  double acc = 0;
+  int lo = 0;
+  for (; lo < kGrayLevels - 1; lo++)
+  {
+    acc += h[lo];
+    if (acc > cut)
+      break;
+  }
+  acc = 0;
+  int hi = kGrayLevels - 1;
+  for (; hi > 0; hi--)
+  {
+    acc += h[hi];
+    if (acc > cut)
+      break;
+  }
+  stats.min = std::min(lo, hi);
+  stats.max = std::max(lo, hi);
+  stats.range = stats.max - stats.min;
+
+  // Anisotropy is the share of the entropy contributed by the gray values up to the
+  // largest k whose cumulative frequency is still at most 0.5, counted exactly in pixels
+  double entropy = 0, lower = 0;
+  int64_t cumulative = 0;
+  for (int g = 0; g < kGrayLevels; g++)
+  {
+    if (h[g] == 0)
+      continue;
+    const double p = h[g] / n;
+    const double e = p * std::log2(p);
+    entropy += e;
+    cumulative += h[g];
+    if (2 * cumulative <= stats.count)
+      lower += e;
+  }
+  stats.entropy = -entropy;
+  stats.anisotropy = entropy != 0 ? lower / entropy : 0;
+}
+
+///
+/// \brief    计算灰度统计量
+/// \param    [in]  image    CV_8UC1图像
+/// \param    [in]  regions  区域组，为NULL时统计整幅图像并返回一个结果
+/// \param    [in]  Percent  MinMaxGray两端各裁剪的百分比
+/// \return   每个区域一个结果，区域超出图像的部分被忽略
+///
+static std::vector<GrayStatistics> CalcGrayStatistics(const cv::Mat& image,
+                                                      const std::vector<SRegion>* regions,
+                                                      const double Percent)
+{
+  CV_Assert(image.type() == CV_8UC1);
+
+  std::vector<SRegion> clipped;
+  std::vector<HistogramTask> tasks;
+  if (regions == NULL)
+  {
+    const int stripe_rows = std::max(1, kHistogramTaskPixels / std::max(image.cols, 1));
+    for (int i = 0; i < image.rows; i += stripe_rows)
+    {
+      const HistogramTask task = { 0, i, std::min(i + stripe_rows, image.rows), 0, 0 };
+      tasks.push_back(task);
+    }
+  }
+  else
+  {
+    // Many small defect candidates become one task each, large regions are split
+    clipped.resize(regions->size());
+    for (size_t r = 0; r < regions->size(); r++)
+    {
+      clipped[r] = (*regions)[r].Clip(image.size());
+      const std::vector<RegionRun>& runs = clipped[r].Runs();
+      size_t begin = 0;
+      int64_t pixels = 0;
+      for (size_t k = 0; k < runs.size(); k++)
+      {
+        pixels += runs[k].ColumnEnd - runs[k].ColumnBegin;
+        if (pixels >= kHistogramTaskPixels || k + 1 == runs.size())
+        {
+          const HistogramTask task = { (int)r, 0, 0, begin, k + 1 };
+          tasks.push_back(task);
+          begin = k + 1;
+          pixels = 0;
+        }
+      }
+    }
+  }
+
+  std::vector<int64_t> partial(tasks.size() * kGrayLevels, 0);
+  cv::parallel_for_(cv::Range(0, (int)tasks.size()),
+                    GrayHistogramRunner(image, regions ? &clipped : NULL, tasks, partial));
+
+  std::vector<GrayStatistics> stats(regions ? regions->size() : 1);
+  for (size_t s = 0; s < stats.size(); s++)
+    stats[s].histogram.assign(kGrayLevels, 0);
+  for (size_t t = 0; t < tasks.size(); t++)
+  {
+    int64_t* h = &stats[tasks[t].slot].histogram[0];
+    const int64_t* p = &partial[t * kGrayLevels];
+    for (int g = 0; g < kGrayLevels; g++)
+      h[g] += p[g];
+  }
+  for (size_t s = 0; s < stats.size(); s++)
+    FinishGrayStatistics(stats[s], Percent);
+  return stats;
+}
+
+} // my_cv
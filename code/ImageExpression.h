@@ -0,0 +1,293 @@
+﻿///*****************************************************************************
+///
+/// \file       ImageExpression.h
+/// \brief      像素算术的表达式模板
+///
+///             AddImage、SubImage、MultImage、AbsDiffImage、ScaleImage返回表达式而不
+///             立即计算，赋值给SImage时按行并行、每次16个像素在浮点SIMD通道中求值整棵
+///             表达式树，只在最后饱和存储一次，不产生中间图像。中间结果不截断到
+///             [0, 255]，因此结果可能与逐个算子计算（每步都饱和）的结果不同
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <cmath>
+
+namespace my_cv {
+
+///
+/// \brief 表达式基类（CRTP）
+///
+/// 派生类提供：
+///   Mat()            参与运算的任一图像，用于确定尺寸和通道
+///   Eval(i, j, v)    第i行、展平后第j列起16个值，写入v[0..3]
+///   At(i, j)         单个值
+///
+template <typename Derived>
+struct ImageExpr
+{
+  const Derived& Self() const { return static_cast<const Derived&>(*this); }
+};
+
+///
+/// \brief 叶子：CV_8U图像
+///
+class ImageTerm : public ImageExpr<ImageTerm>
+{
+public:
+  explicit ImageTerm(const cv::Mat& _image)
+    : image(_image)
+  {
+    CV_Assert(image.depth() == CV_8U);
+  }
+
+  const cv::Mat& Mat() const { return image; }
+
+#if CV_SIMD128
+  void Eval(const int i, const int j, cv::v_float32x4 v[4]) const
+  {
+    cv::v_uint16x8 w0, w1;
+    cv::v_expand(cv::v_load(image.ptr<uchar>(i) + j), w0, w1);
+    cv::v_uint32x4 d0, d1, d2, d3;
+    cv::v_expand(w0, d0, d1);
+    cv::v_expand(w1, d2, d3);
+    v[0] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d0));
+    v[1] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d1));
+    v[2] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d2));
+    v[3] = cv::v_cvt_f32(cv::v_reinterpret_as_s32(d3));
+  }
+#endif
+
+  float At(const int i, const int j) const { return image.ptr<uchar>(i)[j]; }
+
+private:
+  cv::Mat image;  ///< Held by value, expressions stay valid after the operands go away
+};
+
+struct AddOp
+{
+#if CV_SIMD128
+  static cv::v_float32x4 Apply(const cv::v_float32x4& a, const cv::v_float32x4& b) { return a + b; }
+#endif
+  static float Apply(const float a, const float b) { return a + b; }
+};
+
+struct SubOp
+{
+#if CV_SIMD128
+  static cv::v_float32x4 Apply(const cv::v_float32x4& a, const cv::v_float32x4& b) { return a - b; }
+#endif
+  static float Apply(const float a, const float b) { return a - b; }
+};
+
+struct MulOp
+{
+#if CV_SIMD128
+  static cv::v_float32x4 Apply(const cv::v_float32x4& a, const cv::v_float32x4& b) { return a * b; }
+#endif
+  static float Apply(const float a, const float b) { return a * b; }
+};
+
+struct AbsDiffOp
+{
+#if CV_SIMD128
+  static cv::v_float32x4 Apply(const cv::v_float32x4& a, const cv::v_float32x4& b)
+  {
+    return cv::v_absdiff(a, b);
+  }
+#endif
+  static float Apply(const float a, const float b) { return std::fabs(a - b); }
+};
+
+///
+/// \brief 二元运算节点
+///
+template <typename L, typename R, typename Op>
+class BinaryExpr : public ImageExpr<BinaryExpr<L, R, Op> >
+{
+public:
+  BinaryExpr(const L& _left, const R& _right)
+    : left(_left), right(_right)
+  {
+    CV_Assert(left.Mat().size() == right.Mat().size() &&
+              left.Mat().channels() == right.Mat().channels());
+  }
+
+  const cv::Mat& Mat() const { return left.Mat(); }
+
+#if CV_SIMD128
+  void Eval(const int i, const int j, cv::v_float32x4 v[4]) const
+  {
+    cv::v_float32x4 r[4];
+    left.Eval(i, j, v);
+    right.Eval(i, j, r);
+    for (int k = 0; k < 4; k++)
+      v[k] = Op::Apply(v[k], r[k]);
+  }
+#endif
+
+  float At(const int i, const int j) const { return Op::Apply(left.At(i, j), right.At(i, j)); }
+
+private:
+  L left;
+  R right;
+};
+
+///
+/// \brief 线性变换节点：x * mult + add
+///
+template <typename E>
+class AffineExpr : public ImageExpr<AffineExpr<E> >
+{
+public:
+  AffineExpr(const E& _child, double _mult, double _add)
+    : child(_child), mult((float)_mult), add((float)_add)
+  { }
+
+  const cv::Mat& Mat() const { return child.Mat(); }
+
+#if CV_SIMD128
+  void Eval(const int i, const int j, cv::v_float32x4 v[4]) const
+  {
+    child.Eval(i, j, v);
+    const cv::v_float32x4 m = cv::v_setall_f32(mult);
+    const cv::v_float32x4 a = cv::v_setall_f32(add);
+    for (int k = 0; k < 4; k++)
+      v[k] = cv::v_muladd(v[k], m, a);
+  }
+#endif
+
+  float At(const int i, const int j) const { return child.At(i, j) * mult + add; }
+
+private:
+  E child;
+  float mult;
+  float add;
+};
+
+///
+/// \brief 操作数到表达式的转换，SImage在SImage.cpp中特化为ImageTerm
+///
+template <typename T>
+struct ImageExprOf
+{
+  typedef T type;
+  static const T& Get(const ImageExpr<T>& expr) { return expr.Self(); }
+};
+
+template <typename E>
+class ExprRunner : public cv::ParallelLoopBody
+{
+public:
+  ExprRunner(const E& _expr, cv::Mat& _dst)
+    : expr(_expr), dst(_dst)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int n = dst.cols * dst.channels();
+    for (int i = range.start; i < range.end; i++)
+    {
+      uchar* d = dst.ptr<uchar>(i);
+      int j = 0;
+#if CV_SIMD128
+      for (; j <= n - 16; j += 16)
+      {
+        cv::v_float32x4 v[4];
+        expr.Eval(i, j, v);
+        const cv::v_int16x8 lo = cv::v_pack(cv::v_round(v[0]), cv::v_round(v[1]));
+        const cv::v_int16x8 hi = cv::v_pack(cv::v_round(v[2]), cv::v_round(v[3]));
+        cv::v_store(d + j, cv::v_pack_u(lo, hi));
+      }
+#endif
+      for (; j < n; j++)
+        d[j] = cv::saturate_cast<uchar>(expr.At(i, j));
+    }
+  }
+
+private:
+  const E& expr;
+  cv::Mat& dst;
+};
+
+///
+/// \brief    求值表达式，结果饱和到CV_8U
+///
+template <typename E>
+static void EvaluateImageExpr(const ImageExpr<E>& expr, cv::Mat& dst)
+{
+  const cv::Mat& shape = expr.Self().Mat();
+  cv::Mat result(shape.size(), CV_MAKETYPE(CV_8U, shape.channels()));
+  cv::parallel_for_(cv::Range(0, result.rows), ExprRunner<E>(expr.Self(), result),
+                    result.total() / (double)(1 << 16));
+  dst = result;
+}
+
+///
+/// \brief    (Image1 + Image2) * Mult + Add
+///
+template <typename A, typename B>
+AffineExpr<BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, AddOp> >
+AddImage(const A& Image1, const B& Image2, const double Mult, const double Add)
+{
+  typedef BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, AddOp> Node;
+  return AffineExpr<Node>(Node(ImageExprOf<A>::Get(Image1), ImageExprOf<B>::Get(Image2)),
+                          Mult, Add);
+}
+
+///
+/// \brief    (Image1 - Image2) * Mult + Add
+///
+template <typename A, typename B>
+AffineExpr<BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, SubOp> >
+SubImage(const A& Image1, const B& Image2, const double Mult, const double Add)
+{
+  typedef BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, SubOp> Node;
+  return AffineExpr<Node>(Node(ImageExprOf<A>::Get(Image1), ImageExprOf<B>::Get(Image2)),
+                          Mult, Add);
+}
+
+///
+/// \brief    Image1 * Image2 * Mult + Add
+///
+template <typename A, typename B>
+AffineExpr<BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, MulOp> >
+MultImage(const A& Image1, const B& Image2, const double Mult, const double Add)
+{
+  typedef BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, MulOp> Node;
+  return AffineExpr<Node>(Node(ImageExprOf<A>::Get(Image1), ImageExprOf<B>::Get(Image2)),
+                          Mult, Add);
+}
+
+///
+/// \brief    |Image1 - Image2| * Mult
+///
+template <typename A, typename B>
+AffineExpr<BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type, AbsDiffOp> >
+AbsDiffImage(const A& Image1, const B& Image2, const double Mult = 1.0)
+{
+  typedef BinaryExpr<typename ImageExprOf<A>::type, typename ImageExprOf<B>::type,
+                     AbsDiffOp> Node;
+  return AffineExpr<Node>(Node(ImageExprOf<A>::Get(Image1), ImageExprOf<B>::Get(Image2)),
+                          Mult, 0.0);
+}
+
+///
+/// \brief    Image * Mult + Add
+///
+template <typename A>
+AffineExpr<typename ImageExprOf<A>::type>
+ScaleImage(const A& Image, const double Mult, const double Add)
+{
+  return AffineExpr<typename ImageExprOf<A>::type>(ImageExprOf<A>::Get(Image), Mult, Add);
+}
+
+} // my_cv
@@ -0,0 +1,427 @@
+﻿///*****************************************************************************
+///
+/// \file       ImageMapping.h
+/// \brief      定点坐标映射表与重映射
+///
+///             映射表保存每个目标像素对应的源图像整数坐标（16位）和插值小数部分
+///             的索引（16位），与cv::remap的CV_16SC2 + CV_16UC1格式一致，每像素6字节，
+///             可一次生成后在多帧之间复用。重映射按分块并行，块内源像素访问集中
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace my_cv {
+
+/// 插值小数部分的位数，与OpenCV的INTER_BITS一致
+static const int kMapFractionBits = cv::INTER_BITS;
+static const int kMapFractionSize = 1 << kMapFractionBits;
+/// 重映射分块尺寸，一块的源像素范围通常能留在L2缓存中
+static const int kRemapTileWidth = 256;
+static const int kRemapTileHeight = 32;
+
+///
+/// \brief 定点坐标映射表
+///
+struct FixedPointMap
+{
+  cv::Mat xy;       ///< CV_16SC2，源图像整数坐标（向下取整）
+  cv::Mat frac;     ///< CV_16UC1，(fy << kMapFractionBits) | fx
+  cv::Size src_size;  ///< 生成映射表时假定的源图像尺寸
+  bool bilinear = true; ///< MapImage使用的插值方式
+
+  bool Empty() const { return xy.empty(); }
+  cv::Size Size() const { return xy.size(); }
+  size_t Bytes() const { return xy.total() * xy.elemSize() + frac.total() * frac.elemSize(); }
+};
+
+///
+/// \brief    由Halcon的插值名称判断是否使用双线性插值
+///
+/// "nearest_neighbor"为最近邻，"bilinear"、"constant"、"weighted"均按双线性处理
+///
+static bool IsBilinearInterpolation(const std::string& Interpolation)
+{
+  if (Interpolation == "nearest_neighbor")
+    return false;
+  if (Interpolation == "bilinear" || Interpolation == "constant" || Interpolation == "weighted")
+    return true;
+  CV_Error(cv::Error::StsBadArg, "Unsupported interpolation: " + Interpolation);
+}
+
+///
+/// \brief    将浮点源坐标写入映射表的一个元素
+///
+static inline void StoreMapEntry(double x, double y, short* xy, ushort* frac)
+{
+  const int ix = cv::saturate_cast<int>(x * kMapFractionSize);
+  const int iy = cv::saturate_cast<int>(y * kMapFractionSize);
+  xy[0] = cv::saturate_cast<short>(ix >> kMapFractionBits);
+  xy[1] = cv::saturate_cast<short>(iy >> kMapFractionBits);
+  *frac = (ushort)(((iy & (kMapFractionSize - 1)) << kMapFractionBits) |
+                   (ix & (kMapFractionSize - 1)));
+}
+
+class RemapRunner : public cv::ParallelLoopBody
+{
+public:
+  RemapRunner(const cv::Mat& _src, cv::Mat& _dst, const FixedPointMap& _map, bool _bilinear)
+    : src(_src), dst(_dst), map(_map), bilinear(_bilinear)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int tiles_x = (dst.cols + kRemapTileWidth - 1) / kRemapTileWidth;
+    for (int t = range.start; t < range.end; t++)
+    {
+      const int j0 = (t % tiles_x) * kRemapTileWidth;
+      const int j1 = std::min(j0 + kRemapTileWidth, dst.cols);
+      const int i0 = (t / tiles_x) * kRemapTileHeight;
+      const int i1 = std::min(i0 + kRemapTileHeight, dst.rows);
+      for (int i = i0; i < i1; i++)
+      {
+        if (bilinear)
+          BilinearRow(i, j0, j1);
+        else
+          NearestRow(i, j0, j1);
+      }
+    }
+  }
+
+private:
+  inline uchar Pixel(int x, int y, int c) const
+  {
+    if ((unsigned)x >= (unsigned)src.cols || (unsigned)y >= (unsigned)src.rows)
+      return 0;
+    return src.ptr<uchar>(y)[x * src.channels() + c];
+  }
+
+  void NearestRow(int i, int j0, int j1) const
+  {
+    const short* xy = map.xy.ptr<short>(i);
+    const ushort* frac = map.frac.ptr<ushort>(i);
+    uchar* d = dst.ptr<uchar>(i);
+    const int cn = src.channels();
+    const int half = kMapFractionSize / 2;
+
+    for (int j = j0; j < j1; j++)
+    {
+      const int x = xy[2 * j] + ((frac[j] & (kMapFractionSize - 1)) >= half);
+      const int y = xy[2 * j + 1] + ((frac[j] >> kMapFractionBits) >= half);
+      for (int c = 0; c < cn; c++)
+        d[j * cn + c] = Pixel(x, y, c);
+    }
+  }
+
+  void BilinearRow(int i, int j0, int j1) const
+  {
+    const short* xy = map.xy.ptr<short>(i);
+    const ushort* frac = map.frac.ptr<ushort>(i);
+    uchar* d = dst.ptr<uchar>(i);
+    const int cn = src.channels();
+    const int last_x = src.cols - 2;
+    const int last_y = src.rows - 2;
+    const int bits = 2 * kMapFractionBits;
+    const int delta = 1 << (bits - 1);
+
+    int j = j0;
+#if CV_SIMD128
+    if (cn == 1)
+    {
+      // Gather the four neighbours of 8 pixels, then interpolate in vector lanes
+      alignas(16) ushort p00[8], p01[8], p10[8], p11[8], fx[8], fy[8];
+      const cv::v_uint16x8 full = cv::v_setall_u16((ushort)kMapFractionSize);
+      const cv::v_int32x4 round = cv::v_setall_s32(delta);
+
+      for (; j <= j1 - 8; j += 8)
+      {
+        for (int k = 0; k < 8; k++)
+        {
+          const int x = xy[2 * (j + k)];
+          const int y = xy[2 * (j + k) + 1];
+          if ((unsigned)x <= (unsigned)last_x && (unsigned)y <= (unsigned)last_y)
+          {
+            const uchar* s0 = src.ptr<uchar>(y) + x;
+            const uchar* s1 = s0 + src.step;
+            p00[k] = s0[0];
+            p01[k] = s0[1];
+            p10[k] = s1[0];
+            p11[k] = s1[1];
+          }
+          else
+          {
+            p00[k] = Pixel(x, y, 0);
+            p01[k] = Pixel(x + 1, y, 0);
+            p10[k] = Pixel(x, y + 1, 0);
+            p11[k] = Pixel(x + 1, y + 1, 0);
+          }
+          fx[k] = frac[j + k] & (kMapFractionSize - 1);
+          fy[k] = frac[j + k] >> kMapFractionBits;
+        }
+
+        const cv::v_uint16x8 vfx = cv::v_load_aligned(fx);
+        const cv::v_uint16x8 vfy = cv::v_load_aligned(fy);
+        const cv::v_uint16x8 gx = full - vfx;
+        const cv::v_uint16x8 top = cv::v_mul_wrap(cv::v_load_aligned(p00), gx) +
+                                   cv::v_mul_wrap(cv::v_load_aligned(p01), vfx);
+        const cv::v_uint16x8 bottom = cv::v_mul_wrap(cv::v_load_aligned(p10), gx) +
+                                      cv::v_mul_wrap(cv::v_load_aligned(p11), vfx);
+
+        cv::v_int16x8 rows0, rows1, w0, w1;
+        cv::v_zip(cv::v_reinterpret_as_s16(top), cv::v_reinterpret_as_s16(bottom), rows0, rows1);
+        cv::v_zip(cv::v_reinterpret_as_s16(full - vfy), cv::v_reinterpret_as_s16(vfy), w0, w1);
+        const cv::v_int32x4 lo = (cv::v_dotprod(rows0, w0) + round) >> bits;
+        const cv::v_int32x4 hi = (cv::v_dotprod(rows1, w1) + round) >> bits;
+        cv::v_pack_store(d + j, cv::v_reinterpret_as_u16(cv::v_pack(lo, hi)));
+      }
+    }
+#endif
+    for (; j < j1; j++)
+    {
+      const int x = xy[2 * j];
+      const int y = xy[2 * j + 1];
+      const int fx = frac[j] & (kMapFractionSize - 1);
+      const int fy = frac[j] >> kMapFractionBits;
+      for (int c = 0; c < cn; c++)
+      {
+        const int top = Pixel(x, y, c) * (kMapFractionSize - fx) + Pixel(x + 1, y, c) * fx;
+        const int bottom = Pixel(x, y + 1, c) * (kMapFractionSize - fx) + Pixel(x + 1, y + 1, c) * fx;
+        d[j * cn + c] = (uchar)((top * (kMapFractionSize - fy) + bottom * fy + delta) >> bits);
+      }
+    }
+  }
+
+  cv::Mat src;
+  cv::Mat& dst;
+  const FixedPointMap& map;
+  bool bilinear;
+};
+
+///
+/// \brief    按定点映射表重映射图像，映射到源图像以外的像素为0
+/// \param    [in]  src       源图像
+/// \param    [out] dst       目标图像，尺寸与映射表相同
+/// \param    [in]  map       定点映射表
+/// \param    [in]  bilinear  双线性插值或最近邻
+///
+static void RemapFixedPoint(const cv::Mat& src, cv::Mat& dst, const FixedPointMap& map,
+                            bool bilinear)
+{
+  CV_Assert(!map.Empty() && map.xy.type() == CV_16SC2 && map.frac.type() == CV_16UC1);
+  CV_Assert(dst.data != src.data);
+
+  if (src.depth() != CV_8U && bilinear)
+  {
+    cv::remap(src, dst, map.xy, map.frac, cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+              cv::Scalar::all(0));
+    return;
+  }
+  if (src.depth() != CV_8U)
+  {
+    // cv::remap only reads the integer part for INTER_NEAREST, round like NearestRow
+    cv::Mat rounded(map.xy.size(), CV_16SC2);
+    const int half = kMapFractionSize / 2;
+    for (int i = 0; i < rounded.rows; i++)
+    {
+      const short* xy = map.xy.ptr<short>(i);
+      const ushort* frac = map.frac.ptr<ushort>(i);
+      short* r = rounded.ptr<short>(i);
+      for (int j = 0; j < rounded.cols; j++)
+      {
+        r[2 * j] = cv::saturate_cast<short>(xy[2 * j] +
+                                            ((frac[j] & (kMapFractionSize - 1)) >= half));
+        r[2 * j + 1] = cv::saturate_cast<short>(xy[2 * j + 1] +
+                                                ((frac[j] >> kMapFractionBits) >= half));
+      }
+    }
+    cv::remap(src, dst, rounded, cv::Mat(), cv::INTER_NEAREST, cv::BORDER_CONSTANT,
+              cv::Scalar::all(0));
+    return;
+  }
+
+  dst.create(map.Size(), src.type());
+  const int tiles = ((dst.cols + kRemapTileWidth - 1) / kRemapTileWidth) *
+                    ((dst.rows + kRemapTileHeight - 1) / kRemapTileHeight);
+  cv::parallel_for_(cv::Range(0, tiles), RemapRunner(src, dst, map, bilinear),
+                    dst.total() / (double)(1 << 16));
+}
+
+///
+/// \brief    按映射表自身的插值方式重映射图像
+///
+static void MapImage(const cv::Mat& src, cv::Mat& dst, const FixedPointMap& map)
+{
+  CV_Assert(map.src_size.area() == 0 || map.src_size == src.size());
+  RemapFixedPoint(src, dst, map, map.bilinear);
+}
+
+class ConvertMapRunner : public cv::ParallelLoopBody
+{
+public:
+  ConvertMapRunner(const cv::Mat& _coords, FixedPointMap& _map)
+    : coords(_coords), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      const float* c = coords.ptr<float>(i);
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      for (int j = 0; j < coords.cols; j++)
+        StoreMapEntry(c[2 * j], c[2 * j + 1], xy + 2 * j, frac + j);
+    }
+  }
+
+private:
+  cv::Mat coords;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    浮点坐标映射转换为定点映射表
+/// \param    [in]  coords    CV_32FC2，每个目标像素对应的源坐标 (x, y)
+/// \param    [in]  MapType   "bilinear"或"nearest_neighbor"
+/// \param    [in]  src_size  源图像尺寸
+///
+static FixedPointMap ConvertMapType(const cv::Mat& coords, const std::string& MapType,
+                                    const cv::Size& src_size)
+{
+  CV_Assert(coords.type() == CV_32FC2);
+
+  FixedPointMap map;
+  map.src_size = src_size;
+  map.bilinear = IsBilinearInterpolation(MapType);
+  map.xy.create(coords.size(), CV_16SC2);
+  map.frac.create(coords.size(), CV_16UC1);
+  cv::parallel_for_(cv::Range(0, coords.rows), ConvertMapRunner(coords, map),
+                    coords.total() / (double)(1 << 16));
+  return map;
+}
+
+///
+/// \brief    定点映射表转换为浮点坐标映射（对应Halcon的"coord_map_sub_pix"）
+///
+static cv::Mat ConvertMapType(const FixedPointMap& map)
+{
+  cv::Mat coords(map.Size(), CV_32FC2);
+  const float scale = 1.f / kMapFractionSize;
+  for (int i = 0; i < coords.rows; i++)
+  {
+    const short* xy = map.xy.ptr<short>(i);
+    const ushort* frac = map.frac.ptr<ushort>(i);
+    float* c = coords.ptr<float>(i);
+    for (int j = 0; j < coords.cols; j++)
+    {
+      c[2 * j] = xy[2 * j] + (frac[j] & (kMapFractionSize - 1)) * scale;
+      c[2 * j + 1] = xy[2 * j + 1] + (frac[j] >> kMapFractionBits) * scale;
+    }
+  }
+  return coords;
+}
+
+///
+/// \brief 定点映射表的LRU缓存
+///
+/// 工位示教后几何参数不变时各帧共用同一张映射表。Key需支持operator==，
+/// 每种Key有一个进程内实例
+///
+template <typename Key>
+class FixedPointMapCache
+{
+public:
+  static FixedPointMapCache& Instance()
+  {
+    static FixedPointMapCache cache;
+    return cache;
+  }
+
+  ///
+  /// \brief    设置缓存的最大条目数和总字节数，超出时淘汰最久未使用的映射表
+  ///
+  void SetLimits(const size_t max_entries, const size_t max_bytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entries_ = max_entries;
+    max_bytes_ = max_bytes;
+    Evict();
+  }
+
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    bytes_ = 0;
+  }
+
+  ///
+  /// \brief    查找映射表，未命中时调用generate()生成并放入缓存
+  ///
+  template <typename Generator>
+  std::shared_ptr<const FixedPointMap> Get(const Key& key, Generator generate)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (typename std::list<Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it)
+      {
+        if (it->key == key)
+        {
+          entries_.splice(entries_.begin(), entries_, it);
+          return entries_.front().map;
+        }
+      }
+    }
+
+    // Build outside the lock, a concurrent miss on the same key only costs time
+    std::shared_ptr<const FixedPointMap> map = std::make_shared<FixedPointMap>(generate());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry entry = { key, map };
+    entries_.push_front(entry);
+    bytes_ += map->Bytes();
+    Evict();
+    return map;
+  }
+
+private:
+  struct Entry
+  {
+    Key key;
+    std::shared_ptr<const FixedPointMap> map;
+  };
+
+  FixedPointMapCache()
+    : max_entries_(8), max_bytes_((size_t)256 << 20), bytes_(0)
+  { }
+
+  void Evict()
+  {
+    while (entries_.size() > 1 && (entries_.size() > max_entries_ || bytes_ > max_bytes_))
+    {
+      bytes_ -= entries_.back().map->Bytes();
+      entries_.pop_back();
+    }
+  }
+
+  std::mutex mutex_;
+  std::list<Entry> entries_;
+  size_t max_entries_;
+  size_t max_bytes_;
+  size_t bytes_;
+};
+
+} // my_cv
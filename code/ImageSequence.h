@@ -0,0 +1,345 @@
+﻿///*****************************************************************************
+///
+/// \file       ImageSequence.h
+/// \brief      预读的图像序列读取
+///
+///             按目录或清单文件中的顺序读取图像，用于离线回放和性能测试。后台线程
+///             在窗口内提前读文件并解码，按原顺序交付；解码用的图像缓冲在池中复用，
+///             交付的图像及其副本全部释放后缓冲回到池中
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LosslessCodec.h"
+#include "RawImageFile.h"
+
+namespace my_cv {
+
+struct SequenceParams
+{
+  SequenceParams()
+    : workers(2), prefetch(8)
+  { }
+
+  int workers;   ///< 解码线程数
+  int prefetch;  ///< 最多提前解码的帧数
+};
+
+///
+/// \brief 序列中的一帧
+///
+struct SequenceFrame
+{
+  SequenceFrame()
+    : index(0), ok(false)
+  { }
+
+  size_t index;                         ///< 在序列中的序号
+  std::string file_name;
+  cv::Mat image;                        ///< 读取失败时为空
+  std::shared_ptr<const void> storage;  ///< 持有image的缓冲或文件映射
+  bool ok;
+};
+
+///
+/// \brief    列出目录中可读取的图像文件，按文件名排序
+///
+static std::vector<std::string> ListImageFiles(const std::string& directory)
+{
+  static const char* const kExtensions[] = { ".bmp", ".png", ".jpg", ".jpeg", ".tif", ".tiff",
+                                             ".simg", ".simz" };
+  std::vector<std::string> found;
+  cv::glob(directory, found, false);
+  std::vector<std::string> files;
+  for (size_t k = 0; k < found.size(); k++)
+  {
+    const std::string extension = ImageFileExtension(found[k]);
+    for (size_t e = 0; e < sizeof(kExtensions) / sizeof(kExtensions[0]); e++)
+      if (extension == kExtensions[e])
+      {
+        files.push_back(found[k]);
+        break;
+      }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+///
+/// \brief    读取清单文件，每行一个文件名，相对路径相对于清单所在目录，忽略空行和#开头的行
+///
+static std::vector<std::string> ReadImageManifest(const std::string& manifest)
+{
+  const size_t slash = manifest.find_last_of("/\\");
+  const std::string base = slash == std::string::npos ? std::string()
+                                                      : manifest.substr(0, slash + 1);
+  std::vector<std::string> files;
+  std::ifstream in(manifest.c_str());
+  std::string line;
+  while (std::getline(in, line))
+  {
+    line.erase(line.find_last_not_of(" \t\r") + 1);
+    if (line.empty() || line[0] == '#')
+      continue;
+    const bool absolute = line[0] == '/' || line[0] == '\\' ||
+                          (line.size() > 1 && line[1] == ':');
+    files.push_back(absolute ? line : base + line);
+  }
+  return files;
+}
+
+///
+/// \brief 解码缓冲池，取出的缓冲在最后一个引用释放后放回
+///
+class FrameBufferPool : public std::enable_shared_from_this<FrameBufferPool>
+{
+public:
+  explicit FrameBufferPool(const size_t limit)
+    : limit_(limit), taken_(0)
+  { }
+
+  std::shared_ptr<cv::Mat> Take()
+  {
+    return TryTake(std::numeric_limits<size_t>::max());
+  }
+
+  ///
+  /// \brief    已取出且未放回的缓冲数达到max_taken时返回空指针
+  ///
+  std::shared_ptr<cv::Mat> TryTake(const size_t max_taken)
+  {
+    cv::Mat buffer;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (taken_ >= max_taken)
+        return std::shared_ptr<cv::Mat>();
+      taken_++;
+      if (!free_.empty())
+      {
+        buffer = free_.back();
+        free_.pop_back();
+      }
+    }
+    std::shared_ptr<FrameBufferPool> self = shared_from_this();
+    return std::shared_ptr<cv::Mat>(new cv::Mat(buffer), [self](cv::Mat* p) {
+      self->Give(*p);
+      delete p;
+    });
+  }
+
+private:
+  void Give(const cv::Mat& buffer)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    taken_--;
+    if (free_.size() < limit_ && !buffer.empty())
+      free_.push_back(buffer);
+  }
+
+  std::mutex mutex_;
+  std::vector<cv::Mat> free_;
+  const size_t limit_;
+  size_t taken_;
+};
+
+///
+/// \brief 按顺序交付的预读图像序列
+///
+/// 交付的图像引用池中的缓冲，缓冲回到池中后会被后续帧覆盖，因此需要长期保留的
+/// 图像应连同storage一起保存（SImage会自动保存），或复制一份
+///
+class ImageSequenceReader
+{
+public:
+  ImageSequenceReader(const std::vector<std::string>& files,
+                      const SequenceParams& params = SequenceParams())
+    : files_(files), params_(params), next_decode_(0), next_deliver_(0), stop_(false),
+      slots_(params.prefetch), ready_(params.prefetch, 0),
+      pool_(std::make_shared<FrameBufferPool>(params.prefetch + params.workers))
+  {
+    CV_Assert(params_.workers > 0 && params_.prefetch > 0);
+    for (int k = 0; k < params_.workers; k++)
+      workers_.push_back(std::thread(&ImageSequenceReader::Work, this));
+  }
+
+  ~ImageSequenceReader()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    changed_.notify_all();
+    for (size_t k = 0; k < workers_.size(); k++)
+      workers_[k].join();
+  }
+
+  size_t Size() const { return files_.size(); }
+
+  ///
+  /// \brief    取下一帧，等待其解码完成
+  /// \return   序列结束时返回false；单帧读取失败时返回true，frame.ok为false
+  ///
+  bool Next(SequenceFrame& frame)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (next_deliver_ >= files_.size())
+      return false;
+    const size_t slot = next_deliver_ % params_.prefetch;
+    changed_.wait(lock, [this, slot] { return ready_[slot] != 0; });
+    frame = slots_[slot];
+    slots_[slot] = SequenceFrame();
+    ready_[slot] = 0;
+    next_deliver_++;
+    lock.unlock();
+    changed_.notify_all();
+    return true;
+  }
+
+  ///
+  /// \brief 单遍输入迭代器，for (const SequenceFrame& frame : reader)
+  ///
+  class Iterator
+  {
+  public:
+    explicit Iterator(ImageSequenceReader* reader)
+      : reader_(reader)
+    {
+      ++*this;
+    }
+
+    const SequenceFrame& operator * () const { return frame_; }
+    const SequenceFrame* operator -> () const { return &frame_; }
+
+    Iterator& operator ++ ()
+    {
+      if (reader_ && !reader_->Next(frame_))
+        reader_ = NULL;
+      return *this;
+    }
+
+    bool operator != (const Iterator& other) const { return reader_ != other.reader_; }
+
+  private:
+    ImageSequenceReader* reader_;
+    SequenceFrame frame_;
+  };
+
+  Iterator begin() { return Iterator(this); }
+  Iterator end() { return Iterator(NULL); }
+
+  ///
+  /// \brief    同步读取一帧，.simg映射文件，其他格式解码到buffer
+  ///
+  static bool ReadFrame(const std::string& file_name, cv::Mat& buffer, cv::Mat& image,
+                        std::shared_ptr<const void>& storage, std::vector<uchar>& bytes)
+  {
+    if (IsRawImageFile(file_name))
+      return ReadRawImage(file_name, image, storage, NULL, true);
+
+    FILE* file = std::fopen(file_name.c_str(), "rb");
+    if (file == NULL)
+      return false;
+    std::fseek(file, 0, SEEK_END);
+    const long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    bytes.resize(size > 0 ? (size_t)size : 0);
+    const bool ok = !bytes.empty() && std::fread(&bytes[0], 1, bytes.size(), file) == bytes.size();
+    std::fclose(file);
+    if (!ok)
+      return false;
+
+    if (IsLosslessImageFile(file_name))
+    {
+      if (!DecodeLosslessImage(&bytes[0], bytes.size(), image))
+        return false;
+      storage.reset();
+      return true;
+    }
+    try
+    {
+      // Decodes in place when the pooled buffer already has the right size and type
+      image = cv::imdecode(bytes, cv::IMREAD_UNCHANGED, &buffer);
+    }
+    catch (const cv::Exception&)
+    {
+      return false;
+    }
+    return !image.empty();
+  }
+
+private:
+  ImageSequenceReader(const ImageSequenceReader&);
+  ImageSequenceReader& operator=(const ImageSequenceReader&);
+
+  void Work()
+  {
+    std::vector<uchar> bytes;
+    for (;;)
+    {
+      size_t index;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        // Stay within the prefetch window so that the target slot has been delivered
+        changed_.wait(lock, [this] {
+          return stop_ || next_decode_ >= files_.size() ||
+                 next_decode_ < next_deliver_ + params_.prefetch;
+        });
+        if (stop_ || next_decode_ >= files_.size())
+          return;
+        index = next_decode_++;
+      }
+
+      SequenceFrame frame;
+      frame.index = index;
+      frame.file_name = files_[index];
+      std::shared_ptr<cv::Mat> buffer = pool_->Take();
+      frame.ok = ReadFrame(frame.file_name, *buffer, frame.image, frame.storage, bytes);
+      if (frame.ok && !frame.storage && frame.image.data == buffer->data)
+        frame.storage = buffer;
+      else if (!frame.ok)
+        frame.image.release();
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        const size_t slot = index % params_.prefetch;
+        slots_[slot] = frame;
+        ready_[slot] = 1;
+      }
+      changed_.notify_all();
+    }
+  }
+
+  const std::vector<std::string> files_;
+  const SequenceParams params_;
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  size_t next_decode_;
+  size_t next_deliver_;
+  bool stop_;
+  std::vector<SequenceFrame> slots_;  ///< Decoded frames indexed by index % prefetch
+  std::vector<uchar> ready_;
+  std::shared_ptr<FrameBufferPool> pool_;
+};
+
+} // my_cv
@@ -0,0 +1,441 @@
+﻿///*****************************************************************************
+///
+/// \file       LineScan.h
+/// \brief      线扫相机条带的增量处理与图像拼接
+///
+///             线扫相机连续输出条带。LineScanBuffer把条带依次放入大块缓冲，每条带
+///             连同之前的重叠行组成窗口，邻域算子在窗口上计算后只取结果确定且尚未
+///             输出过的行，使每行只延迟算子半径行而不是一整帧，卷材结束时由Finish
+///             输出最后的半径行。StripConnection逐条带做连通域分析，跨条带的连通域
+///             合并后在不再延伸时输出。TileImagesOffset在输入图像恰好是同一缓冲中
+///             相邻的部分时直接返回缓冲的视图，不复制
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SRegion.h"
+
+namespace my_cv {
+
+///
+/// \brief 条带缓冲
+///
+/// 条带在缓冲中按行连续存放，缓冲用完时分配新缓冲并复制重叠行，旧缓冲在仍被
+/// 引用期间保持有效，因此返回的窗口和条带视图不会被之后的条带覆盖
+///
+class LineScanBuffer
+{
+public:
+  ///
+  /// \param    [in]  strip_rows         每个条带的行数
+  /// \param    [in]  overlap_rows       窗口中条带之前保留的行数，应不小于算子半径的两倍
+  /// \param    [in]  strips_per_buffer  每块缓冲容纳的条带数
+  ///
+  LineScanBuffer(const int cols, const int type, const int strip_rows, const int overlap_rows,
+                 const int strips_per_buffer = 8)
+    : cols_(cols), type_(type), strip_rows_(strip_rows), overlap_rows_(overlap_rows),
+      strips_per_buffer_(strips_per_buffer), position_(0), window_begin_(0), strip_row_(-1),
+      pending_(false), finished_(false)
+  {
+    CV_Assert(cols > 0 && strip_rows > 0 && overlap_rows >= 0 && strips_per_buffer > 0);
+  }
+
+  ///
+  /// \brief    下一个条带在缓冲中的位置，相机可直接采集到其中，写完后调用Commit
+  ///
+  cv::Mat NextStrip()
+  {
+    if (!pending_)
+    {
+      if (buffer_.empty() || position_ + strip_rows_ > buffer_.rows)
+      {
+        // Start a new block, the previous one lives on while views of it exist
+        cv::Mat block(overlap_rows_ + strips_per_buffer_ * strip_rows_, cols_, type_);
+        const int keep = std::min(overlap_rows_, position_);
+        if (keep > 0)
+          buffer_.rowRange(position_ - keep, position_).copyTo(block.rowRange(0, keep));
+        buffer_ = block;
+        position_ = keep;
+      }
+      pending_ = true;
+    }
+    return buffer_.rowRange(position_, position_ + strip_rows_);
+  }
+
+  ///
+  /// \brief    提交NextStrip中写好的条带
+  /// \return   窗口，即条带及其之前最多overlap_rows行
+  ///
+  cv::Mat Commit()
+  {
+    CV_Assert(pending_);
+    pending_ = false;
+    // The first strip after Finish starts a new web
+    strip_row_ = strip_row_ < 0 || finished_ ? 0 : strip_row_ + strip_rows_;
+    finished_ = false;
+    // Rows before the first strip of the web do not exist
+    const int overlap = (int)std::min<int64_t>(std::min(overlap_rows_, position_), strip_row_);
+    window_begin_ = position_ - overlap;
+    position_ += strip_rows_;
+    return Window();
+  }
+
+  ///
+  /// \brief    复制strip到缓冲并提交
+  ///
+  cv::Mat Push(const cv::Mat& strip)
+  {
+    CV_Assert(strip.rows == strip_rows_ && strip.cols == cols_ && strip.type() == type_);
+    strip.copyTo(NextStrip());
+    return Commit();
+  }
+
+  ///
+  /// \brief    卷材结束，之后OutputRows返回最后一个窗口中还在等待下方行的行
+  ///
+  /// 这些行按算子的图像边界方式计算，可直接取最后一个窗口上已有的结果。之后提交的
+  /// 条带属于新的卷材
+  ///
+  void Finish()
+  {
+    CV_Assert(!pending_ && strip_row_ >= 0);
+    finished_ = true;
+  }
+
+  ///
+  /// \brief    最近提交的窗口
+  ///
+  cv::Mat Window() const
+  {
+    return buffer_.rowRange(window_begin_, position_);
+  }
+
+  ///
+  /// \brief    最近提交的条带
+  ///
+  cv::Mat Strip() const
+  {
+    return buffer_.rowRange(position_ - strip_rows_, position_);
+  }
+
+  ///
+  /// \brief    最近提交的条带的首行在整个卷材中的行号
+  ///
+  int64_t StripRow() const { return strip_row_; }
+
+  ///
+  /// \brief    当前缓冲块的所有者，随窗口或条带视图一起保存（如SImage::AccessStripWindow）
+  ///
+  std::shared_ptr<const void> Owner() const { return std::make_shared<cv::Mat>(buffer_); }
+
+  ///
+  /// \brief    窗口首行在整个卷材中的行号
+  ///
+  int64_t WindowRow() const { return strip_row_ - (Window().rows - strip_rows_); }
+
+  ///
+  /// \brief    半高为radius的邻域算子在窗口上的结果中，本次应输出的行（窗口坐标）
+  ///
+  /// 每行在其下方radius行到达后输出一次，因此输出比输入延迟radius行；Finish之后
+  /// 为最后radius行
+  ///
+  cv::Range OutputRows(const int radius) const
+  {
+    CV_Assert(radius >= 0 && 2 * radius <= overlap_rows_);
+    const int64_t window_row = WindowRow();
+    const int rows = Window().rows;
+    const int begin = (int)(std::max<int64_t>(strip_row_ - radius, 0) - window_row);
+    const int end = std::max(begin, rows - radius);
+    return finished_ ? cv::Range(end, rows) : cv::Range(begin, end);
+  }
+
+private:
+  const int cols_;
+  const int type_;
+  const int strip_rows_;
+  const int overlap_rows_;
+  const int strips_per_buffer_;
+  cv::Mat buffer_;
+  int position_;        ///< End of the last committed strip in buffer_
+  int window_begin_;    ///< Start of the last window in buffer_
+  int64_t strip_row_;   ///< Web row of the last committed strip, -1 before the first
+  bool pending_;
+  bool finished_;       ///< Finish was called after the last committed strip
+};
+
+///
+/// \brief    取窗口坐标下区域中本次应输出的行，并转换为卷材行号
+///
+/// 行号为int，连续运行时应在卷材行号超出int范围前（如换卷时）重新开始
+///
+static SRegion StripRegion(const SRegion& window_region, const LineScanBuffer& buffer,
+                           const int radius)
+{
+  const cv::Range rows = buffer.OutputRows(radius);
+  const int offset = (int)buffer.WindowRow();
+  const std::vector<RegionRun>& runs = window_region.Runs();
+  std::vector<RegionRun> out;
+  out.reserve(runs.size());
+  for (size_t k = 0; k < runs.size(); k++)
+    if (runs[k].Row >= rows.start && runs[k].Row < rows.end)
+    {
+      RegionRun run = runs[k];
+      run.Row += offset;
+      out.push_back(run);
+    }
+  return SRegion(out);
+}
+
+///
+/// \brief 跨条带的8邻域连通域分析
+///
+/// 按行号递增的顺序送入各条带的区域，一个连通域在某行没有延伸到下一行时即完整
+/// 输出，不必等到整幅图像结束
+///
+class StripConnection
+{
+public:
+  StripConnection()
+    : next_row_(INT_MIN)
+  { }
+
+  ///
+  /// \brief    送入行范围[row_begin, row_end)的区域
+  /// \return   在这些行中结束的连通域
+  ///
+  std::vector<SRegion> Push(const SRegion& region, const int row_begin, const int row_end)
+  {
+    CV_Assert(row_begin <= row_end && (next_row_ == INT_MIN || row_begin == next_row_));
+    std::vector<SRegion> done;
+    const std::vector<RegionRun>& runs = region.Runs();
+    size_t k = 0;
+    for (int row = row_begin; row < row_end; row++)
+    {
+      size_t end = k;
+      while (end < runs.size() && runs[end].Row == row)
+        end++;
+      CV_Assert(end == runs.size() || runs[end].Row > row);
+      AddRow(runs.empty() ? NULL : &runs[0] + k, end - k, done);
+      k = end;
+    }
+    CV_Assert(k == runs.size());
+    next_row_ = row_end;
+    return done;
+  }
+
+  ///
+  /// \brief    输出所有未结束的连通域，之后可从任意行重新开始
+  ///
+  std::vector<SRegion> Flush()
+  {
+    std::vector<SRegion> done;
+    AddRow(NULL, 0, done);
+    blobs_.clear();
+    parent_.clear();
+    free_.clear();
+    next_row_ = INT_MIN;
+    return done;
+  }
+
+private:
+  struct ActiveRun
+  {
+    RegionRun run;
+    int blob;
+  };
+
+  int Find(int b)
+  {
+    while (parent_[b] != b)
+    {
+      parent_[b] = parent_[parent_[b]];
+      b = parent_[b];
+    }
+    return b;
+  }
+
+  int NewBlob()
+  {
+    if (!free_.empty())
+    {
+      const int b = free_.back();
+      free_.pop_back();
+      parent_[b] = b;
+      return b;
+    }
+    parent_.push_back((int)blobs_.size());
+    blobs_.push_back(std::vector<RegionRun>());
+    return (int)blobs_.size() - 1;
+  }
+
+  void Merge(int a, int b, std::vector<int>& absorbed)
+  {
+    a = Find(a);
+    b = Find(b);
+    if (a == b)
+      return;
+    if (blobs_[a].size() < blobs_[b].size())
+      std::swap(a, b);
+    blobs_[a].insert(blobs_[a].end(), blobs_[b].begin(), blobs_[b].end());
+    std::vector<RegionRun>().swap(blobs_[b]);
+    parent_[b] = a;
+    absorbed.push_back(b);
+  }
+
+  void AddRow(const RegionRun* runs, const size_t n, std::vector<SRegion>& done)
+  {
+    std::vector<ActiveRun> current(n);
+    std::vector<int> absorbed;
+    size_t p = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+      const RegionRun& run = runs[k];
+      // Skip previous-row runs that end left of this run's 8-neighbourhood
+      while (p < active_.size() && active_[p].run.ColumnEnd < run.ColumnBegin)
+        p++;
+      int blob = -1;
+      for (size_t q = p; q < active_.size() && active_[q].run.ColumnBegin <= run.ColumnEnd; q++)
+        if (blob < 0)
+          blob = Find(active_[q].blob);
+        else
+          Merge(blob, active_[q].blob, absorbed);
+      blob = blob < 0 ? NewBlob() : Find(blob);
+      blobs_[blob].push_back(run);
+      current[k].run = run;
+      current[k].blob = blob;
+    }
+
+    // A blob of the previous row not continued in this row is complete
+    std::vector<uchar> continued(blobs_.size(), 0);
+    for (size_t k = 0; k < current.size(); k++)
+    {
+      current[k].blob = Find(current[k].blob);
+      continued[current[k].blob] = 1;
+    }
+    for (size_t q = 0; q < active_.size(); q++)
+    {
+      const int b = Find(active_[q].blob);
+      if (continued[b])
+        continue;
+      continued[b] = 1;
+      std::vector<RegionRun>& blob = blobs_[b];
+      std::sort(blob.begin(), blob.end(), [](const RegionRun& x, const RegionRun& y) {
+        return x.Row != y.Row ? x.Row < y.Row : x.ColumnBegin < y.ColumnBegin;
+      });
+      done.push_back(SRegion(blob));
+      std::vector<RegionRun>().swap(blob);
+      absorbed.push_back(b);
+    }
+    // Ids are recycled only after no active run refers to them
+    active_.swap(current);
+    free_.insert(free_.end(), absorbed.begin(), absorbed.end());
+  }
+
+  std::vector<std::vector<RegionRun> > blobs_;  ///< Runs of each root blob
+  std::vector<int> parent_;
+  std::vector<int> free_;
+  std::vector<ActiveRun> active_;               ///< Runs of the previous row
+  int next_row_;
+};
+
+///
+/// \brief    把图像按偏移拼接为width x height的图像，未覆盖的部分为0
+///
+/// 输入是同一缓冲中的部分、偏移与它们在缓冲中的相对位置一致且恰好铺满结果时，
+/// 直接返回缓冲中对应部分的视图，不复制像素
+///
+static cv::Mat TileImagesOffset(const std::vector<cv::Mat>& images,
+                                const std::vector<int>& offset_rows,
+                                const std::vector<int>& offset_cols, const int width,
+                                const int height)
+{
+  CV_Assert(!images.empty() && images.size() == offset_rows.size() &&
+            images.size() == offset_cols.size() && width > 0 && height > 0);
+  const int type = images[0].type();
+  for (size_t k = 1; k < images.size(); k++)
+    CV_Assert(images[k].type() == type);
+
+  // Zero-copy when the inputs tile the target exactly inside one allocation
+  cv::Size whole;
+  cv::Point origin;
+  images[0].locateROI(whole, origin);
+  const cv::Point base = origin - cv::Point(offset_cols[0], offset_rows[0]);
+  const cv::Rect target(base, cv::Size(width, height));
+  bool view = target.x >= 0 && target.y >= 0 && target.br().x <= whole.width &&
+              target.br().y <= whole.height;
+  int64_t area = 0;
+  for (size_t k = 0; k < images.size() && view; k++)
+  {
+    cv::Size size;
+    cv::Point ofs;
+    images[k].locateROI(size, ofs);
+    const cv::Rect rect(cv::Point(offset_cols[k], offset_rows[k]), images[k].size());
+    view = images[k].datastart == images[0].datastart && images[k].step == images[0].step &&
+           ofs == base + rect.tl() && (rect & cv::Rect(0, 0, width, height)) == rect;
+    for (size_t q = 0; q < k && view; q++)
+      view = (rect & cv::Rect(cv::Point(offset_cols[q], offset_rows[q]), images[q].size()))
+               .area() == 0;
+    area += rect.area();
+  }
+  if (view && area == (int64_t)width * height)
+  {
+    cv::Mat tiled = images[0];
+    tiled.adjustROI(-base.y + origin.y, base.y + height - origin.y - images[0].rows,
+                    -base.x + origin.x, base.x + width - origin.x - images[0].cols);
+    return tiled;
+  }
+
+  cv::Mat tiled = cv::Mat::zeros(height, width, type);
+  for (size_t k = 0; k < images.size(); k++)
+  {
+    const cv::Rect rect(cv::Point(offset_cols[k], offset_rows[k]), images[k].size());
+    const cv::Rect clipped = rect & cv::Rect(0, 0, width, height);
+    if (clipped.area() > 0)
+      images[k](clipped - rect.tl()).copyTo(tiled(clipped));
+  }
+  return tiled;
+}
+
+///
+/// \brief    把图像按num_columns列拼接，各图像尺寸须相同
+/// \param    [in]  tile_order  "horizontal"为逐行排列，"vertical"为逐列排列
+///
+static cv::Mat TileImages(const std::vector<cv::Mat>& images, const int num_columns,
+                          const std::string& tile_order)
+{
+  CV_Assert(!images.empty() && num_columns > 0);
+  if (tile_order != "horizontal" && tile_order != "vertical")
+    CV_Error(cv::Error::StsBadArg, "TileOrder must be horizontal or vertical");
+  const cv::Size size = images[0].size();
+  const int n = (int)images.size();
+  const int num_rows = (n + num_columns - 1) / num_columns;
+  std::vector<int> offset_rows(n), offset_cols(n);
+  for (int k = 0; k < n; k++)
+  {
+    CV_Assert(images[k].size() == size);
+    const bool horizontal = tile_order == "horizontal";
+    const int r = horizontal ? k / num_columns : k % num_rows;
+    const int c = horizontal ? k % num_columns : k / num_rows;
+    offset_rows[k] = r * size.height;
+    offset_cols[k] = c * size.width;
+  }
+  return TileImagesOffset(images, offset_rows, offset_cols, num_columns * size.width,
+                          num_rows * size.height);
+}
+
+} // my_cv
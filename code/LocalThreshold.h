@@ -0,0 +1,547 @@
+﻿///*****************************************************************************
+///
+/// \file       LocalThreshold.h
+/// \brief      基于积分图的局部阈值
+///
+///             局部均值和方差由积分图一次求出：先并行计算各行前缀和，再按列块用SIMD
+///             向下累加。窗口和按无符号数取模相减，只要单个窗口的和不溢出，结果与
+///             图像尺寸无关，因此32位积分图可用于任意大小的图像，窗口过大时改用64位。
+///             比较与输出在同一遍按行条带完成，可直接输出游程而不生成二值图像；窗口
+///             不被左右边界截断的列面积相同，用SIMD每次求4个像素的均值和标准差
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "SRegion.h"
+
+namespace my_cv {
+
+/// 局部阈值每个条带的行数
+static const int kLocalThresholdStripeRows = 32;
+
+///
+/// \brief 局部阈值保留的像素类别
+///
+enum LightDarkMode
+{
+  kLight,     ///< 比局部阈值亮
+  kDark,      ///< 比局部阈值暗
+  kEqual,     ///< 与局部阈值相差不超过偏移量
+  kNotEqual,  ///< 与局部阈值相差超过偏移量
+};
+
+static LightDarkMode ParseLightDark(const std::string& LightDark)
+{
+  if (LightDark == "light")
+    return kLight;
+  if (LightDark == "dark")
+    return kDark;
+  if (LightDark == "equal")
+    return kEqual;
+  if (LightDark == "not_equal")
+    return kNotEqual;
+  CV_Error(cv::Error::StsBadArg, "Unsupported LightDark: " + LightDark);
+}
+
+static inline void AddRow(uint32_t* dst, const uint32_t* src, const int n)
+{
+  int j = 0;
+#if CV_SIMD128
+  for (; j <= n - 4; j += 4)
+    cv::v_store(dst + j, cv::v_load(dst + j) + cv::v_load(src + j));
+#endif
+  for (; j < n; j++)
+    dst[j] += src[j];
+}
+
+static inline void AddRow(uint64_t* dst, const uint64_t* src, const int n)
+{
+  int j = 0;
+#if CV_SIMD128
+  for (; j <= n - 2; j += 2)
+    cv::v_store(dst + j, cv::v_load(dst + j) + cv::v_load(src + j));
+#endif
+  for (; j < n; j++)
+    dst[j] += src[j];
+}
+
+///
+/// \brief 灰度与灰度平方的积分图，尺寸为(rows + 1) * (cols + 1)，首行首列为0
+///
+template <typename Sum>
+struct IntegralImages
+{
+  std::vector<Sum> sum;
+  std::vector<Sum> sqsum;
+  int rows = 0;
+  int cols = 0;
+
+  size_t Stride() const { return (size_t)cols + 1; }
+  size_t Bytes() const { return (sum.size() + sqsum.size()) * sizeof(Sum); }
+  const Sum* SumRow(int i) const { return &sum[i * Stride()]; }
+  const Sum* SqsumRow(int i) const { return &sqsum[i * Stride()]; }
+};
+
+template <typename Sum>
+class RowPrefixRunner : public cv::ParallelLoopBody
+{
+public:
+  RowPrefixRunner(const cv::Mat& _image, IntegralImages<Sum>& _integral)
+    : image(_image), integral(_integral)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      const uchar* p = image.ptr<uchar>(i);
+      Sum* s = &integral.sum[(i + 1) * integral.Stride()];
+      Sum* q = &integral.sqsum[(i + 1) * integral.Stride()];
+      Sum a = 0, b = 0;
+      s[0] = q[0] = 0;
+      for (int j = 0; j < image.cols; j++)
+      {
+        a += p[j];
+        b += (Sum)p[j] * p[j];
+        s[j + 1] = a;
+        q[j + 1] = b;
+      }
+    }
+  }
+
+private:
+  cv::Mat image;
+  IntegralImages<Sum>& integral;
+};
+
+template <typename Sum>
+class ColumnPrefixRunner : public cv::ParallelLoopBody
+{
+public:
+  ColumnPrefixRunner(IntegralImages<Sum>& _integral, int _block)
+    : integral(_integral), block(_block)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const size_t stride = integral.Stride();
+    for (int b = range.start; b < range.end; b++)
+    {
+      const int j0 = b * block;
+      const int n = std::min(block, integral.cols + 1 - j0);
+      for (int i = 2; i <= integral.rows; i++)
+      {
+        AddRow(&integral.sum[i * stride + j0], &integral.sum[(i - 1) * stride + j0], n);
+        AddRow(&integral.sqsum[i * stride + j0], &integral.sqsum[(i - 1) * stride + j0], n);
+      }
+    }
+  }
+
+private:
+  IntegralImages<Sum>& integral;
+  int block;
+};
+
+///
+/// \brief    计算灰度与灰度平方的积分图
+/// \param    [in]  image  CV_8UC1图像
+///
+template <typename Sum>
+static void CalcIntegralImages(const cv::Mat& image, IntegralImages<Sum>& integral)
+{
+  CV_Assert(image.type() == CV_8UC1);
+
+  integral.rows = image.rows;
+  integral.cols = image.cols;
+  integral.sum.assign((image.rows + 1) * integral.Stride(), 0);
+  integral.sqsum.assign((image.rows + 1) * integral.Stride(), 0);
+  cv::parallel_for_(cv::Range(0, image.rows), RowPrefixRunner<Sum>(image, integral),
+                    image.total() / (double)(1 << 16));
+
+  // Column blocks keep the vertical accumulation vectorised and independent
+  const int block = 64;
+  const int nblocks = (image.cols + 1 + block - 1) / block;
+  cv::parallel_for_(cv::Range(0, nblocks), ColumnPrefixRunner<Sum>(integral, block));
+}
+
+///
+/// \brief    逐像素比较灰度与局部阈值，按行条带输出掩膜或游程
+///
+/// RowFn(i, mask)负责生成第i行的0/255掩膜，每段条带使用RowFn的一个副本，其中可保存
+/// 逐行复用的缓冲
+///
+template <typename RowFn>
+class LocalThresholdRunner : public cv::ParallelLoopBody
+{
+public:
+  LocalThresholdRunner(const cv::Size& _size, const RowFn& _row_fn, cv::Mat* _mask,
+                       std::vector<std::vector<RegionRun> >* _stripes)
+    : size(_size), row_fn(_row_fn), mask(_mask), stripes(_stripes)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    std::vector<uchar> buffer(size.width);
+    RowFn fn(row_fn);
+    for (int s = range.start; s < range.end; s++)
+    {
+      const int row1 = std::min((s + 1) * kLocalThresholdStripeRows, size.height);
+      for (int i = s * kLocalThresholdStripeRows; i < row1; i++)
+      {
+        uchar* row = mask ? mask->ptr<uchar>(i) : &buffer[0];
+        fn(i, row);
+        if (stripes)
+          AppendRowRuns(row, size.width, i, (*stripes)[s]);
+      }
+    }
+  }
+
+private:
+  cv::Size size;
+  RowFn row_fn;
+  cv::Mat* mask;
+  std::vector<std::vector<RegionRun> >* stripes;
+};
+
+///
+/// \brief    执行局部阈值
+/// \param    [out] mask    非NULL时输出CV_8UC1掩膜
+/// \param    [out] region  非NULL时输出游程区域
+///
+template <typename RowFn>
+static void RunLocalThreshold(const cv::Size& size, const RowFn& row_fn, cv::Mat* mask,
+                              SRegion* region)
+{
+  const int nstripes = (size.height + kLocalThresholdStripeRows - 1) / kLocalThresholdStripeRows;
+  std::vector<std::vector<RegionRun> > stripes(region ? nstripes : 0);
+  if (mask)
+    mask->create(size, CV_8UC1);
+  cv::parallel_for_(cv::Range(0, nstripes),
+                    LocalThresholdRunner<RowFn>(size, row_fn, mask, region ? &stripes : NULL));
+  if (region)
+    *region = SRegion(ConcatRuns(stripes));
+}
+
+#if CV_SIMD128_64F
+///
+/// \brief    窗口完整的列上，4个像素一组求均值与标准差，与逐像素计算的结果相同
+/// \return   未处理的第一列
+///
+static inline int WindowMomentsInterior(const uint32_t* s0, const uint32_t* s1,
+                                        const uint32_t* q0, const uint32_t* q1, int j,
+                                        const int end, const int half_w, const double area,
+                                        float* mean, float* deviation)
+{
+  const cv::v_float64x2 varea = cv::v_setall_f64(area);
+  const cv::v_float64x2 zero = cv::v_setzero_f64();
+  const cv::v_float64x2 shift = cv::v_setall_f64(65536.0);
+  const cv::v_uint32x4 low = cv::v_setall_u32(0xffff);
+  for (; j <= end - 4; j += 4)
+  {
+    const int x0 = j - half_w;
+    const int x1 = j + half_w + 1;
+    // 32-bit lanes wrap like the scalar difference, the window sum itself fits in int32
+    const cv::v_int32x4 s = cv::v_reinterpret_as_s32(cv::v_load(s1 + x1) - cv::v_load(s0 + x1) -
+                                                     cv::v_load(s1 + x0) + cv::v_load(s0 + x0));
+    const cv::v_float64x2 m0 = cv::v_cvt_f64(s) / varea;
+    const cv::v_float64x2 m1 = cv::v_cvt_f64_high(s) / varea;
+    cv::v_store(mean + j, cv::v_cvt_f32(m0, m1));
+    if (deviation)
+    {
+      // The square sum may exceed INT_MAX, convert its two 16-bit halves exactly
+      const cv::v_uint32x4 q = cv::v_load(q1 + x1) - cv::v_load(q0 + x1) -
+                               cv::v_load(q1 + x0) + cv::v_load(q0 + x0);
+      const cv::v_int32x4 qh = cv::v_reinterpret_as_s32(q >> 16);
+      const cv::v_int32x4 ql = cv::v_reinterpret_as_s32(q & low);
+      const cv::v_float64x2 v0 = (cv::v_cvt_f64(qh) * shift + cv::v_cvt_f64(ql)) / varea - m0 * m0;
+      const cv::v_float64x2 v1 =
+        (cv::v_cvt_f64_high(qh) * shift + cv::v_cvt_f64_high(ql)) / varea - m1 * m1;
+      cv::v_store(deviation + j, cv::v_cvt_f32(cv::v_sqrt(cv::v_max(v0, zero)),
+                                               cv::v_sqrt(cv::v_max(v1, zero))));
+    }
+  }
+  return j;
+}
+#else
+static inline int WindowMomentsInterior(const uint32_t*, const uint32_t*, const uint32_t*,
+                                        const uint32_t*, const int j, const int, const int,
+                                        const double, float*, float*)
+{
+  return j;
+}
+#endif
+
+// 64-bit sums are only used for very large windows and stay scalar
+static inline int WindowMomentsInterior(const uint64_t*, const uint64_t*, const uint64_t*,
+                                        const uint64_t*, const int j, const int, const int,
+                                        const double, float*, float*)
+{
+  return j;
+}
+
+///
+/// \brief 由积分图求窗口内的像素数、灰度和与平方和
+///
+template <typename Sum>
+class WindowSums
+{
+public:
+  WindowSums(const IntegralImages<Sum>& _integral, int _mask_width, int _mask_height)
+    : integral(_integral), half_w(_mask_width / 2), half_h(_mask_height / 2)
+  { }
+
+  ///
+  /// \brief    第i行各像素的窗口均值与标准差，窗口在图像边界处截断
+  ///
+  void Row(const int i, float* mean, float* deviation) const
+  {
+    const int y0 = std::max(i - half_h, 0);
+    const int y1 = std::min(i + half_h + 1, integral.rows);
+    const Sum* s0 = integral.SumRow(y0);
+    const Sum* s1 = integral.SumRow(y1);
+    const Sum* q0 = integral.SqsumRow(y0);
+    const Sum* q1 = integral.SqsumRow(y1);
+
+    // Columns whose window is not cut by the left or right border share one area
+    const int begin = std::min(half_w, integral.cols);
+    const int end = std::max(begin, integral.cols - half_w);
+    Columns(s0, s1, q0, q1, y1 - y0, 0, begin, mean, deviation);
+    const int j = WindowMomentsInterior(s0, s1, q0, q1, begin, end, half_w,
+                                        (double)(y1 - y0) * (2 * half_w + 1), mean, deviation);
+    Columns(s0, s1, q0, q1, y1 - y0, j, integral.cols, mean, deviation);
+  }
+
+private:
+  void Columns(const Sum* s0, const Sum* s1, const Sum* q0, const Sum* q1, const int height,
+               const int j0, const int j1, float* mean, float* deviation) const
+  {
+    for (int j = j0; j < j1; j++)
+    {
+      const int x0 = std::max(j - half_w, 0);
+      const int x1 = std::min(j + half_w + 1, integral.cols);
+      const double area = (double)height * (x1 - x0);
+      // Unsigned wrap-around makes the difference exact whenever the window sum fits
+      const Sum s = (Sum)(s1[x1] - s0[x1] - s1[x0] + s0[x0]);
+      const double m = s / area;
+      mean[j] = (float)m;
+      if (deviation)
+      {
+        const Sum q = (Sum)(q1[x1] - q0[x1] - q1[x0] + q0[x0]);
+        deviation[j] = (float)std::sqrt(std::max(q / area - m * m, 0.0));
+      }
+    }
+  }
+
+  const IntegralImages<Sum>& integral;
+  int half_w;
+  int half_h;
+};
+
+///
+/// \brief    窗口平方和在32位无符号数内不溢出时返回true
+///
+static bool FitsUInt32Window(const int MaskWidth, const int MaskHeight)
+{
+  return (double)MaskWidth * MaskHeight * 255 * 255 < 4294967296.0;
+}
+
+///
+/// \brief    按比较规则生成一行掩膜
+///
+/// Rule(g, mean, deviation)返回像素是否保留
+///
+template <typename Sum, typename Rule>
+class WindowRuleRow
+{
+public:
+  WindowRuleRow(const cv::Mat& _image, const IntegralImages<Sum>& _integral, int _mask_width,
+                int _mask_height, const Rule& _rule, bool _needs_deviation)
+    : image(_image), sums(_integral, _mask_width, _mask_height), rule(_rule),
+      needs_deviation(_needs_deviation)
+  { }
+
+  void operator () (const int i, uchar* mask)
+  {
+    // Sized on the first row of each stripe range, reused for the rest
+    mean.resize(image.cols);
+    deviation.resize(needs_deviation ? image.cols : 0);
+    sums.Row(i, &mean[0], needs_deviation ? &deviation[0] : NULL);
+    const uchar* p = image.ptr<uchar>(i);
+    for (int j = 0; j < image.cols; j++)
+      mask[j] = rule(p[j], mean[j], needs_deviation ? deviation[j] : 0.f) ? 255 : 0;
+  }
+
+private:
+  cv::Mat image;
+  WindowSums<Sum> sums;
+  Rule rule;
+  bool needs_deviation;
+  std::vector<float> mean;
+  std::vector<float> deviation;
+};
+
+///
+/// \brief    用已有的积分图执行局部阈值
+///
+template <typename Sum, typename Rule>
+static void WindowThresholdWith(const cv::Mat& image, const IntegralImages<Sum>& integral,
+                                const int MaskWidth, const int MaskHeight, const Rule& rule,
+                                const bool needs_deviation, cv::Mat* mask, SRegion* region)
+{
+  CV_Assert(integral.rows == image.rows && integral.cols == image.cols);
+  RunLocalThreshold(image.size(),
+                    WindowRuleRow<Sum, Rule>(image, integral, MaskWidth, MaskHeight, rule,
+                                             needs_deviation),
+                    mask, region);
+}
+
+///
+/// \brief    按窗口大小选择32位或64位积分图后执行局部阈值
+///
+template <typename Rule>
+static void WindowThreshold(const cv::Mat& image, const int MaskWidth, const int MaskHeight,
+                            const Rule& rule, const bool needs_deviation, cv::Mat* mask,
+                            SRegion* region)
+{
+  CV_Assert(image.type() == CV_8UC1);
+  if (MaskWidth < 1 || MaskHeight < 1)
+    CV_Error(cv::Error::StsBadArg, "Mask size must be positive");
+
+  if (FitsUInt32Window(MaskWidth, MaskHeight))
+  {
+    IntegralImages<uint32_t> integral;
+    CalcIntegralImages(image, integral);
+    WindowThresholdWith(image, integral, MaskWidth, MaskHeight, rule, needs_deviation, mask,
+                        region);
+  }
+  else
+  {
+    IntegralImages<uint64_t> integral;
+    CalcIntegralImages(image, integral);
+    WindowThresholdWith(image, integral, MaskWidth, MaskHeight, rule, needs_deviation, mask,
+                        region);
+  }
+}
+
+///
+/// \brief 灰度与阈值（加偏移）比较，DynThreshold使用
+///
+struct OffsetRule
+{
+  LightDarkMode mode;
+  float offset;
+
+  bool operator () (const float g, const float t, const float) const
+  {
+    switch (mode)
+    {
+    case kLight: return g >= t + offset;
+    case kDark: return g <= t - offset;
+    case kEqual: return g >= t - offset && g <= t + offset;
+    default: return g < t - offset || g > t + offset;
+    }
+  }
+};
+
+///
+/// \brief Niblack类阈值：均值加减max(StdDevScale * 标准差, AbsThreshold)
+///
+struct VarianceRule
+{
+  LightDarkMode mode;
+  float scale;
+  float abs_threshold;
+
+  bool operator () (const float g, const float mean, const float deviation) const
+  {
+    const float v = scale >= 0 ? std::max(scale * deviation, abs_threshold)
+                               : std::min(scale * deviation, abs_threshold);
+    const OffsetRule rule = { mode, v };
+    return rule(g, mean, 0.f);
+  }
+};
+
+///
+/// \brief Sauvola阈值：均值 * (1 + Scale * (标准差 / Range - 1))
+///
+struct SauvolaRule
+{
+  LightDarkMode mode;
+  float scale;
+  float range;
+
+  bool operator () (const float g, const float mean, const float deviation) const
+  {
+    const float t = mean * (1 + scale * (deviation / range - 1));
+    return mode == kLight ? g >= t : g <= t;
+  }
+};
+
+///
+/// \brief    逐像素与阈值图像比较，SIMD逐行生成掩膜
+///
+class DynThresholdRow
+{
+public:
+  DynThresholdRow(const cv::Mat& _image, const cv::Mat& _threshold, LightDarkMode _mode,
+                  float _offset)
+    : image(_image), threshold(_threshold), mode(_mode), offset(_offset)
+  { }
+
+  void operator () (const int i, uchar* mask) const
+  {
+    const uchar* g = image.ptr<uchar>(i);
+    const uchar* t = threshold.ptr<uchar>(i);
+    int j = 0;
+#if CV_SIMD128
+    // Differences are formed in 16-bit lanes, fractional offsets use the scalar rule
+    const bool integral_offset = offset == std::floor(offset) && std::fabs(offset) <= 255;
+    const cv::v_int16x8 voff = cv::v_setall_s16((short)offset);
+    const cv::v_int16x8 vneg = cv::v_setall_s16((short)-offset);
+    for (; integral_offset && j <= image.cols - 16; j += 16)
+    {
+      cv::v_uint16x8 g0, g1, t0, t1;
+      cv::v_expand(cv::v_load(g + j), g0, g1);
+      cv::v_expand(cv::v_load(t + j), t0, t1);
+      const cv::v_int16x8 d0 = cv::v_reinterpret_as_s16(g0) - cv::v_reinterpret_as_s16(t0);
+      const cv::v_int16x8 d1 = cv::v_reinterpret_as_s16(g1) - cv::v_reinterpret_as_s16(t1);
+      cv::v_int16x8 m0, m1;
+      switch (mode)
+      {
+      case kLight: m0 = d0 >= voff; m1 = d1 >= voff; break;
+      case kDark: m0 = d0 <= vneg; m1 = d1 <= vneg; break;
+      case kEqual: m0 = (d0 >= vneg) & (d0 <= voff); m1 = (d1 >= vneg) & (d1 <= voff); break;
+      default: m0 = (d0 < vneg) | (d0 > voff); m1 = (d1 < vneg) | (d1 > voff); break;
+      }
+      cv::v_store(mask + j, cv::v_pack(cv::v_reinterpret_as_u16(m0) >> 8,
+                                       cv::v_reinterpret_as_u16(m1) >> 8));
+    }
+#endif
+    const OffsetRule rule = { mode, offset };
+    for (; j < image.cols; j++)
+      mask[j] = rule(g[j], t[j], 0.f) ? 255 : 0;
+  }
+
+private:
+  cv::Mat image;
+  cv::Mat threshold;
+  LightDarkMode mode;
+  float offset;
+};
+
+} // my_cv
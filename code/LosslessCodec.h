@@ -0,0 +1,446 @@
+﻿///*****************************************************************************
+///
+/// \file       LosslessCodec.h
+/// \brief      分带并行的快速无损图像压缩
+///
+///             图像按行分成互相独立的带，各带并行编码和解码。每个带的首行用左邻像素
+///             预测，其余行用LOCO-I的MED预测；残差映射为非负数后每32个一组，按组内
+///             最大值的位数紧凑存放。压缩率低于PNG，但编码和解码都只有少量整数运算，
+///             适合保存大量追溯图像。支持8位和16位、1至4通道的图像
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace my_cv {
+
+/// 无损压缩图像文件的扩展名
+static const char* const kLosslessImageExtension = ".simz";
+/// 每组残差数
+static const int kLosslessBlock = 32;
+
+///
+/// \brief 无损压缩文件头，之后是band_count + 1个uint64_t的带起点表（相对文件开头）
+///
+struct LosslessImageHeader
+{
+  char magic[4];        ///< "SIMZ"
+  uint32_t version;     ///< 当前为1
+  int32_t rows;
+  int32_t cols;
+  int32_t type;
+  int32_t band_rows;    ///< 每带行数，最后一带可能较少
+  int32_t band_count;
+  uint8_t reserved[36];
+};
+
+static_assert(sizeof(LosslessImageHeader) == 64, "LosslessImageHeader must be 64 bytes");
+
+///
+/// \brief    MED预测，即a、b、a + b - c三者的中值
+///
+static inline int MedPredict(const int a, const int b, const int c)
+{
+  return std::max(std::min(a, b), std::min(std::max(a, b), a + b - c));
+}
+
+///
+/// \brief    按组紧凑存放n个残差，每组为1字节位数加上32个等位数的值，不足一组时补0
+///
+static void PackResiduals(const uint16_t* z, const size_t n, std::vector<uchar>& out)
+{
+  // Worst case 16 bits per residual, shrunk to the actual size at the end
+  const size_t start = out.size();
+  out.resize(start + (n + kLosslessBlock - 1) / kLosslessBlock * (1 + kLosslessBlock * 2));
+  uchar* p = &out[start];
+  uint16_t tail[kLosslessBlock];
+  for (size_t i = 0; i < n; i += kLosslessBlock)
+  {
+    const uint16_t* block = z + i;
+    if (n - i < (size_t)kLosslessBlock)
+    {
+      std::fill(std::copy(z + i, z + n, tail), tail + kLosslessBlock, (uint16_t)0);
+      block = tail;
+    }
+    uint32_t mask = 0;
+    for (int k = 0; k < kLosslessBlock; k++)
+      mask |= block[k];
+    int width = 0;
+    while ((mask >> width) != 0)
+      width++;
+
+    *p++ = (uchar)width;
+    // 32 * width bits is a whole number of 32-bit words
+    uint64_t bits = 0;
+    int nbits = 0;
+    for (int k = 0; k < kLosslessBlock; k++)
+    {
+      bits |= (uint64_t)block[k] << nbits;
+      nbits += width;
+      if (nbits >= 32)
+      {
+        const uint32_t word = (uint32_t)bits;
+        std::memcpy(p, &word, 4);
+        p += 4;
+        bits >>= 32;
+        nbits -= 32;
+      }
+    }
+  }
+  out.resize(p - &out[0]);
+}
+
+///
+/// \brief    解码n个残差，数据不足或格式错误时返回false
+///
+static bool UnpackResiduals(const uchar* p, const uchar* end, uint16_t* z, const size_t n)
+{
+  uint16_t tail[kLosslessBlock];
+  for (size_t i = 0; i < n; i += kLosslessBlock)
+  {
+    if (p >= end)
+      return false;
+    const int width = *p++;
+    if (width > 16 || end - p < kLosslessBlock / 8 * width)
+      return false;
+    uint16_t* block = n - i < (size_t)kLosslessBlock ? tail : z + i;
+    const uint32_t mask = (1u << width) - 1;
+    uint64_t bits = 0;
+    int nbits = 0;
+    for (int k = 0; k < kLosslessBlock; k++)
+    {
+      if (nbits < width)
+      {
+        uint32_t word;
+        std::memcpy(&word, p, 4);
+        p += 4;
+        bits |= (uint64_t)word << nbits;
+        nbits += 32;
+      }
+      block[k] = (uint16_t)(bits & mask);
+      bits >>= width;
+      nbits -= width;
+    }
+    if (block == tail)
+      std::copy(tail, tail + (n - i), z + i);
+  }
+  return true;
+}
+
+///
+/// \brief    残差按像素位数回绕为有符号数，再以zigzag映射为非负数
+///
+template <typename T>
+static inline uint16_t ZigzagResidual(const int value, const int pred)
+{
+  const int r = (int)(typename std::conditional<sizeof(T) == 1, schar, short>::type)(value - pred);
+  return (uint16_t)((T)(r * 2) ^ (T)(r >> 31));
+}
+
+///
+/// \brief    ZigzagResidual的逆映射，加到预测值上后按像素位数截断即为原值
+///
+static inline int UnzigzagResidual(const uint16_t z)
+{
+  return (z >> 1) ^ -(z & 1);
+}
+
+#if CV_SIMD128
+template <typename T>
+struct LosslessVector;
+
+template <>
+struct LosslessVector<uchar>
+{
+  typedef cv::v_int16x8 Wide;
+  static Wide Load(const uchar* p) { return cv::v_reinterpret_as_s16(cv::v_load_expand(p)); }
+  static void Store(uint16_t* z, const Wide& v)
+  {
+    cv::v_store((ushort*)z, cv::v_reinterpret_as_u16(v & cv::v_setall_s16(0xff)));
+  }
+};
+
+template <>
+struct LosslessVector<ushort>
+{
+  typedef cv::v_int32x4 Wide;
+  static Wide Load(const ushort* p) { return cv::v_reinterpret_as_s32(cv::v_load_expand(p)); }
+  static void Store(uint16_t* z, const Wide& v)
+  {
+    cv::v_pack_store((ushort*)z, cv::v_reinterpret_as_u32(v & cv::v_setall_s32(0xffff)));
+  }
+};
+
+///
+/// \brief    与ZigzagResidual相同的残差，从第cn个值开始每次处理Wide::nlanes个，返回已处理到的位置
+///
+template <typename T>
+static int ZigzagResidualRowSimd(const T* row, const T* up, const int cn, const int width,
+                                 uint16_t* z)
+{
+  typedef LosslessVector<T> V;
+  typedef typename V::Wide W;
+  // Shifting up and back sign-extends the low sizeof(T) bytes of each lane
+  const int wrap = (int)(sizeof(typename W::lane_type) - sizeof(T)) * 8;
+  const int sign = (int)sizeof(typename W::lane_type) * 8 - 1;
+  int j = cn;
+  for (; j <= width - W::nlanes; j += W::nlanes)
+  {
+    const W x = V::Load(row + j), a = V::Load(row + j - cn);
+    W pred = a;
+    if (up)
+    {
+      const W b = V::Load(up + j), c = V::Load(up + j - cn);
+      pred = cv::v_max(cv::v_min(a, b), cv::v_min(cv::v_max(a, b), a + b - c));
+    }
+    W r = x - pred;
+    r = (r << wrap) >> wrap;
+    V::Store(z + j, (r << 1) ^ (r >> sign));
+  }
+  return j;
+}
+#endif
+
+///
+/// \brief    编码一带，T为uchar或ushort
+///
+template <typename T>
+static void EncodeLosslessBand(const cv::Mat& image, const int row_begin, const int row_end,
+                               std::vector<uchar>& out)
+{
+  const int cn = image.channels();
+  const int width = image.cols * cn;
+  std::vector<uint16_t> residuals((size_t)width * (row_end - row_begin));
+  uint16_t* z = &residuals[0];
+  for (int i = row_begin; i < row_end; i++, z += width)
+  {
+    const T* row = image.ptr<T>(i);
+    const T* up = i > row_begin ? image.ptr<T>(i - 1) : NULL;
+    for (int j = 0; j < cn; j++)
+      z[j] = ZigzagResidual<T>(row[j], up ? up[j] : 0);
+    int j = cn;
+#if CV_SIMD128
+    j = ZigzagResidualRowSimd(row, up, cn, width, z);
+#endif
+    // Branch-free inner loops so that the compiler can vectorize them
+    if (up)
+      for (; j < width; j++)
+        z[j] = ZigzagResidual<T>(row[j], MedPredict(row[j - cn], up[j], up[j - cn]));
+    else
+      for (; j < width; j++)
+        z[j] = ZigzagResidual<T>(row[j], row[j - cn]);
+  }
+  PackResiduals(&residuals[0], residuals.size(), out);
+}
+
+template <typename T>
+static bool DecodeLosslessBand(const uchar* p, const uchar* end, const int row_begin,
+                               const int row_end, cv::Mat& image)
+{
+  const int cn = image.channels();
+  const int width = image.cols * cn;
+  std::vector<uint16_t> residuals((size_t)width * (row_end - row_begin));
+  if (!UnpackResiduals(p, end, &residuals[0], residuals.size()))
+    return false;
+
+  const uint16_t* z = &residuals[0];
+  for (int i = row_begin; i < row_end; i++, z += width)
+  {
+    T* row = image.ptr<T>(i);
+    const T* up = i > row_begin ? image.ptr<T>(i - 1) : NULL;
+    for (int j = 0; j < cn; j++)
+      row[j] = (T)((up ? up[j] : 0) + UnzigzagResidual(z[j]));
+    // Same split as the encoder, the inner loops have no per-pixel branches
+    if (up)
+      for (int j = cn; j < width; j++)
+        row[j] = (T)(MedPredict(row[j - cn], up[j], up[j - cn]) + UnzigzagResidual(z[j]));
+    else
+      for (int j = cn; j < width; j++)
+        row[j] = (T)(row[j - cn] + UnzigzagResidual(z[j]));
+  }
+  return true;
+}
+
+class LosslessBandRunner : public cv::ParallelLoopBody
+{
+public:
+  ///
+  /// \brief    编码
+  ///
+  LosslessBandRunner(const cv::Mat& _image, const int _band_rows,
+                     std::vector<std::vector<uchar> >& _bands)
+    : image(_image), band_rows(_band_rows), bands(&_bands), data(NULL), offsets(NULL),
+      size(0), ok(NULL)
+  { }
+
+  ///
+  /// \brief    解码
+  ///
+  LosslessBandRunner(cv::Mat& _image, const int _band_rows, const uchar* _data,
+                     const uint64_t* _offsets, const size_t _size, std::vector<uchar>& _ok)
+    : image(_image), band_rows(_band_rows), bands(NULL), data(_data), offsets(_offsets),
+      size(_size), ok(&_ok)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const bool wide = image.depth() == CV_16U;
+    for (int b = range.start; b < range.end; b++)
+    {
+      const int row_begin = b * band_rows;
+      const int row_end = std::min(row_begin + band_rows, image.rows);
+      if (bands)
+      {
+        if (wide)
+          EncodeLosslessBand<ushort>(image, row_begin, row_end, (*bands)[b]);
+        else
+          EncodeLosslessBand<uchar>(image, row_begin, row_end, (*bands)[b]);
+        continue;
+      }
+
+      if (offsets[b] > offsets[b + 1] || offsets[b + 1] > size)
+      {
+        (*ok)[b] = 0;
+        continue;
+      }
+      cv::Mat dst = image;
+      const uchar* begin = data + offsets[b];
+      const uchar* end = data + offsets[b + 1];
+      (*ok)[b] = wide ? DecodeLosslessBand<ushort>(begin, end, row_begin, row_end, dst)
+                      : DecodeLosslessBand<uchar>(begin, end, row_begin, row_end, dst);
+    }
+  }
+
+private:
+  cv::Mat image;
+  const int band_rows;
+  std::vector<std::vector<uchar> >* bands;
+  const uchar* data;
+  const uint64_t* offsets;
+  const size_t size;
+  std::vector<uchar>* ok;
+};
+
+///
+/// \brief    压缩图像
+/// \param    [in]  band_rows  每带行数，越小并行度越高，每带的首行压缩率较低
+/// \return   图像为空或不是8位、16位时返回false
+///
+static bool EncodeLosslessImage(const cv::Mat& image, std::vector<uchar>& bytes,
+                                const int band_rows = 64)
+{
+  CV_Assert(band_rows > 0);
+  if (image.empty() || image.dims != 2 || image.channels() > 4 ||
+      (image.depth() != CV_8U && image.depth() != CV_16U))
+    return false;
+
+  LosslessImageHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "SIMZ", 4);
+  header.version = 1;
+  header.rows = image.rows;
+  header.cols = image.cols;
+  header.type = image.type();
+  header.band_rows = band_rows;
+  header.band_count = (image.rows + band_rows - 1) / band_rows;
+
+  std::vector<std::vector<uchar> > bands(header.band_count);
+  cv::parallel_for_(cv::Range(0, header.band_count),
+                    LosslessBandRunner(image, band_rows, bands));
+
+  std::vector<uint64_t> offsets(header.band_count + 1);
+  offsets[0] = sizeof(header) + offsets.size() * sizeof(uint64_t);
+  for (int b = 0; b < header.band_count; b++)
+    offsets[b + 1] = offsets[b] + bands[b].size();
+  bytes.resize((size_t)offsets.back());
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  std::memcpy(&bytes[sizeof(header)], &offsets[0], offsets.size() * sizeof(uint64_t));
+  for (int b = 0; b < header.band_count; b++)
+    if (!bands[b].empty())
+      std::memcpy(&bytes[(size_t)offsets[b]], &bands[b][0], bands[b].size());
+  return true;
+}
+
+///
+/// \brief    解压图像
+///
+static bool DecodeLosslessImage(const uchar* data, const size_t size, cv::Mat& image)
+{
+  LosslessImageHeader header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, "SIMZ", 4) != 0 || header.version != 1 || header.rows <= 0 ||
+      header.cols <= 0 || header.band_rows <= 0 || header.type != CV_MAT_TYPE(header.type) ||
+      CV_MAT_CN(header.type) > 4 ||
+      (CV_MAT_DEPTH(header.type) != CV_8U && CV_MAT_DEPTH(header.type) != CV_16U) ||
+      header.band_count != (header.rows + header.band_rows - 1) / header.band_rows)
+    return false;
+  const size_t table_bytes = (header.band_count + 1) * sizeof(uint64_t);
+  if (size - sizeof(header) < table_bytes)
+    return false;
+  std::vector<uint64_t> offsets(header.band_count + 1);
+  std::memcpy(&offsets[0], data + sizeof(header), table_bytes);
+
+  cv::Mat result(header.rows, header.cols, header.type);
+  std::vector<uchar> ok(header.band_count, 1);
+  cv::parallel_for_(cv::Range(0, header.band_count),
+                    LosslessBandRunner(result, header.band_rows, data, &offsets[0], size, ok));
+  if (std::find(ok.begin(), ok.end(), 0) != ok.end())
+    return false;
+  image = result;
+  return true;
+}
+
+static bool WriteLosslessImage(const std::string& file_name, const cv::Mat& image)
+{
+  std::vector<uchar> bytes;
+  if (!EncodeLosslessImage(image, bytes))
+    return false;
+  FILE* file = std::fopen(file_name.c_str(), "wb");
+  if (file == NULL)
+    return false;
+  const bool ok = std::fwrite(&bytes[0], 1, bytes.size(), file) == bytes.size();
+  return std::fclose(file) == 0 && ok;
+}
+
+static bool ReadLosslessImage(const std::string& file_name, cv::Mat& image)
+{
+  FILE* file = std::fopen(file_name.c_str(), "rb");
+  if (file == NULL)
+    return false;
+  std::fseek(file, 0, SEEK_END);
+  const long size = std::ftell(file);
+  std::fseek(file, 0, SEEK_SET);
+  std::vector<uchar> bytes(size > 0 ? (size_t)size : 0);
+  const bool ok = !bytes.empty() && std::fread(&bytes[0], 1, bytes.size(), file) == bytes.size();
+  std::fclose(file);
+  return ok && DecodeLosslessImage(&bytes[0], bytes.size(), image);
+}
+
+///
+/// \brief    文件名是否以kLosslessImageExtension结尾
+///
+static bool IsLosslessImageFile(const std::string& file_name)
+{
+  const size_t n = std::strlen(kLosslessImageExtension);
+  return file_name.size() >= n &&
+         file_name.compare(file_name.size() - n, n, kLosslessImageExtension) == 0;
+}
+
+} // my_cv
@@ -0,0 +1,164 @@
+﻿///*****************************************************************************
+///
+/// \file       LutTransform.h
+/// \brief      灰度查找表变换
+///
+///             8位到8位的查找表把256项拆成16张16字节的子表，用字节混洗指令查表：
+///             x - 16k饱和加0x70后，只有高4位为k的像素最高位为0，混洗结果非0，
+///             其余像素被清零，16张子表的结果相或即为查表值。SSSE3每次处理16个
+///             像素，AVX2每次处理32个像素。输出16位或输入16位时使用逐像素查表
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#if CV_AVX2
+#include <immintrin.h>
+#elif CV_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#include <algorithm>
+
+namespace my_cv {
+
+///
+/// \brief    8位查表一行，lut为256项
+///
+static void LutRow8u(const uchar* src, uchar* dst, const int n, const uchar* lut)
+{
+  int j = 0;
+#if CV_AVX2
+  {
+    __m256i tables[16];
+    for (int k = 0; k < 16; k++)
+      tables[k] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(lut + 16 * k)));
+    const __m256i bias = _mm256_set1_epi8(0x70);
+    const __m256i sixteen = _mm256_set1_epi8(16);
+    for (; j <= n - 32; j += 32)
+    {
+      __m256i index = _mm256_loadu_si256((const __m256i*)(src + j));
+      __m256i result = _mm256_setzero_si256();
+      for (int k = 0; k < 16; k++)
+      {
+        result = _mm256_or_si256(result,
+                                 _mm256_shuffle_epi8(tables[k], _mm256_adds_epu8(index, bias)));
+        index = _mm256_sub_epi8(index, sixteen);
+      }
+      _mm256_storeu_si256((__m256i*)(dst + j), result);
+    }
+  }
+#endif
+#if CV_SSSE3
+  {
+    __m128i tables[16];
+    for (int k = 0; k < 16; k++)
+      tables[k] = _mm_loadu_si128((const __m128i*)(lut + 16 * k));
+    const __m128i bias = _mm_set1_epi8(0x70);
+    const __m128i sixteen = _mm_set1_epi8(16);
+    for (; j <= n - 16; j += 16)
+    {
+      __m128i index = _mm_loadu_si128((const __m128i*)(src + j));
+      __m128i result = _mm_setzero_si128();
+      for (int k = 0; k < 16; k++)
+      {
+        result = _mm_or_si128(result, _mm_shuffle_epi8(tables[k], _mm_adds_epu8(index, bias)));
+        index = _mm_sub_epi8(index, sixteen);
+      }
+      _mm_storeu_si128((__m128i*)(dst + j), result);
+    }
+  }
+#endif
+  for (; j <= n - 4; j += 4)
+  {
+    const uchar t0 = lut[src[j]];
+    const uchar t1 = lut[src[j + 1]];
+    const uchar t2 = lut[src[j + 2]];
+    const uchar t3 = lut[src[j + 3]];
+    dst[j] = t0;
+    dst[j + 1] = t1;
+    dst[j + 2] = t2;
+    dst[j + 3] = t3;
+  }
+  for (; j < n; j++)
+    dst[j] = lut[src[j]];
+}
+
+///
+/// \brief    逐像素查表一行，用于8位到16位及16位到16位
+///
+template <typename SrcT>
+static void LutRowGather(const SrcT* src, ushort* dst, const int n, const ushort* lut)
+{
+  int j = 0;
+  for (; j <= n - 4; j += 4)
+  {
+    const ushort t0 = lut[src[j]];
+    const ushort t1 = lut[src[j + 1]];
+    const ushort t2 = lut[src[j + 2]];
+    const ushort t3 = lut[src[j + 3]];
+    dst[j] = t0;
+    dst[j + 1] = t1;
+    dst[j + 2] = t2;
+    dst[j + 3] = t3;
+  }
+  for (; j < n; j++)
+    dst[j] = lut[src[j]];
+}
+
+class LutRunner : public cv::ParallelLoopBody
+{
+public:
+  LutRunner(const cv::Mat& _src, cv::Mat& _dst, const cv::Mat& _lut)
+    : src(_src), dst(_dst), lut(_lut)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int n = src.cols * src.channels();
+    for (int i = range.start; i < range.end; i++)
+    {
+      if (src.depth() == CV_8U && dst.depth() == CV_8U)
+        LutRow8u(src.ptr<uchar>(i), dst.ptr<uchar>(i), n, lut.ptr<uchar>());
+      else if (src.depth() == CV_8U)
+        LutRowGather(src.ptr<uchar>(i), dst.ptr<ushort>(i), n, lut.ptr<ushort>());
+      else
+        LutRowGather(src.ptr<ushort>(i), dst.ptr<ushort>(i), n, lut.ptr<ushort>());
+    }
+  }
+
+private:
+  cv::Mat src;
+  cv::Mat& dst;
+  cv::Mat lut;
+};
+
+///
+/// \brief    查找表变换，各通道使用同一张表
+/// \param    [in]  src  CV_8U或CV_16U图像
+/// \param    [out] dst  与src通道数相同，深度与lut相同
+/// \param    [in]  lut  CV_8U图像为256项，CV_16U图像为65536项；元素为CV_8U或CV_16U
+///
+static void LutTransform(const cv::Mat& src, cv::Mat& dst, const cv::Mat& lut)
+{
+  CV_Assert(src.depth() == CV_8U || src.depth() == CV_16U);
+  CV_Assert(lut.isContinuous() && lut.channels() == 1);
+  CV_Assert(lut.depth() == CV_8U || lut.depth() == CV_16U);
+  if (lut.total() != (src.depth() == CV_8U ? 256u : 65536u))
+    CV_Error(cv::Error::StsBadArg, "LUT size does not match the image depth");
+  if (src.depth() == CV_16U && lut.depth() != CV_16U)
+    CV_Error(cv::Error::StsBadArg, "16-bit images need a 16-bit LUT");
+  CV_Assert(dst.data != src.data);
+
+  dst.create(src.size(), CV_MAKETYPE(lut.depth(), src.channels()));
+  cv::parallel_for_(cv::Range(0, src.rows), LutRunner(src, dst, lut),
+                    src.total() / (double)(1 << 16));
+}
+
+} // my_cv
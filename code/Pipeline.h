@@ -0,0 +1,492 @@
+﻿///*****************************************************************************
+///
+/// \file       Pipeline.h
+/// \brief      采集到检测的流水线
+///
+///             流水线由若干级组成（如采集、预处理、检测、输出），级与级之间用无锁的
+///             有界队列传递预先分配的帧。每级可设置线程数、CPU亲和性和下一级队列满时
+///             的处理方式；每帧记录进入每级队列、开始和结束处理的时间，据此统计每级
+///             的排队时间、处理时间和端到端延时，用于查找丢触发时延时花在了哪里
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace my_cv {
+
+///
+/// \brief 有界多生产者多消费者无锁队列（Vyukov），容量为2的幂
+///
+template <typename T>
+class BoundedQueue
+{
+public:
+  explicit BoundedQueue(const size_t capacity)
+    : cells_(new Cell[capacity]), mask_(capacity - 1), enqueue_(0), dequeue_(0)
+  {
+    CV_Assert(capacity >= 2 && (capacity & (capacity - 1)) == 0);
+    for (size_t k = 0; k < capacity; k++)
+      cells_[k].sequence.store(k, std::memory_order_relaxed);
+  }
+
+  bool TryPush(const T& value)
+  {
+    Cell* cell;
+    size_t pos = enqueue_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+      if (diff == 0)
+      {
+        if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = enqueue_.load(std::memory_order_relaxed);
+    }
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool TryPop(T& value)
+  {
+    Cell* cell;
+    size_t pos = dequeue_.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells_[pos & mask_];
+      const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+      if (diff == 0)
+      {
+        if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = dequeue_.load(std::memory_order_relaxed);
+    }
+    value = cell->value;
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  ///
+  /// \brief    近似的元素数
+  ///
+  size_t Size() const
+  {
+    const size_t head = dequeue_.load(std::memory_order_relaxed);
+    const size_t tail = enqueue_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+private:
+  struct Cell
+  {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  BoundedQueue(const BoundedQueue&);
+  BoundedQueue& operator=(const BoundedQueue&);
+
+  std::unique_ptr<Cell[]> cells_;
+  const size_t mask_;
+  // Producers and consumers update different cache lines
+  char pad0_[64];
+  std::atomic<size_t> enqueue_;
+  char pad1_[64];
+  std::atomic<size_t> dequeue_;
+  char pad2_[64];
+};
+
+///
+/// \brief 下一级队列满时的处理方式
+///
+enum StageOverflow
+{
+  kStageBlock,  ///< 等待下一级队列有空位
+  kStageDrop    ///< 丢弃该帧
+};
+
+///
+/// \brief 帧在一级中的时间
+///
+struct StageTimes
+{
+  std::chrono::steady_clock::time_point queued;    ///< 进入该级队列
+  std::chrono::steady_clock::time_point started;
+  std::chrono::steady_clock::time_point finished;
+};
+
+///
+/// \brief 流水线中传递的帧，由流水线预先分配并循环使用
+///
+template <typename Image>
+struct PipelineFrame
+{
+  PipelineFrame()
+    : frame_number(0)
+  { }
+
+  Image image;
+  std::shared_ptr<void> result;    ///< 各级之间传递的检测结果等
+  uint64_t frame_number;           ///< 进入流水线的顺序，从1开始
+  std::vector<StageTimes> times;   ///< 每级一项
+};
+
+struct StageParams
+{
+  StageParams()
+    : workers(1), queue_capacity(16), overflow(kStageBlock)
+  { }
+
+  std::string name;
+  int workers;             ///< 该级线程数，大于1时帧的顺序可能改变
+  size_t queue_capacity;   ///< 该级输入队列容量，取不小于它的2的幂
+  StageOverflow overflow;  ///< 该级输入队列满时上一级的处理方式
+  std::vector<int> cpus;   ///< 该级线程可运行的CPU，为空时不限制
+};
+
+///
+/// \brief 一级的统计，时间单位为毫秒
+///
+struct StageMetrics
+{
+  StageMetrics()
+    : processed(0), rejected(0), dropped(0), queue_depth(0), mean_wait_ms(0), max_wait_ms(0),
+      mean_service_ms(0), max_service_ms(0)
+  { }
+
+  std::string name;
+  uint64_t processed;
+  uint64_t rejected;       ///< 处理函数返回false的帧数
+  uint64_t dropped;        ///< 因该级队列满被丢弃的帧数，第一级为没有空闲帧的次数
+  size_t queue_depth;
+  double mean_wait_ms;     ///< 在该级队列中等待的时间
+  double max_wait_ms;
+  double mean_service_ms;  ///< 处理函数的时间
+  double max_service_ms;
+};
+
+///
+/// \brief    把thread限制在cpus上运行，不支持的平台忽略
+///
+static void SetThreadAffinity(std::thread& thread, const std::vector<int>& cpus)
+{
+  if (cpus.empty())
+    return;
+#ifdef _WIN32
+  DWORD_PTR mask = 0;
+  for (size_t k = 0; k < cpus.size(); k++)
+    mask |= (DWORD_PTR)1 << cpus[k];
+  SetThreadAffinityMask(thread.native_handle(), mask);
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t k = 0; k < cpus.size(); k++)
+    CPU_SET(cpus[k], &set);
+  pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+  (void)thread;
+#endif
+}
+
+///
+/// \brief 多级流水线
+///
+/// 第一级是帧源，从空闲帧池取帧并填充（如从相机取图），返回false表示暂时没有帧；
+/// 其余各级返回false表示该帧不再向后传递。最后一级处理完或中途被丢弃的帧清空后
+/// 回到空闲帧池。Image为SImage等可默认构造和复制的图像句柄
+///
+template <typename Image>
+class Pipeline
+{
+public:
+  typedef PipelineFrame<Image> Frame;
+  typedef std::function<bool(Frame&)> StageFunction;
+
+  ///
+  /// \param    [in]  frame_count  流水线中同时存在的帧数
+  ///
+  explicit Pipeline(const size_t frame_count)
+    : frames_(frame_count), running_(false), frame_number_(0), completed_(0), latency_ns_(0),
+      max_latency_ns_(0)
+  {
+    CV_Assert(frame_count > 0);
+  }
+
+  ~Pipeline()
+  {
+    Stop();
+  }
+
+  ///
+  /// \brief    添加一级，须在Start之前调用
+  ///
+  void AddStage(const StageParams& params, const StageFunction& function)
+  {
+    CV_Assert(!running_ && params.workers > 0 && function);
+    std::unique_ptr<Stage> stage(new Stage(params, function));
+    stages_.push_back(std::move(stage));
+  }
+
+  void Start()
+  {
+    CV_Assert(!stages_.empty());
+    if (running_)
+      return;
+    free_.reset(new BoundedQueue<Frame*>(RoundUpPow2(frames_.size())));
+    for (size_t k = 0; k < frames_.size(); k++)
+    {
+      frames_[k].times.assign(stages_.size(), StageTimes());
+      free_->TryPush(&frames_[k]);
+    }
+    running_ = true;
+    for (size_t s = 0; s < stages_.size(); s++)
+      for (int k = 0; k < stages_[s]->params.workers; k++)
+      {
+        threads_.push_back(std::thread(&Pipeline::Work, this, s));
+        SetThreadAffinity(threads_.back(), stages_[s]->params.cpus);
+      }
+  }
+
+  ///
+  /// \brief    停止所有线程，队列中未处理完的帧被丢弃
+  ///
+  void Stop()
+  {
+    if (!running_)
+      return;
+    running_ = false;
+    for (size_t k = 0; k < threads_.size(); k++)
+      threads_[k].join();
+    threads_.clear();
+    Frame* frame;
+    for (size_t s = 0; s < stages_.size(); s++)
+      while (stages_[s]->queue.TryPop(frame))
+        Recycle(*frame);
+  }
+
+  std::vector<StageMetrics> Metrics() const
+  {
+    std::vector<StageMetrics> metrics(stages_.size());
+    for (size_t s = 0; s < stages_.size(); s++)
+    {
+      const Stage& stage = *stages_[s];
+      StageMetrics& m = metrics[s];
+      m.name = stage.params.name;
+      m.processed = stage.processed.load();
+      m.rejected = stage.rejected.load();
+      m.dropped = stage.dropped.load();
+      m.queue_depth = stage.queue.Size();
+      const double count = (double)std::max<uint64_t>(m.processed, 1);
+      m.mean_wait_ms = stage.wait_ns.load() / count * 1e-6;
+      m.max_wait_ms = stage.max_wait_ns.load() * 1e-6;
+      m.mean_service_ms = stage.service_ns.load() / count * 1e-6;
+      m.max_service_ms = stage.max_service_ns.load() * 1e-6;
+    }
+    return metrics;
+  }
+
+  ///
+  /// \brief    走完所有级的帧从第一级开始到最后一级结束的平均和最大延时（毫秒）
+  ///
+  void Latency(double& mean_ms, double& max_ms, uint64_t& completed) const
+  {
+    completed = completed_.load();
+    mean_ms = completed > 0 ? latency_ns_.load() / (double)completed * 1e-6 : 0;
+    max_ms = max_latency_ns_.load() * 1e-6;
+  }
+
+private:
+  struct Stage
+  {
+    Stage(const StageParams& _params, const StageFunction& _function)
+      : params(_params), function(_function), queue(RoundUpPow2(_params.queue_capacity)),
+        processed(0), rejected(0), dropped(0), wait_ns(0), max_wait_ns(0), service_ns(0),
+        max_service_ns(0)
+    { }
+
+    const StageParams params;
+    const StageFunction function;
+    BoundedQueue<Frame*> queue;  ///< Input queue, unused by the first stage
+    std::atomic<uint64_t> processed;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> max_wait_ns;
+    std::atomic<uint64_t> service_ns;
+    std::atomic<uint64_t> max_service_ns;
+  };
+
+  Pipeline(const Pipeline&);
+  Pipeline& operator=(const Pipeline&);
+
+  static size_t RoundUpPow2(const size_t n)
+  {
+    size_t p = 2;
+    while (p < n)
+      p <<= 1;
+    return p;
+  }
+
+  static uint64_t Nanoseconds(const std::chrono::steady_clock::duration& d)
+  {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+  }
+
+  static void UpdateMax(std::atomic<uint64_t>& max_value, const uint64_t value)
+  {
+    uint64_t current = max_value.load(std::memory_order_relaxed);
+    while (value > current && !max_value.compare_exchange_weak(current, value))
+    { }
+  }
+
+  ///
+  /// \brief    空转等待：先让出时间片，多次落空后短暂休眠
+  ///
+  static void Backoff(int& idle)
+  {
+    if (++idle < 64)
+      std::this_thread::yield();
+    else
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+
+  void Recycle(Frame& frame)
+  {
+    frame.image = Image();
+    frame.result.reset();
+    free_->TryPush(&frame);
+  }
+
+  void Work(const size_t s)
+  {
+    Stage& stage = *stages_[s];
+    const bool source = s == 0;
+    BoundedQueue<Frame*>& input = source ? *free_ : stage.queue;
+    int idle = 0;
+    bool starved = false;
+    while (running_)
+    {
+      Frame* frame;
+      if (!input.TryPop(frame))
+      {
+        // The source counts each stretch without a free frame once
+        if (source && !starved)
+          stage.dropped++;
+        starved = true;
+        Backoff(idle);
+        continue;
+      }
+      starved = false;
+
+      StageTimes& times = frame->times[s];
+      times.started = std::chrono::steady_clock::now();
+      if (source)
+        times.queued = times.started;
+      const bool ok = stage.function(*frame);
+      times.finished = std::chrono::steady_clock::now();
+      if (source && !ok)
+      {
+        // No frame from the source is not a rejection, wait before polling it again
+        Recycle(*frame);
+        Backoff(idle);
+        continue;
+      }
+      idle = 0;
+      if (source)
+        frame->frame_number = ++frame_number_;
+
+      const uint64_t wait = Nanoseconds(times.started - times.queued);
+      const uint64_t service = Nanoseconds(times.finished - times.started);
+      stage.processed++;
+      stage.wait_ns += wait;
+      stage.service_ns += service;
+      UpdateMax(stage.max_wait_ns, wait);
+      UpdateMax(stage.max_service_ns, service);
+      if (!ok)
+      {
+        stage.rejected++;
+        Recycle(*frame);
+      }
+      else if (s + 1 == stages_.size())
+        Complete(*frame);
+      else
+        Forward(*frame, s + 1);
+    }
+  }
+
+  void Forward(Frame& frame, const size_t s)
+  {
+    Stage& next = *stages_[s];
+    frame.times[s].queued = std::chrono::steady_clock::now();
+    int idle = 0;
+    while (!next.queue.TryPush(&frame))
+    {
+      if (next.params.overflow == kStageDrop || !running_)
+      {
+        next.dropped++;
+        Recycle(frame);
+        return;
+      }
+      Backoff(idle);
+    }
+  }
+
+  void Complete(Frame& frame)
+  {
+    const uint64_t latency = Nanoseconds(frame.times.back().finished - frame.times[0].started);
+    latency_ns_ += latency;
+    UpdateMax(max_latency_ns_, latency);
+    completed_++;
+    Recycle(frame);
+  }
+
+  std::vector<Frame> frames_;
+  std::unique_ptr<BoundedQueue<Frame*> > free_;
+  std::vector<std::unique_ptr<Stage> > stages_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> running_;
+  std::atomic<uint64_t> frame_number_;
+  std::atomic<uint64_t> completed_;
+  std::atomic<uint64_t> latency_ns_;
+  std::atomic<uint64_t> max_latency_ns_;
+};
+
+} // my_cv
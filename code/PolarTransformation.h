@@ -0,0 +1,215 @@
+﻿///*****************************************************************************
+///
+/// \file       PolarTransformation.h
+/// \brief      极坐标展开及其逆变换的采样表
+///
+///             极坐标采样表以定点映射表保存，圆心与半径范围不变时由LRU缓存复用，
+///             每帧只需执行一次分块并行的重映射
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "ImageMapping.h"
+
+namespace my_cv {
+
+///
+/// \brief 极坐标变换的几何参数
+///
+/// 极坐标图像的列对应角度，行对应半径，左上角为(AngleStart, RadiusStart)，
+/// 右下角为(AngleEnd, RadiusEnd)。角度单位为弧度，逆时针为正
+///
+struct PolarGeometry
+{
+  double Row;
+  double Column;
+  double AngleStart;
+  double AngleEnd;
+  double RadiusStart;
+  double RadiusEnd;
+  cv::Size polar_size;  ///< 极坐标图像尺寸
+  cv::Size xy_size;     ///< 直角坐标图像尺寸
+
+  bool operator == (const PolarGeometry& other) const
+  {
+    return Row == other.Row && Column == other.Column && AngleStart == other.AngleStart &&
+           AngleEnd == other.AngleEnd && RadiusStart == other.RadiusStart &&
+           RadiusEnd == other.RadiusEnd && polar_size == other.polar_size &&
+           xy_size == other.xy_size;
+  }
+
+  double AngleStep() const
+  {
+    return polar_size.width > 1 ? (AngleEnd - AngleStart) / (polar_size.width - 1) : 0;
+  }
+  double RadiusStep() const
+  {
+    return polar_size.height > 1 ? (RadiusEnd - RadiusStart) / (polar_size.height - 1) : 0;
+  }
+};
+
+class PolarMapRunner : public cv::ParallelLoopBody
+{
+public:
+  PolarMapRunner(const PolarGeometry& _geometry, const std::vector<double>& _cos_table,
+                 const std::vector<double>& _sin_table, FixedPointMap& _map)
+    : geometry(_geometry), cos_table(_cos_table), sin_table(_sin_table), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int i = range.start; i < range.end; i++)
+    {
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      const double r = geometry.RadiusStart + geometry.RadiusStep() * i;
+      for (int j = 0; j < map.xy.cols; j++)
+        StoreMapEntry(geometry.Column + r * cos_table[j], geometry.Row - r * sin_table[j],
+                      xy + 2 * j, frac + j);
+    }
+  }
+
+private:
+  PolarGeometry geometry;
+  const std::vector<double>& cos_table;
+  const std::vector<double>& sin_table;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    生成直角坐标 -> 极坐标的采样表
+///
+static FixedPointMap GenPolarTransMap(const PolarGeometry& geometry)
+{
+  CV_Assert(geometry.polar_size.area() > 0 && geometry.xy_size.area() > 0);
+  CV_Assert(geometry.xy_size.width < SHRT_MAX && geometry.xy_size.height < SHRT_MAX);
+
+  // Trigonometry depends on the column only, evaluate it once per angle
+  const int width = geometry.polar_size.width;
+  std::vector<double> cos_table(width), sin_table(width);
+  for (int j = 0; j < width; j++)
+  {
+    const double angle = geometry.AngleStart + geometry.AngleStep() * j;
+    cos_table[j] = std::cos(angle);
+    sin_table[j] = std::sin(angle);
+  }
+
+  FixedPointMap map;
+  map.src_size = geometry.xy_size;
+  map.xy.create(geometry.polar_size, CV_16SC2);
+  map.frac.create(geometry.polar_size, CV_16UC1);
+  cv::parallel_for_(cv::Range(0, geometry.polar_size.height),
+                    PolarMapRunner(geometry, cos_table, sin_table, map),
+                    geometry.polar_size.area() / (double)(1 << 16));
+  return map;
+}
+
+class PolarInvMapRunner : public cv::ParallelLoopBody
+{
+public:
+  PolarInvMapRunner(const PolarGeometry& _geometry, FixedPointMap& _map)
+    : geometry(_geometry), map(_map)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const double angle_extent = geometry.AngleEnd - geometry.AngleStart;
+    const double angle_step = geometry.AngleStep();
+    const double radius_step = geometry.RadiusStep();
+    const double radius_min = std::min(geometry.RadiusStart, geometry.RadiusEnd);
+    const double radius_max = std::max(geometry.RadiusStart, geometry.RadiusEnd);
+    const double full_circle = 2 * CV_PI;
+
+    for (int i = range.start; i < range.end; i++)
+    {
+      short* xy = map.xy.ptr<short>(i);
+      ushort* frac = map.frac.ptr<ushort>(i);
+      const double dy = geometry.Row - i;
+      for (int j = 0; j < map.xy.cols; j++)
+      {
+        const double dx = j - geometry.Column;
+        const double r = std::sqrt(dx * dx + dy * dy);
+
+        // Angle relative to AngleStart, measured in the direction of the extent
+        double angle = std::atan2(dy, dx) - geometry.AngleStart;
+        if (angle_extent < 0)
+          angle = -angle;
+        angle = std::fmod(angle, full_circle);
+        if (angle < 0)
+          angle += full_circle;
+
+        double col = -2, row = -2;
+        if (r >= radius_min && r <= radius_max && angle <= std::fabs(angle_extent))
+        {
+          col = angle_step != 0 ? (angle_extent < 0 ? -angle : angle) / angle_step : 0;
+          row = radius_step != 0 ? (r - geometry.RadiusStart) / radius_step : 0;
+        }
+        StoreMapEntry(col, row, xy + 2 * j, frac + j);
+      }
+    }
+  }
+
+private:
+  PolarGeometry geometry;
+  FixedPointMap& map;
+};
+
+///
+/// \brief    生成极坐标 -> 直角坐标的采样表，圆环以外的像素为0
+///
+static FixedPointMap GenPolarTransInvMap(const PolarGeometry& geometry)
+{
+  CV_Assert(geometry.polar_size.area() > 0 && geometry.xy_size.area() > 0);
+  CV_Assert(geometry.polar_size.width < SHRT_MAX && geometry.polar_size.height < SHRT_MAX);
+
+  FixedPointMap map;
+  map.src_size = geometry.polar_size;
+  map.xy.create(geometry.xy_size, CV_16SC2);
+  map.frac.create(geometry.xy_size, CV_16UC1);
+  cv::parallel_for_(cv::Range(0, geometry.xy_size.height), PolarInvMapRunner(geometry, map),
+                    geometry.xy_size.area() / (double)(1 << 16));
+  return map;
+}
+
+struct PolarMapKey
+{
+  PolarGeometry geometry;
+  bool inverse;
+
+  bool operator == (const PolarMapKey& other) const
+  {
+    return inverse == other.inverse && geometry == other.geometry;
+  }
+};
+
+typedef FixedPointMapCache<PolarMapKey> PolarMapCache;
+
+///
+/// \brief    从缓存获取极坐标采样表，未命中时生成
+/// \param    [in]  geometry  几何参数
+/// \param    [in]  inverse   false为极坐标展开，true为逆变换
+///
+static std::shared_ptr<const FixedPointMap> CachedPolarMap(const PolarGeometry& geometry,
+                                                           const bool inverse)
+{
+  const PolarMapKey key = { geometry, inverse };
+  return PolarMapCache::Instance().Get(key, [&]() {
+    return inverse ? GenPolarTransInvMap(geometry) : GenPolarTransMap(geometry);
+  });
+}
+
+} // my_cv
@@ -0,0 +1,396 @@
+﻿///*****************************************************************************
+///
+/// \file       RawImageFile.h
+/// \brief      未压缩的原生图像文件格式
+///
+///             文件由64字节的固定文件头、按64字节对齐的像素行和可选的定义域游程组成，
+///             读写不需要编解码。读取时可将文件映射到内存，返回直接引用映射内存的
+///             图像而不复制像素；映射为写时复制，修改图像不会改变文件
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SRegion.h"
+
+namespace my_cv {
+
+/// 原生图像文件的扩展名
+static const char* const kRawImageExtension = ".simg";
+/// 像素行和像素数据起点的对齐字节数
+static const size_t kRawImageAlignment = 64;
+
+///
+/// \brief 原生图像文件头，所有字段为小端
+///
+struct RawImageHeader
+{
+  char magic[4];          ///< "SIMG"
+  uint32_t version;       ///< 当前为1
+  uint32_t header_bytes;  ///< sizeof(RawImageHeader)
+  int32_t rows;
+  int32_t cols;
+  int32_t type;           ///< cv::Mat::type()
+  uint64_t step;          ///< 行字节数，kRawImageAlignment的整数倍
+  uint64_t data_offset;   ///< 像素数据在文件中的位置
+  uint64_t domain_offset; ///< 定义域游程在文件中的位置
+  uint64_t domain_runs;   ///< 定义域游程数，0表示整幅图像
+  uint8_t reserved[8];
+};
+
+static_assert(sizeof(RawImageHeader) == 64, "RawImageHeader must be 64 bytes");
+
+static inline size_t AlignRawImage(const size_t n)
+{
+  return (n + kRawImageAlignment - 1) / kRawImageAlignment * kRawImageAlignment;
+}
+
+///
+/// \brief 只读文件的写时复制内存映射
+///
+class MappedFile
+{
+public:
+  ///
+  /// \brief    映射整个文件，失败时返回空指针
+  ///
+  static std::shared_ptr<MappedFile> Open(const std::string& file_name)
+  {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef _WIN32
+    const HANDLE handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (handle == INVALID_HANDLE_VALUE)
+      return std::shared_ptr<MappedFile>();
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(handle, &size) && size.QuadPart > 0)
+    {
+      const HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+      if (mapping != NULL)
+      {
+        file->data_ = (uchar*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+        file->size_ = (size_t)size.QuadPart;
+        CloseHandle(mapping);
+      }
+    }
+    CloseHandle(handle);
+#else
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+      return std::shared_ptr<MappedFile>();
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED)
+      {
+        file->data_ = (uchar*)p;
+        file->size_ = (size_t)st.st_size;
+      }
+    }
+    close(fd);
+#endif
+    return file->data_ ? file : std::shared_ptr<MappedFile>();
+  }
+
+  ~MappedFile()
+  {
+    if (data_ == NULL)
+      return;
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(data_, size_);
+#endif
+  }
+
+  uchar* Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+private:
+  MappedFile()
+    : data_(NULL), size_(0)
+  { }
+
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  uchar* data_;
+  size_t size_;
+};
+
+///
+/// \brief    检查文件头，并确认像素数据和游程都在size字节以内
+///
+static bool CheckRawImageHeader(const RawImageHeader& header, const uint64_t size)
+{
+  if (std::memcmp(header.magic, "SIMG", 4) != 0 || header.version != 1 ||
+      header.header_bytes != sizeof(RawImageHeader))
+    return false;
+  if (header.rows <= 0 || header.cols <= 0 || header.type != CV_MAT_TYPE(header.type))
+    return false;
+  const uint64_t row_bytes = (uint64_t)header.cols * CV_ELEM_SIZE(header.type);
+  if (header.step < row_bytes || header.step % kRawImageAlignment != 0 ||
+      header.data_offset % kRawImageAlignment != 0)
+    return false;
+  if (header.domain_runs > 0 && header.domain_offset % alignof(RegionRun) != 0)
+    return false;
+  // Divide instead of multiplying so that crafted fields cannot wrap around
+  if (header.data_offset > size ||
+      header.step > (size - header.data_offset) / (uint64_t)header.rows)
+    return false;
+  return header.domain_runs == 0 ||
+         (header.domain_offset <= size &&
+          header.domain_runs <= (size - header.domain_offset) / sizeof(RegionRun));
+}
+
+///
+/// \brief    检查定义域游程在图像内、按行和起始列排序且互不重叠
+///
+static bool CheckRawImageRuns(const std::vector<RegionRun>& runs, const RawImageHeader& header)
+{
+  for (size_t k = 0; k < runs.size(); k++)
+  {
+    const RegionRun& run = runs[k];
+    if (run.Row < 0 || run.Row >= header.rows || run.ColumnBegin < 0 ||
+        run.ColumnBegin >= run.ColumnEnd || run.ColumnEnd > header.cols)
+      return false;
+    if (k > 0 && (run.Row < runs[k - 1].Row ||
+                  (run.Row == runs[k - 1].Row && run.ColumnBegin < runs[k - 1].ColumnEnd)))
+      return false;
+  }
+  return true;
+}
+
+///
+/// \brief    64位偏移的fseek，Windows下long只有32位
+///
+static bool SeekRawFile(FILE* file, const int64_t offset, const int origin)
+{
+#ifdef _WIN32
+  return _fseeki64(file, offset, origin) == 0;
+#else
+  return fseeko(file, (off_t)offset, origin) == 0;
+#endif
+}
+
+static int64_t TellRawFile(FILE* file)
+{
+#ifdef _WIN32
+  return _ftelli64(file);
+#else
+  return (int64_t)ftello(file);
+#endif
+}
+
+///
+/// \brief    按图像尺寸生成文件头，像素紧接文件头，定义域游程紧接像素
+///
+static RawImageHeader MakeRawImageHeader(const cv::Size& size, const int type,
+                                         const size_t domain_runs)
+{
+  RawImageHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "SIMG", 4);
+  header.version = 1;
+  header.header_bytes = sizeof(RawImageHeader);
+  header.rows = size.height;
+  header.cols = size.width;
+  header.type = type;
+  header.step = AlignRawImage(size.width * CV_ELEM_SIZE(type));
+  header.data_offset = AlignRawImage(sizeof(RawImageHeader));
+  header.domain_offset = header.data_offset + header.step * size.height;
+  header.domain_runs = domain_runs;
+  return header;
+}
+
+static RawImageHeader MakeRawImageHeader(const cv::Mat& image, const SRegion* domain)
+{
+  return MakeRawImageHeader(image.size(), image.type(), domain ? domain->Runs().size() : 0);
+}
+
+///
+/// \brief    文件头所描述的总字节数
+///
+static uint64_t RawImageBytes(const RawImageHeader& header)
+{
+  return header.domain_offset + header.domain_runs * sizeof(RegionRun);
+}
+
+///
+/// \brief    由内存中的原生图像数据得到引用该内存的图像，不复制像素
+/// \param    [out] domain  非NULL时输出定义域，没有定义域时为整幅图像
+///
+static bool ViewRawImage(const uchar* data, const size_t size, cv::Mat& image, SRegion* domain)
+{
+  RawImageHeader header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  if (!CheckRawImageHeader(header, size))
+    return false;
+  image = cv::Mat(header.rows, header.cols, header.type,
+                  const_cast<uchar*>(data) + header.data_offset, (size_t)header.step);
+  if (domain && header.domain_runs > 0)
+  {
+    // The buffer itself need not be aligned, e.g. a deserialised item
+    std::vector<RegionRun> runs((size_t)header.domain_runs);
+    std::memcpy(&runs[0], data + header.domain_offset, runs.size() * sizeof(RegionRun));
+    if (!CheckRawImageRuns(runs, header))
+      return false;
+    *domain = SRegion(runs);
+  }
+  else if (domain)
+    *domain = SRegion::GenRectangle1(0, 0, header.rows - 1, header.cols - 1);
+  return true;
+}
+
+///
+/// \brief    写原生图像文件
+/// \param    [in]  domain  非NULL时一并保存定义域游程
+///
+static bool WriteRawImage(const std::string& file_name, const cv::Mat& image,
+                          const SRegion* domain)
+{
+  if (image.empty() || image.dims != 2)
+    return false;
+
+  const RawImageHeader header = MakeRawImageHeader(image, domain);
+  FILE* file = std::fopen(file_name.c_str(), "wb");
+  if (file == NULL)
+    return false;
+  // Header and row padding are both shorter than the alignment
+  const std::vector<uchar> padding(kRawImageAlignment, 0);
+  bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+            std::fwrite(&padding[0], 1, header.data_offset - sizeof(header), file) ==
+              header.data_offset - sizeof(header);
+  const size_t row_bytes = image.cols * image.elemSize();
+  const size_t pad_bytes = header.step - row_bytes;
+  if (image.isContinuous() && pad_bytes == 0)
+    ok = ok && std::fwrite(image.data, 1, row_bytes * image.rows, file) == row_bytes * image.rows;
+  else
+    for (int i = 0; i < image.rows && ok; i++)
+      ok = std::fwrite(image.ptr(i), 1, row_bytes, file) == row_bytes &&
+           std::fwrite(&padding[0], 1, pad_bytes, file) == pad_bytes;
+  if (ok && header.domain_runs > 0)
+    ok = std::fwrite(&domain->Runs()[0], sizeof(RegionRun), header.domain_runs, file) ==
+         header.domain_runs;
+  return std::fclose(file) == 0 && ok;
+}
+
+///
+/// \brief    读原生图像文件
+/// \param    [out] image    map为true时引用映射内存，否则为新分配的图像
+/// \param    [out] storage  map为true时为映射，image使用期间必须保持
+/// \param    [out] domain   非NULL时输出定义域，文件中没有定义域时为整幅图像
+/// \param    [in]  map      是否映射文件
+///
+static bool ReadRawImage(const std::string& file_name, cv::Mat& image,
+                         std::shared_ptr<const void>& storage, SRegion* domain, const bool map)
+{
+  if (map)
+  {
+    std::shared_ptr<MappedFile> file = MappedFile::Open(file_name);
+    if (!file || !ViewRawImage(file->Data(), file->Size(), image, domain))
+      return false;
+    storage = file;
+    return true;
+  }
+
+  RawImageHeader header;
+  std::vector<RegionRun> runs;
+  FILE* file = std::fopen(file_name.c_str(), "rb");
+  if (file == NULL)
+    return false;
+  SeekRawFile(file, 0, SEEK_END);
+  const int64_t size = TellRawFile(file);
+  SeekRawFile(file, 0, SEEK_SET);
+  bool ok = size >= (int64_t)sizeof(header) && std::fread(&header, sizeof(header), 1, file) == 1 &&
+            CheckRawImageHeader(header, (uint64_t)size);
+  cv::Mat result;
+  if (ok)
+  {
+    // Rows and the domain are read sequentially so that only short relative seeks are needed
+    result.create(header.rows, header.cols, header.type);
+    const size_t row_bytes = result.cols * result.elemSize();
+    const int64_t pad_bytes = (int64_t)(header.step - row_bytes);
+    ok = SeekRawFile(file, (int64_t)(header.data_offset - sizeof(header)), SEEK_CUR);
+    for (int i = 0; i < result.rows && ok; i++)
+      ok = std::fread(result.ptr(i), 1, row_bytes, file) == row_bytes &&
+           SeekRawFile(file, pad_bytes, SEEK_CUR);
+  }
+  if (ok && header.domain_runs > 0)
+  {
+    const uint64_t data_end = header.data_offset + header.step * (uint64_t)header.rows;
+    runs.resize(header.domain_runs);
+    ok = header.domain_offset >= data_end &&
+         SeekRawFile(file, (int64_t)(header.domain_offset - data_end), SEEK_CUR) &&
+         std::fread(&runs[0], sizeof(RegionRun), runs.size(), file) == runs.size() &&
+         CheckRawImageRuns(runs, header);
+  }
+  std::fclose(file);
+  if (!ok)
+    return false;
+  image = result;
+  storage.reset();
+
+  if (domain)
+    *domain = header.domain_runs > 0 ? SRegion(runs)
+                                     : SRegion::GenRectangle1(0, 0, header.rows - 1,
+                                                              header.cols - 1);
+  return true;
+}
+
+///
+/// \brief    文件名是否以kRawImageExtension结尾
+///
+static bool IsRawImageFile(const std::string& file_name)
+{
+  const size_t n = std::strlen(kRawImageExtension);
+  return file_name.size() >= n &&
+         file_name.compare(file_name.size() - n, n, kRawImageExtension) == 0;
+}
+
+///
+/// \brief    小写扩展名，包含"."
+///
+static std::string ImageFileExtension(const std::string& file_name)
+{
+  const size_t dot = file_name.find_last_of('.');
+  const size_t slash = file_name.find_last_of("/\\");
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return std::string();
+  std::string extension = file_name.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension;
+}
+
+} // my_cv
@@ -22,7 +22,7 @@ namespace my_linear_algebra {
 /// \param    [in]  d Ƕֵ
 /// \return   ֵ
 ///
-double Deg2Rad(const double d)
+inline double Deg2Rad(const double d)
 {
   return d * CV_PI / 180;
 }
@@ -31,7 +31,7 @@ double Deg2Rad(const double d)
 /// \param    [in]  r ֵ
 /// \return   Ƕֵ
 ///
-double Rad2Deg(const double r)
+inline double Rad2Deg(const double r)
 {
   return r * 180 / CV_PI;
 }
@@ -43,7 +43,7 @@ double Rad2Deg(const double r)
 /// \param    [in]  psi xתĽǶ
 /// \return   3*3
 ///
-cv::Matx33d Angle2Rx(const double psi)
+inline cv::Matx33d Angle2Rx(const double psi)
 {
   double rad = Deg2Rad(psi);
   return cv::Matx33d(1, 0, 0,
@@ -58,7 +58,7 @@ cv::Matx33d Angle2Rx(const double psi)
 /// \param    [in]  phi yתĽǶ
 /// \return   3*3
 ///
-cv::Matx33d Angle2Ry(const double phi)
+inline cv::Matx33d Angle2Ry(const double phi)
 {
   double rad = Deg2Rad(phi);
   return cv::Matx33d(cos(rad), 0, -sin(rad),
@@ -73,7 +73,7 @@ cv::Matx33d Angle2Ry(const double phi)
 /// \param    [in]  theta zתĽǶ
 /// \return   3*3
 ///
-cv::Matx33d Angle2Rz(const double theta)
+inline cv::Matx33d Angle2Rz(const double theta)
 {
   double rad = Deg2Rad(theta);
   return cv::Matx33d(cos(rad), sin(rad), 0,
@@ -90,7 +90,7 @@ cv::Matx33d Angle2Rz(const double theta)
 /// \param    [in]  theta zתĽǶ
 /// \return   3*3
 ///
-cv::Matx33d Angles2R(const double psi, const double phi, const double theta)
+inline cv::Matx33d Angles2R(const double psi, const double phi, const double theta)
 {
   return Angle2Rx(psi) * Angle2Ry(phi) * Angle2Rz(theta);
 }
@@ -102,7 +102,7 @@ cv::Matx33d Angles2R(const double psi, const double phi, const double theta)
 /// \param    [in]  R 3*3ת
 /// \return   xyzתĽǶȣαһ
 ///
-cv::Vec3d R2Angles(const cv::Matx33d& R)
+inline cv::Vec3d R2Angles(const cv::Matx33d& R)
 {
   cv::Vec3d angles;
   angles[0] = atan2(R(1, 2), R(2, 2));
@@ -121,7 +121,7 @@ cv::Vec3d R2Angles(const cv::Matx33d& R)
 /// \param    [in]  R 3*3ת
 /// \return   ת
 ///
-cv::Vec3d R2Vr(const cv::Matx33d& R)
+inline cv::Vec3d R2Vr(const cv::Matx33d& R)
 {
   cv::Vec3d V;
   cv::Rodrigues(R, V);
@@ -135,7 +135,7 @@ cv::Vec3d R2Vr(const cv::Matx33d& R)
 /// \param    [in]  V ת
 /// \return   3*3ת
 ///
-cv::Matx33d Vr2R(const cv::Vec3d& V)
+inline cv::Matx33d Vr2R(const cv::Vec3d& V)
 {
   cv::Matx33d R;
   cv::Rodrigues(V, R);
@@ -151,7 +151,7 @@ cv::Matx33d Vr2R(const cv::Vec3d& V)
 /// \param    [in]  theta zתĽǶ
 /// \return   3*3ת
 ///
-cv::Vec3d Angles2Vr(const double psi, const double phi, const double theta)
+inline cv::Vec3d Angles2Vr(const double psi, const double phi, const double theta)
 {
   cv::Matx33d R = Angles2R(psi, phi, theta);
   return R2Vr(R);
@@ -164,7 +164,7 @@ cv::Vec3d Angles2Vr(const double psi, const double phi, const double theta)
 /// \param    [in]  V ת
 /// \return   xyzתĽǶȣαһ
 ///
-cv::Vec3d Vr2Angles(const cv::Vec3d& V)
+inline cv::Vec3d Vr2Angles(const cv::Vec3d& V)
 {
   cv::Matx33d R = Vr2R(V);
   return R2Angles(R);
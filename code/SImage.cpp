@@ -3,6 +3,34 @@
 #include <opencv2/opencv.hpp>
 #include <opencv2/imgproc/types_c.h>
 
+#include "AffineTransformation.h"
+#include "AsyncImageWriter.h"
+#include "AutoThreshold.h"
+#include "Camera.h"
+#include "CameraCalibration.h"
+#include "ChannelPlanes.h"
+#include "ColorClassLut.h"
+#include "ColorSpace.h"
+#include "Demosaic.h"
+#include "DerivedDataCache.h"
+#include "GaussPyramid.h"
+#include "GrayStatistics.h"
+#include "ImageExpression.h"
+#include "ImageSequence.h"
+#include "LineScan.h"
+#include "LocalThreshold.h"
+#include "LosslessCodec.h"
+#include "LutTransform.h"
+#include "PolarTransformation.h"
+#include "RawImageFile.h"
+#include "Serialization.h"
+#include "ShapeModel.h"
+#include "SharedFrameRing.h"
+#include "SheetOfLight.h"
+#include "SRegion.h"
+
+#include <memory>
+
 namespace cv {
 
 static void
@@ -37,11 +65,12 @@ thresh_8u2(const Mat& _src, Mat& _dst, uchar lowthresh, uchar highthresh, uchar
       {
         v_uint8x16 v0;
         v0 = v_load(src + j);
-        v0 = v0 >= lowthresh_u && v0 <= hithresh_u;
+        v0 = (v0 >= lowthresh_u) & (v0 <= highthresh_u);
         v0 = v0 & maxval16;
         v_store(dst + j, v0);
       }
     }
+  }
 #endif
 
   int j_scalar = j;
@@ -60,37 +89,19 @@ thresh_8u2(const Mat& _src, Mat& _dst, uchar lowthresh, uchar highthresh, uchar
     src = _src.ptr();
     dst = _dst.ptr();
     for (int i = 0; i < roi.height; i++, src += src_step, dst += dst_step)
-    {
-      j = j_scalar;
-#if CV_ENABLE_UNROLLED
-      for (; j <= roi.width - 4; j += 4)
-      {
-        uchar t0 = tab[src[j]];
-        uchar t1 = tab[src[j + 1]];
-
-        dst[j] = t0;
-        dst[j + 1] = t1;
-
-        t0 = tab[src[j + 2]];
-        t1 = tab[src[j + 3]];
-
-        dst[j + 2] = t0;
-        dst[j + 3] = t1;
-      }
-#endif
-      for (; j < roi.width; j++)
-        dst[j] = tab[src[j]];
-    }
+      my_cv::LutRow8u(src + j_scalar, dst + j_scalar, roi.width - j_scalar, tab);
   }
 }
 
 class ThresholdRunner2 : public ParallelLoopBody
 {
 public:
-  ThresholdRunner2(Mat _src, Mat _dst, double _lowthresh, double _highthresh, double _maxval)
+  ThresholdRunner2(Mat _src, Mat _dst, int _stripe_rows, double _lowthresh, double _highthresh,
+                   double _maxval)
   {
     src = _src;
     dst = _dst;
+    stripe_rows = _stripe_rows;
 
     lowthresh = _lowthresh;
     highthresh = _highthresh;
@@ -99,8 +110,8 @@ public:
 
   void operator () (const Range& range) const CV_OVERRIDE
   {
-    int row0 = range.start;
-    int row1 = range.end;
+    int row0 = range.start * stripe_rows;
+    int row1 = std::min(range.end * stripe_rows, src.rows);
 
     Mat srcStripe = src.rowRange(row0, row1);
     Mat dstStripe = dst.rowRange(row0, row1);
@@ -134,38 +145,69 @@ public:
 private:
   Mat src;
   Mat dst;
+  int stripe_rows;
 
   double lowthresh;
   double highthresh;
   double maxval;
 };
 
-void threshold2(const Mat& src, Mat& dst,
-                const double _lowthresh, const double _highthresh,
-                const double _maxval)
+// First phase of the automatic modes, runs over the same stripes as ThresholdRunner2
+class ThreshHistRunner2 : public ParallelLoopBody
+{
+public:
+  ThreshHistRunner2(const Mat& _src, int _stripe_rows, std::vector<int64_t>& _partial)
+    : src(_src), stripe_rows(_stripe_rows), partial(_partial)
+  { }
+
+  void operator () (const Range& range) const CV_OVERRIDE
+  {
+    std::vector<uint32_t> sub(4 * my_cv::kGrayLevels);
+    for (int s = range.start; s < range.end; s++)
+    {
+      std::fill(sub.begin(), sub.end(), 0u);
+      const int row1 = std::min((s + 1) * stripe_rows, src.rows);
+      for (int i = s * stripe_rows; i < row1; i++)
+        my_cv::CountGrayLevels(src.ptr<uchar>(i), src.cols, &sub[0]);
+      my_cv::MergeGrayLevels(&sub[0], &partial[(size_t)s * my_cv::kGrayLevels]);
+    }
+  }
+
+private:
+  Mat src;
+  int stripe_rows;
+  std::vector<int64_t>& partial;
+};
+
+///
+/// \brief    带阈值，[lowthresh, highthresh]内的像素置为maxval，其余置0
+///
+/// type可附加THRESH_OTSU或THRESH_TRIANGLE，此时只用带内像素的直方图自动求阈值t：
+/// THRESH_BINARY保留带内亮的一类[t + 1, highthresh]，THRESH_BINARY_INV保留暗的一类
+/// [lowthresh, t]。非自动模式只支持THRESH_BINARY。直方图与阈值两遍使用相同的行条带，
+/// 图像能放进L2时第二遍命中缓存
+///
+/// \return   实际使用的阈值，非自动模式时返回lowthresh
+///
+double threshold2(const Mat& src, Mat& dst,
+                  const double _lowthresh, const double _highthresh,
+                  const double _maxval, int type = THRESH_BINARY)
 {
   //CV_INSTRUMENT_REGION();
 
   //CV_OCL_RUN_(_src.dims() <= 2 && _dst.isUMat(),
   //            ocl_threshold(_src, _dst, thresh, maxval, type), thresh)
 
-  //Mat src = _src.getMat();
-  //int automatic_thresh = (type & ~CV_THRESH_MASK);
-  //type &= THRESH_MASK;
+  int automatic_thresh = (type & ~THRESH_MASK);
+  type &= THRESH_MASK;
 
-  //CV_Assert(automatic_thresh != (CV_THRESH_OTSU | CV_THRESH_TRIANGLE));
-  //if (automatic_thresh == CV_THRESH_OTSU)
-  //{
-  //  CV_Assert(src.type() == CV_8UC1);
-  //  thresh = getThreshVal_Otsu_8u(src);
-  //}
-  //else if (automatic_thresh == CV_THRESH_TRIANGLE)
-  //{
-  //  CV_Assert(src.type() == CV_8UC1);
-  //  thresh = getThreshVal_Triangle_8u(src);
-  //}
+  CV_Assert(automatic_thresh != (THRESH_OTSU | THRESH_TRIANGLE));
+  // THRESH_BINARY_INV only chooses the class of the automatic modes, a plain band is not inverted
+  CV_Assert(type == THRESH_BINARY || (type == THRESH_BINARY_INV && automatic_thresh != 0));
 
   dst.create(src.size(), src.type());
+  const int stripe_rows = std::max(1, (1 << 16) / std::max(src.cols * src.channels(), 1));
+  const int nstripes = (src.rows + stripe_rows - 1) / stripe_rows;
   //Mat dst = _dst.getMat();
   double lowthresh = _lowthresh;
   double highthresh = _highthresh;
@@ -203,6 +245,31 @@ void threshold2(const Mat& src, Mat& dst,
     //thresh = ithresh;
     maxval = imaxval;
   }
+
+  double thresh = lowthresh;
+  if (automatic_thresh != 0)
+  {
+    CV_Assert(src.type() == CV_8UC1);
+    const int lo = std::max(cvFloor(lowthresh), 0);
+    const int hi = std::min(cvFloor(highthresh), 255);
+
+    std::vector<int64_t> partial((size_t)nstripes * my_cv::kGrayLevels, 0);
+    parallel_for_(Range(0, nstripes), ThreshHistRunner2(src, stripe_rows, partial), nstripes);
+    std::vector<int64_t> histogram(my_cv::kGrayLevels, 0);
+    for (int s = 0; s < nstripes; s++)
+      for (int g = 0; g < my_cv::kGrayLevels; g++)
+        histogram[g] += partial[(size_t)s * my_cv::kGrayLevels + g];
+
+    if (lo <= hi)
+    {
+      thresh = automatic_thresh == THRESH_OTSU ? my_cv::OtsuThreshold(&histogram[0], lo, hi)
+                                               : my_cv::TriangleThreshold(&histogram[0], lo, hi);
+      if (type == THRESH_BINARY)
+        lowthresh = thresh + 1;
+      else
+        highthresh = thresh;
+    }
+  }
   //else if (src.depth() == CV_16S)
   //{
   //  int ithresh = cvFloor(thresh);
@@ -265,10 +332,15 @@ void threshold2(const Mat& src, Mat& dst,
   //else
   //  CV_Error(CV_StsUnsupportedFormat, "");
 
-  parallel_for_(Range(0, dst.rows),
-                ThresholdRunner2(src, dst, lowthresh, highthresh, maxval),
-                dst.total() / (double)(1 << 16));
-  //return thresh;
+  if (lowthresh > highthresh)
+  {
+    dst.setTo(0);
+    return thresh;
+  }
+  parallel_for_(Range(0, nstripes),
+                ThresholdRunner2(src, dst, stripe_rows, lowthresh, highthresh, maxval),
+                nstripes);
+  return thresh;
 }
 
 } // cv
@@ -279,21 +351,243 @@ class SImage
 {
 public:
   SImage()
+    : cache_(std::make_shared<DerivedDataCache>())
   { }
 
   SImage(const cv::Mat& img)
+    : cache_(std::make_shared<DerivedDataCache>())
   {
     image_ = img.clone();
   }
 
+  ///
+  /// \brief    求值AddImage、SubImage、MultImage、AbsDiffImage、ScaleImage组成的表达式
+  ///
+  template <typename E>
+  SImage(const ImageExpr<E>& expr)
+    : cache_(std::make_shared<DerivedDataCache>())
+  {
+    EvaluateImageExpr(expr, image_);
+  }
+
+  ///
+  /// \brief    读取图像，扩展名为.simg时映射原生图像文件而不复制像素，.simz为无损压缩文件
+  ///
   bool Read(const std::string& file_name)
   {
-    image_ = cv::imread(file_name, cv::IMREAD_UNCHANGED);
+    if (IsRawImageFile(file_name))
+      return ReadRaw(file_name, NULL, true);
+    cv::Mat image;
+    if (IsLosslessImageFile(file_name))
+      ReadLosslessImage(file_name, image);
+    else
+      image = cv::imread(file_name, cv::IMREAD_UNCHANGED);
+    image_ = image;
+    storage_.reset();
+    cache_ = std::make_shared<DerivedDataCache>();
     return image_.data != nullptr;
   }
 
+  ///
+  /// \brief    取相机已采集的下一帧，图像引用采集缓冲，释放后缓冲回到相机
+  /// \param    [in]  MaxDelay     等待毫秒数，负数表示一直等待
+  /// \param    [out] FrameNumber  非NULL时输出帧号
+  ///
+  bool GrabImageAsync(Camera& AcqHandle, const int MaxDelay, uint64_t* FrameNumber)
+  {
+    CameraFrame frame;
+    if (!AcqHandle.GrabImageAsync(frame, MaxDelay))
+      return false;
+    if (FrameNumber)
+      *FrameNumber = frame.frame_number;
+    image_ = frame.image;
+    storage_ = frame.storage;
+    cache_ = std::make_shared<DerivedDataCache>();
+    return true;
+  }
+
+  ///
+  /// \brief    从预读序列中取下一帧，图像引用序列的解码缓冲
+  /// \param    [out] Index  非NULL时输出该帧在序列中的序号
+  /// \return   序列结束或该帧读取失败时返回false，可用Index区分
+  ///
+  bool ReadSequence(ImageSequenceReader& Reader, size_t* Index)
+  {
+    SequenceFrame frame;
+    if (!Reader.Next(frame))
+      return false;
+    if (Index)
+      *Index = frame.index;
+    image_ = frame.image;
+    storage_ = frame.storage;
+    cache_ = std::make_shared<DerivedDataCache>();
+    return frame.ok;
+  }
+
+  ///
+  /// \brief    读取原生图像文件
+  /// \param    [out] Domain  非NULL时输出保存的定义域
+  /// \param    [in]  Map     为true时图像直接引用文件映射，映射在图像及其副本使用期间保持
+  ///
+  bool ReadRaw(const std::string& file_name, SRegion* Domain, const bool Map)
+  {
+    cv::Mat image;
+    std::shared_ptr<const void> storage;
+    if (!ReadRawImage(file_name, image, storage, Domain, Map))
+      return false;
+    image_ = image;
+    storage_ = storage;
+    cache_ = std::make_shared<DerivedDataCache>();
+    return true;
+  }
+
+  ///
+  /// \brief    写原生图像文件，行按64字节对齐，Domain非NULL时一并保存
+  ///
+  bool WriteRaw(const std::string& file_name, const SRegion* Domain) const
+  {
+    return WriteRawImage(file_name, image_, Domain);
+  }
+
+  ///
+  /// \brief    设置派生数据（积分图、直方图、金字塔、梯度）缓存的字节数上限
+  ///
+  void SetCacheLimit(const size_t MaxBytes) const
+  {
+    cache_->SetLimit(MaxBytes);
+  }
+
+  ///
+  /// \brief    图像数据被原地修改后使派生数据失效
+  ///
+  void InvalidateCache() const
+  {
+    cache_->Invalidate();
+  }
+
+  ///
+  /// \brief    序列化为连续的二进制缓冲区，像素行按64字节对齐
+  ///
+  SerializedItem SerializeImage() const
+  {
+    return SerializeRawImage(image_);
+  }
+
+  ///
+  /// \brief    由序列化缓冲区恢复图像，像素直接引用缓冲区，缓冲区应视为只读
+  ///
+  void DeserializeImage(const SerializedItem& SerializedItemHandle)
+  {
+    image_ = DeserializeRawImage(SerializedItemHandle);
+    storage_ = SerializedItemHandle.Owner();
+    cache_ = std::make_shared<DerivedDataCache>();
+  }
+
+  ///
+  /// \brief    引用共享内存环形缓冲中序号为Sequence的帧，不复制像素
+  ///
+  /// 图像及其副本使用期间该帧不会被生产者覆盖，应在处理完后尽快释放；可用
+  /// ImageConvertion::toQImage(mat, false)直接显示
+  ///
+  /// \param    [in]  Sequence  帧序号，0表示最新一帧
+  /// \return   该帧已被覆盖或不存在时返回false
+  ///
+  bool AcquireFrame(const SharedFrameRing& Ring, const uint64_t Sequence)
+  {
+    cv::Mat image;
+    std::shared_ptr<const void> pin;
+    if (!Ring.Acquire(Sequence != 0 ? Sequence : Ring.LatestSequence(), image, pin))
+      return false;
+    image_ = image;
+    storage_ = pin;
+    cache_ = std::make_shared<DerivedDataCache>();
+    return true;
+  }
+
+  ///
+  /// \brief    引用外部像素而不复制
+  /// \param    [in]  Storage  像素内存的所有者，在图像及其副本使用期间保持；
+  ///                           Image自己持有内存时可为空
+  ///
+  void GenImageExtern(const cv::Mat& Image, const std::shared_ptr<const void>& Storage)
+  {
+    image_ = Image;
+    storage_ = Storage;
+    cache_ = std::make_shared<DerivedDataCache>();
+  }
+
+  ///
+  /// \brief    引用LineScanBuffer最近提交的窗口，即条带及其之前的重叠行，不复制像素
+  ///
+  /// 邻域算子在窗口上计算，再按算子的半径取本次应输出的行，例如：
+  ///
+  ///   buffer.Push(strip);  // 或相机采集到buffer.NextStrip()后Commit
+  ///   window.AccessStripWindow(buffer);
+  ///   const cv::Range rows = buffer.OutputRows(7);
+  ///   const int row0 = (int)buffer.WindowRow();
+  ///   blobs = connection.Push(StripRegion(window.DynThreshold(15, 15, 5, "light"), buffer, 7),
+  ///                           row0 + rows.start, row0 + rows.end);
+  ///   edges = window.SobelAmp("sum_abs").CropStripOutput(buffer, 1);
+  ///
+  /// 卷材结束时调用buffer.Finish()，对最后一个窗口再取一次输出行，然后connection.Flush()
+  ///
+  void AccessStripWindow(const LineScanBuffer& Buffer)
+  {
+    GenImageExtern(Buffer.Window(), Buffer.Owner());
+  }
+
+  ///
+  /// \brief    引用LineScanBuffer最近提交的条带，不复制像素
+  ///
+  /// 同一缓冲块中连续的条带可由TileImagesOffset拼接为视图
+  ///
+  void AccessStrip(const LineScanBuffer& Buffer)
+  {
+    GenImageExtern(Buffer.Strip(), Buffer.Owner());
+  }
+
+  ///
+  /// \brief    在LineScanBuffer窗口上计算的结果中取本次应输出的行，结果为视图
+  /// \param    [in]  Radius  算子的半高
+  ///
+  SImage CropStripOutput(const LineScanBuffer& Buffer, const int Radius) const
+  {
+    CV_Assert(image_.rows == Buffer.Window().rows);
+    const cv::Range rows = Buffer.OutputRows(Radius);
+    SImage dst;
+    if (rows.start < rows.end)
+      dst.image_ = image_.rowRange(rows.start, rows.end);
+    dst.storage_ = storage_;
+    return dst;
+  }
+
+  ///
+  /// \brief    复制图像到共享内存环形缓冲并发布
+  /// \return   帧序号，所有槽都被消费者占用时丢弃该帧并返回0
+  ///
+  uint64_t PublishFrame(SharedFrameRing& Ring) const
+  {
+    return Ring.Publish(image_);
+  }
+
+  ///
+  /// \brief    提交到异步写入器后立即返回，不复制像素，提交后不应再原地修改图像
+  /// \return   队列满被丢弃或写入器已关闭时返回false
+  ///
+  bool WriteAsync(AsyncImageWriter& Writer, const std::string& file_name) const
+  {
+    return Writer.Submit(file_name, image_, storage_);
+  }
+
+  ///
+  /// \brief    写图像，.simg为原生图像文件，.simz为分带并行的无损压缩文件
+  ///
   bool Write(const std::string& file_name)
   {
+    if (IsRawImageFile(file_name))
+      return WriteRaw(file_name, NULL);
+    if (IsLosslessImageFile(file_name))
+      return WriteLosslessImage(file_name, image_);
     return cv::imwrite(file_name, image_);
   }
 
@@ -304,8 +598,748 @@ public:
     return SImage(dst);
   }
 
+  ///
+  /// \brief    自动阈值分割暗的部分（最大类间方差）
+  ///
+  SImage BinThreshold() const
+  {
+    return BinaryThreshold("max_separability", "dark", NULL);
+  }
+
+  ///
+  /// \brief    自动阈值分割
+  /// \param    [in]  Method         "max_separability"（Otsu）或"triangle"
+  /// \param    [in]  LightDark      "light"保留亮的一类，"dark"保留暗的一类
+  /// \param    [out] UsedThreshold  亮类为灰度>=UsedThreshold，暗类为灰度<=UsedThreshold
+  ///
+  SImage BinaryThreshold(const std::string& Method, const std::string& LightDark,
+                         int* UsedThreshold) const
+  {
+    int type = 0;
+    if (Method == "max_separability")
+      type = cv::THRESH_OTSU;
+    else if (Method == "triangle")
+      type = cv::THRESH_TRIANGLE;
+    else
+      CV_Error(cv::Error::StsBadArg, "Unsupported method: " + Method);
+
+    if (LightDark == "light")
+      type |= cv::THRESH_BINARY;
+    else if (LightDark == "dark")
+      type |= cv::THRESH_BINARY_INV;
+    else
+      CV_Error(cv::Error::StsBadArg, "LightDark must be light or dark");
+
+    SImage dst;
+    const int t = cvRound(cv::threshold2(image_, dst.image_, 0, 255, 255, type));
+    if (UsedThreshold)
+      *UsedThreshold = LightDark == "light" ? t + 1 : t;
+    return dst;
+  }
+
+  ///
+  /// \brief    在平滑后直方图的各极小值处分割，返回从暗到亮的区域组
+  /// \param    [in]  Sigma  直方图平滑的高斯标准差
+  ///
+  std::vector<SRegion> AutoThreshold(const double Sigma) const
+  {
+    CV_Assert(Sigma >= 0);
+    const GrayStatistics stats = Statistics();
+    const std::vector<int> minima = HistogramMinima(&stats.histogram[0], Sigma);
+
+    std::vector<int> lut(kGrayLevels);
+    int c = 0;
+    for (int g = 0; g < kGrayLevels; g++)
+    {
+      lut[g] = c;
+      if (c < (int)minima.size() && g == minima[c])
+        c++;
+    }
+    return GrayClassRegions(image_, lut, (int)minima.size() + 1);
+  }
+
+  ///
+  /// \brief    查找表变换
+  ///
+  /// 8位图像的查找表为256项，值都不超过255时输出8位图像，否则输出16位图像；
+  /// 16位图像的查找表为65536项，输出16位图像
+  ///
+  SImage LutTrans(const std::vector<int>& Lut) const
+  {
+    CV_Assert(!Lut.empty());
+    const int max_value = *std::max_element(Lut.begin(), Lut.end());
+    cv::Mat lut(1, (int)Lut.size(), CV_32S, (void*)&Lut[0]);
+    cv::Mat table;
+    lut.convertTo(table, max_value > UCHAR_MAX || image_.depth() == CV_16U ? CV_16U : CV_8U);
+
+    SImage dst;
+    LutTransform(image_, dst.image_, table);
+    return dst;
+  }
+
+  ///
+  /// \brief    Bayer原始图像插值为BGR三通道图像
+  /// \param    [in]  CFAType        "bayer_rg"、"bayer_gr"、"bayer_gb"或"bayer_bg"
+  /// \param    [in]  Interpolation  "bilinear"或"bilinear_dir"（沿边缘方向插值）
+  ///
+  SImage CfaToRgb(const std::string& CFAType, const std::string& Interpolation) const
+  {
+    SImage dst;
+    DemosaicBayer(image_, dst.image_, CFAType, Interpolation, kBayerBgr);
+    return dst;
+  }
+
+  ///
+  /// \brief    Bayer原始图像直接插值为灰度或单一通道，不生成三通道中间图像
+  /// \param    [in]  Channel  "gray"、"red"、"green"或"blue"
+  ///
+  SImage CfaToChannel(const std::string& CFAType, const std::string& Interpolation,
+                      const std::string& Channel) const
+  {
+    SImage dst;
+    DemosaicBayer(image_, dst.image_, CFAType, Interpolation, ParseBayerChannel(Channel));
+    return dst;
+  }
+
+  int CountChannels() const
+  {
+    return image_.channels();
+  }
+
+  ///
+  /// \brief    取出一个通道，通道顺序与内存中相同（彩色图像为B、G、R）
+  /// \param    [in]  Channel  通道序号，从1开始
+  ///
+  /// 第一次访问时把整幅图像解交错为平面存储，之后各通道都是其中的视图，不再复制
+  ///
+  SImage AccessChannel(const int Channel) const
+  {
+    if (Channel < 1 || Channel > image_.channels())
+      CV_Error(cv::Error::StsOutOfRange, "Channel index out of range");
+    if (image_.channels() == 1)
+      return *this;
+
+    SImage dst;
+    dst.image_ = CachedPlanes()->planes[Channel - 1];
+    return dst;
+  }
+
+  ///
+  /// \brief    多通道图像转为单通道图像组，各图像为平面存储的视图
+  ///
+  std::vector<SImage> ImageToChannels() const
+  {
+    std::vector<SImage> channels(image_.channels());
+    for (int k = 0; k < image_.channels(); k++)
+      channels[k] = AccessChannel(k + 1);
+    return channels;
+  }
+
+  ///
+  /// \brief    单通道图像组合成多通道图像，各图像的副本同时作为结果的平面存储
+  ///
+  static SImage ChannelsToImage(const std::vector<SImage>& Images)
+  {
+    std::vector<cv::Mat> planes(Images.size());
+    for (size_t k = 0; k < Images.size(); k++)
+      planes[k] = Images[k].image_;
+    return FromPlanes(planes);
+  }
+
+  ///
+  /// \brief    按偏移拼接图像，未覆盖的部分为0
+  ///
+  /// 输入是同一缓冲中相邻的部分（如AccessStrip取得的连续条带）并恰好铺满结果时，
+  /// 结果直接引用该缓冲
+  ///
+  static SImage TileImagesOffset(const std::vector<SImage>& Images,
+                                 const std::vector<int>& OffsetRow,
+                                 const std::vector<int>& OffsetCol, const int Width,
+                                 const int Height)
+  {
+    std::vector<cv::Mat> images(Images.size());
+    for (size_t k = 0; k < Images.size(); k++)
+      images[k] = Images[k].image_;
+    SImage dst;
+    dst.image_ = my_cv::TileImagesOffset(images, OffsetRow, OffsetCol, Width, Height);
+    if (dst.image_.datastart == images[0].datastart)
+      dst.storage_ = Images[0].storage_;
+    return dst;
+  }
+
+  ///
+  /// \brief    按NumColumns列拼接尺寸相同的图像
+  /// \param    [in]  TileOrder  "horizontal"或"vertical"
+  ///
+  static SImage TileImages(const std::vector<SImage>& Images, const int NumColumns,
+                           const std::string& TileOrder)
+  {
+    std::vector<cv::Mat> images(Images.size());
+    for (size_t k = 0; k < Images.size(); k++)
+      images[k] = Images[k].image_;
+    SImage dst;
+    dst.image_ = my_cv::TileImages(images, NumColumns, TileOrder);
+    if (!images.empty() && dst.image_.datastart == images[0].datastart)
+      dst.storage_ = Images[0].storage_;
+    return dst;
+  }
+
+  SImage Decompose3(SImage* Image2, SImage* Image3) const
+  {
+    CV_Assert(image_.channels() == 3);
+    if (Image2)
+      *Image2 = AccessChannel(2);
+    if (Image3)
+      *Image3 = AccessChannel(3);
+    return AccessChannel(1);
+  }
+
+  SImage Compose3(const SImage& Image2, const SImage& Image3) const
+  {
+    std::vector<cv::Mat> planes(3);
+    planes[0] = image_;
+    planes[1] = Image2.image_;
+    planes[2] = Image3.image_;
+    return FromPlanes(planes);
+  }
+
+  ///
+  /// \brief    BGR图像变换到其他颜色空间
+  /// \param    [in]  ColorSpace  "hsv"、"hsi"或"cielab"，结果通道依次为H、S、V/I或L、a、b
+  ///
+  SImage TransFromRgb(const std::string& ColorSpace) const
+  {
+    SImage dst;
+    TransFromBgr(image_, dst.image_, ParseColorSpace(ColorSpace));
+    return dst;
+  }
+
+  ///
+  /// \brief    TransFromRgb的逆变换，结果为BGR图像
+  ///
+  SImage TransToRgb(const std::string& ColorSpace) const
+  {
+    SImage dst;
+    TransToBgr(image_, dst.image_, ParseColorSpace(ColorSpace));
+    return dst;
+  }
+
+  ///
+  /// \brief    选出变换到ColorSpace后各通道都在[Min, Max]内的像素，不生成变换后的图像
+  /// \param    [in]  ColorSpace  "hsv"或"hsi"
+  /// \param    [in]  Min         三个通道的下限
+  /// \param    [in]  Max         三个通道的上限，色调下限大于上限时为跨过0的区间
+  ///
+  SRegion ColorThreshold(const std::string& ColorSpace, const std::vector<double>& Min,
+                         const std::vector<double>& Max) const
+  {
+    SRegion region;
+    my_cv::ColorThreshold(image_, ParseColorSpace(ColorSpace), Min, Max, NULL, &region);
+    return region;
+  }
+
+  ///
+  /// \brief    添加颜色分类的训练样本，ClassRegions的第c个区域内的像素属于类别c
+  ///
+  void AddSamplesImageClass(const std::vector<SRegion>& ClassRegions,
+                            ColorClassSamples& Samples) const
+  {
+    Samples.Add(image_, ClassRegions);
+  }
+
+  ///
+  /// \brief    用ColorClassSamples::CreateClassLut编译的查找表分类BGR图像
+  /// \return   每个类别一个区域，拒识的像素不属于任何区域
+  ///
+  std::vector<SRegion> ClassifyImageClassLut(const ClassLut& ClassLUTHandle) const
+  {
+    return ClassifyClassLut(image_, ClassLUTHandle);
+  }
+
+  ///
+  /// \brief    与阈值图像逐像素比较
+  /// \param    [in]  ThresholdImage  阈值图像，通常为平滑后的原图
+  /// \param    [in]  Offset          偏移量
+  /// \param    [in]  LightDark       "light"、"dark"、"equal"或"not_equal"
+  ///
+  SRegion DynThreshold(const SImage& ThresholdImage, const double Offset,
+                       const std::string& LightDark) const
+  {
+    CV_Assert(image_.type() == CV_8UC1 && ThresholdImage.image_.type() == CV_8UC1);
+    CV_Assert(image_.size() == ThresholdImage.image_.size());
+
+    SRegion region;
+    RunLocalThreshold(image_.size(),
+                      DynThresholdRow(image_, ThresholdImage.image_, ParseLightDark(LightDark),
+                                      (float)Offset),
+                      NULL, &region);
+    return region;
+  }
+
+  ///
+  /// \brief    与MaskWidth * MaskHeight窗口均值比较，代替均值滤波后再DynThreshold
+  ///
+  SRegion DynThreshold(const int MaskWidth, const int MaskHeight, const double Offset,
+                       const std::string& LightDark) const
+  {
+    const OffsetRule rule = { ParseLightDark(LightDark), (float)Offset };
+    return WindowThresholdCached(MaskWidth, MaskHeight, rule, false);
+  }
+
+  ///
+  /// \brief    Niblack局部阈值，阈值为均值加减max(StdDevScale * 标准差, AbsThreshold)
+  ///
+  SRegion VarThreshold(const int MaskWidth, const int MaskHeight, const double StdDevScale,
+                       const double AbsThreshold, const std::string& LightDark) const
+  {
+    const VarianceRule rule = { ParseLightDark(LightDark), (float)StdDevScale,
+                                (float)AbsThreshold };
+    return WindowThresholdCached(MaskWidth, MaskHeight, rule, true);
+  }
+
+  ///
+  /// \brief    Sauvola局部阈值，阈值为均值 * (1 + Scale * (标准差 / Range - 1))
+  /// \param    [in]  Method     仅支持"adapted_std_deviation"
+  /// \param    [in]  LightDark  "light"或"dark"
+  /// \param    [in]  MaskSize   窗口边长
+  /// \param    [in]  Scale      标准差的权重，常用0.2
+  /// \param    [in]  Range      标准差的动态范围，常用128
+  ///
+  SRegion LocalThreshold(const std::string& Method, const std::string& LightDark,
+                         const int MaskSize, const double Scale, const double Range) const
+  {
+    if (Method != "adapted_std_deviation")
+      CV_Error(cv::Error::StsBadArg, "Unsupported method: " + Method);
+    const LightDarkMode mode = ParseLightDark(LightDark);
+    if (mode != kLight && mode != kDark)
+      CV_Error(cv::Error::StsBadArg, "LightDark must be light or dark");
+    if (Range <= 0)
+      CV_Error(cv::Error::StsBadArg, "Range must be positive");
+
+    const SauvolaRule rule = { mode, (float)Scale, (float)Range };
+    return WindowThresholdCached(MaskSize, MaskSize, rule, true);
+  }
+
+  ShapeModel CreateShapeModel(const int NumLevels, const double AngleStart,
+                              const double AngleExtent, const double AngleStep,
+                              const std::string& Optimization, const std::string& Metric,
+                              const int Contrast, const int MinContrast) const
+  {
+    return CreateScaledShapeModel(NumLevels, AngleStart, AngleExtent, AngleStep,
+                                  1.0, 1.0, 1.0, Optimization, Metric,
+                                  Contrast, MinContrast);
+  }
+
+  ShapeModel CreateScaledShapeModel(const int NumLevels, const double AngleStart,
+                                    const double AngleExtent, const double AngleStep,
+                                    const double ScaleMin, const double ScaleMax,
+                                    const double ScaleStep,
+                                    const std::string& Optimization, const std::string& Metric,
+                                    const int Contrast, const int MinContrast) const
+  {
+    ShapeModel model;
+    model.Create(image_, cv::Mat(), NumLevels, AngleStart, AngleExtent, AngleStep,
+                 ScaleMin, ScaleMax, ScaleStep, Optimization, Metric, Contrast, MinContrast);
+    return model;
+  }
+
+  std::vector<ShapeMatch> FindShapeModel(const ShapeModel& ModelID, const double AngleStart,
+                                         const double AngleExtent, const double MinScore,
+                                         const int NumMatches, const double MaxOverlap,
+                                         const std::string& SubPixel, const int NumLevels,
+                                         const double Greediness) const
+  {
+    return ModelID.Find(CachedGaussPyramid("weighted")->Levels(), AngleStart, AngleExtent,
+                        1.0, 1.0, MinScore, NumMatches, MaxOverlap, SubPixel, NumLevels,
+                        Greediness);
+  }
+
+  std::vector<ShapeMatch> FindScaledShapeModel(const ShapeModel& ModelID, const double AngleStart,
+                                               const double AngleExtent, const double ScaleMin,
+                                               const double ScaleMax, const double MinScore,
+                                               const int NumMatches, const double MaxOverlap,
+                                               const std::string& SubPixel, const int NumLevels,
+                                               const double Greediness) const
+  {
+    return ModelID.Find(CachedGaussPyramid("weighted")->Levels(), AngleStart, AngleExtent,
+                        ScaleMin, ScaleMax, MinScore, NumMatches, MaxOverlap, SubPixel,
+                        NumLevels, Greediness);
+  }
+
+  std::vector<SImage> GenGaussPyramid(const std::string& Mode, const double Scale) const
+  {
+    if (Scale != 0.5)
+      CV_Error(cv::Error::StsBadArg, "GenGaussPyramid only supports Scale 0.5");
+
+    std::shared_ptr<const GaussPyramid> pyramid = CachedGaussPyramid(Mode);
+    std::vector<SImage> levels(pyramid->NumLevels());
+    for (int l = 0; l < pyramid->NumLevels(); l++)
+      levels[l].image_ = pyramid->Level(l);
+    // Level 0 is this image itself, it has to pin the same external memory
+    levels[0].storage_ = storage_;
+    return levels;
+  }
+
+  SImage AffineTransImage(const HomMat2D& HomMat, const std::string& Interpolation,
+                          const std::string& AdaptImageSize) const
+  {
+    int width = image_.cols;
+    int height = image_.rows;
+    if (AdaptImageSize == "true")
+    {
+      // Enlarge to the right and bottom so that the transformed image is not clipped
+      const cv::Point2d corners[4] = { cv::Point2d(0, 0), cv::Point2d(image_.cols - 1, 0),
+                                       cv::Point2d(0, image_.rows - 1),
+                                       cv::Point2d(image_.cols - 1, image_.rows - 1) };
+      for (int k = 0; k < 4; k++)
+      {
+        const cv::Point2d p = HomMat.AffineTransPoint(corners[k]);
+        width = std::max(width, cvCeil(p.x) + 1);
+        height = std::max(height, cvCeil(p.y) + 1);
+      }
+    }
+    return AffineTransImageSize(HomMat, Interpolation, width, height);
+  }
+
+  SImage AffineTransImageSize(const HomMat2D& HomMat, const std::string& Interpolation,
+                              const int Width, const int Height) const
+  {
+    CV_Assert(Width > 0 && Height > 0);
+    const bool bilinear = IsBilinearInterpolation(Interpolation);
+    std::shared_ptr<const FixedPointMap> map =
+      CachedAffineMap(HomMat, image_.size(), cv::Size(Width, Height));
+
+    SImage dst;
+    RemapFixedPoint(image_, dst.image_, *map, bilinear);
+    return dst;
+  }
+
+  ///
+  /// \brief    绕图像中心逆时针旋转Phi度，旋转90度或270度时交换宽高
+  ///
+  SImage RotateImage(const double Phi, const std::string& Interpolation) const
+  {
+    const double phi = std::fmod(std::fmod(Phi, 360.0) + 360.0, 360.0);
+    const bool swap = phi == 90.0 || phi == 270.0;
+    const int width = swap ? image_.rows : image_.cols;
+    const int height = swap ? image_.cols : image_.rows;
+
+    const HomMat2D HomMat = HomMat2D()
+      .Translate(-(image_.cols - 1) * 0.5, -(image_.rows - 1) * 0.5)
+      .Rotate(my_linear_algebra::Deg2Rad(phi), 0, 0)
+      .Translate((width - 1) * 0.5, (height - 1) * 0.5);
+    return AffineTransImageSize(HomMat, Interpolation, width, height);
+  }
+
+  ///
+  /// \brief    按映射表变换图像，映射表由GenRadialDistortionMap、GenImageToWorldPlaneMap
+  ///           或ConvertMapType生成，可在多帧之间复用
+  ///
+  SImage MapImage(const FixedPointMap& Map) const
+  {
+    SImage dst;
+    my_cv::MapImage(image_, dst.image_, Map);
+    return dst;
+  }
+
+  ///
+  /// \brief    改变图像的畸变与内参，结果如同用CamParamOut拍摄
+  ///
+  /// 每次调用都重新生成映射表，处理图像序列时应先调用GenRadialDistortionMap，再逐帧MapImage
+  ///
+  SImage ChangeRadialDistortionImage(const CameraParam& CamParamIn,
+                                     const CameraParam& CamParamOut) const
+  {
+    CV_Assert(image_.size() == CamParamIn.ImageSize());
+    return MapImage(GenRadialDistortionMap(CamParamIn, CamParamOut, "bilinear"));
+  }
+
+  ///
+  /// \brief    以(Row, Column)为圆心展开整圆，宽Width对应[0, 2π)，高Height对应半径[0, Height - 1]
+  ///
+  SImage PolarTransImage(const double Row, const double Column, const int Width,
+                         const int Height) const
+  {
+    CV_Assert(Width > 0 && Height > 0);
+    return PolarTransImageExt(Row, Column, 0, 2 * CV_PI * (Width - 1) / Width, 0, Height - 1,
+                              Width, Height, "bilinear");
+  }
+
+  ///
+  /// \brief    将圆环区域展开为矩形图像，列对应角度，行对应半径
+  /// \param    [in]  Row          圆心行坐标
+  /// \param    [in]  Column       圆心列坐标
+  /// \param    [in]  AngleStart   第一列的角度（弧度）
+  /// \param    [in]  AngleEnd     最后一列的角度（弧度）
+  /// \param    [in]  RadiusStart  第一行的半径
+  /// \param    [in]  RadiusEnd    最后一行的半径
+  /// \param    [in]  Width        展开图像宽
+  /// \param    [in]  Height       展开图像高
+  /// \param    [in]  Interpolation  "nearest_neighbor"或"bilinear"
+  ///
+  SImage PolarTransImageExt(const double Row, const double Column, const double AngleStart,
+                            const double AngleEnd, const double RadiusStart,
+                            const double RadiusEnd, const int Width, const int Height,
+                            const std::string& Interpolation) const
+  {
+    CV_Assert(Width > 0 && Height > 0);
+    const bool bilinear = IsBilinearInterpolation(Interpolation);
+    const PolarGeometry geometry = { Row, Column, AngleStart, AngleEnd, RadiusStart, RadiusEnd,
+                                     cv::Size(Width, Height), image_.size() };
+    std::shared_ptr<const FixedPointMap> map = CachedPolarMap(geometry, false);
+
+    SImage dst;
+    RemapFixedPoint(image_, dst.image_, *map, bilinear);
+    return dst;
+  }
+
+  ///
+  /// \brief    PolarTransImageExt的逆变换，当前图像为展开图像，参数与展开时相同
+  /// \param    [in]  Width   直角坐标图像宽
+  /// \param    [in]  Height  直角坐标图像高
+  ///
+  SImage PolarTransImageInv(const double Row, const double Column, const double AngleStart,
+                            const double AngleEnd, const double RadiusStart,
+                            const double RadiusEnd, const int Width, const int Height,
+                            const std::string& Interpolation) const
+  {
+    CV_Assert(Width > 0 && Height > 0);
+    const bool bilinear = IsBilinearInterpolation(Interpolation);
+    const PolarGeometry geometry = { Row, Column, AngleStart, AngleEnd, RadiusStart, RadiusEnd,
+                                     image_.size(), cv::Size(Width, Height) };
+    std::shared_ptr<const FixedPointMap> map = CachedPolarMap(geometry, true);
+
+    SImage dst;
+    RemapFixedPoint(image_, dst.image_, *map, bilinear);
+    return dst;
+  }
+
+  ///
+  /// \brief    一次遍历计算整幅图像的灰度统计量
+  /// \param    [in]  Percent  最小/最大灰度两端各裁剪的百分比
+  ///
+  GrayStatistics Statistics(const double Percent = 0) const
+  {
+    GrayStatistics stats = *CachedHistogram();
+    if (Percent != 0)
+      FinishGrayStatistics(stats, Percent);
+    return stats;
+  }
+
+  ///
+  /// \brief    一次遍历计算区域内的灰度统计量
+  ///
+  GrayStatistics Statistics(const SRegion& Regions, const double Percent = 0) const
+  {
+    const std::vector<SRegion> regions(1, Regions);
+    return CalcGrayStatistics(image_, &regions, Percent).front();
+  }
+
+  ///
+  /// \brief    一次并行遍历计算区域组中每个区域的灰度统计量
+  ///
+  std::vector<GrayStatistics> Statistics(const std::vector<SRegion>& Regions,
+                                         const double Percent = 0) const
+  {
+    return CalcGrayStatistics(image_, &Regions, Percent);
+  }
+
+  std::vector<int64_t> GrayHisto(const SRegion& Regions, std::vector<double>* RelativeHisto) const
+  {
+    const GrayStatistics stats = Statistics(Regions);
+    if (RelativeHisto)
+      *RelativeHisto = stats.Relative();
+    return stats.histogram;
+  }
+
+  void MinMaxGray(const SRegion& Regions, const double Percent, double* Min, double* Max,
+                  double* Range) const
+  {
+    const GrayStatistics stats = Statistics(Regions, Percent);
+    if (Min)
+      *Min = stats.min;
+    if (Max)
+      *Max = stats.max;
+    if (Range)
+      *Range = stats.range;
+  }
+
+  double Intensity(const SRegion& Regions, double* Deviation) const
+  {
+    const GrayStatistics stats = Statistics(Regions);
+    if (Deviation)
+      *Deviation = stats.deviation;
+    return stats.mean;
+  }
+
+  double EntropyGray(const SRegion& Regions, double* Anisotropy) const
+  {
+    const GrayStatistics stats = Statistics(Regions);
+    if (Anisotropy)
+      *Anisotropy = stats.anisotropy;
+    return stats.entropy;
+  }
+
+  ///
+  /// \brief    提取一条激光轮廓并累积到模型的视差图，图像为CV_8UC1或CV_16UC1
+  ///
+  void MeasureProfileSheetOfLight(SheetOfLightModel& SheetOfLightModelID) const
+  {
+    SheetOfLightModelID.Measure(image_);
+  }
+
+  ///
+  /// \brief    取模型中已累积的结果
+  /// \param    [in]  ResultName  "disparity"或"score"
+  ///
+  void GetSheetOfLightResult(const SheetOfLightModel& SheetOfLightModelID,
+                             const std::string& ResultName)
+  {
+    if (ResultName == "disparity")
+      image_ = SheetOfLightModelID.Disparity().clone();
+    else if (ResultName == "score")
+      image_ = SheetOfLightModelID.Score().clone();
+    else
+      CV_Error(cv::Error::StsBadArg, "Unsupported sheet-of-light result: " + ResultName);
+    storage_.reset();
+    cache_ = std::make_shared<DerivedDataCache>();
+  }
+
+  ///
+  /// \brief    Sobel梯度幅值，梯度由派生数据缓存共用
+  /// \param    [in]  FilterType  "sum_abs"为|dx| + |dy|，"sum_sqrt"为sqrt(dx² + dy²)
+  ///
+  SImage SobelAmp(const std::string& FilterType) const
+  {
+    std::shared_ptr<const ImageGradient> gradient = CachedGradient();
+    // The 3x3 Sobel response is scaled by 1/4 so that it fits into 8 bits
+    SImage dst;
+    if (FilterType == "sum_abs")
+    {
+      cv::Mat ax, ay;
+      cv::convertScaleAbs(gradient->dx, ax, 0.25);
+      cv::convertScaleAbs(gradient->dy, ay, 0.25);
+      cv::add(ax, ay, dst.image_);
+    }
+    else if (FilterType == "sum_sqrt")
+    {
+      cv::Mat fx, fy, magnitude;
+      gradient->dx.convertTo(fx, CV_32F, 0.25);
+      gradient->dy.convertTo(fy, CV_32F, 0.25);
+      cv::magnitude(fx, fy, magnitude);
+      magnitude.convertTo(dst.image_, CV_8U);
+    }
+    else
+    {
+      CV_Error(cv::Error::StsBadArg, "Unsupported filter type: " + FilterType);
+    }
+    return dst;
+  }
+
 private:
+  // Derived data below is shared by every operator working on the same frame and
+  // rebuilt only when the pixel data changes
+  std::shared_ptr<const GaussPyramid> CachedGaussPyramid(const std::string& Mode) const
+  {
+    const cv::Mat& image = image_;
+    return cache_->Get<GaussPyramid>(image_, "pyramid:" + Mode, [&]() {
+      GaussPyramid pyramid;
+      pyramid.Build(image, Mode);
+      return pyramid;
+    });
+  }
+
+  std::shared_ptr<const ImagePlanes> CachedPlanes() const
+  {
+    const cv::Mat& image = image_;
+    return cache_->Get<ImagePlanes>(image_, "planes", [&]() {
+      return SplitPlanes(image);
+    });
+  }
+
+  // The planes are copied into one block owned by the result and kept as its planar
+  // storage, so channel views never share pixels with the inputs or their storage_
+  static SImage FromPlanes(const std::vector<cv::Mat>& planes)
+  {
+    CV_Assert(!planes.empty() && planes[0].channels() == 1);
+    const int rows = planes[0].rows;
+    const cv::Mat block((int)planes.size() * rows, planes[0].cols, planes[0].type());
+    std::shared_ptr<ImagePlanes> stored = std::make_shared<ImagePlanes>();
+    for (size_t k = 0; k < planes.size(); k++)
+    {
+      CV_Assert(planes[k].size() == planes[0].size() && planes[k].type() == planes[0].type());
+      stored->planes.push_back(block.rowRange((int)k * rows, (int)(k + 1) * rows));
+      planes[k].copyTo(stored->planes[k]);
+    }
+
+    SImage dst;
+    MergePlanes(stored->planes, dst.image_);
+    dst.cache_->Put<ImagePlanes>(dst.image_, "planes", stored);
+    return dst;
+  }
+
+  std::shared_ptr<const GrayStatistics> CachedHistogram() const
+  {
+    const cv::Mat& image = image_;
+    return cache_->Get<GrayStatistics>(image_, "histogram", [&]() {
+      return CalcGrayStatistics(image, NULL, 0).front();
+    });
+  }
+
+  template <typename Sum>
+  std::shared_ptr<const IntegralImages<Sum> > CachedIntegral() const
+  {
+    const cv::Mat& image = image_;
+    const std::string key = sizeof(Sum) == 4 ? "integral32" : "integral64";
+    return cache_->Get<IntegralImages<Sum> >(image_, key, [&]() {
+      IntegralImages<Sum> integral;
+      CalcIntegralImages(image, integral);
+      return integral;
+    });
+  }
+
+  std::shared_ptr<const ImageGradient> CachedGradient() const
+  {
+    const cv::Mat& image = image_;
+    return cache_->Get<ImageGradient>(image_, "gradient", [&]() {
+      ImageGradient gradient;
+      cv::Sobel(image, gradient.dx, CV_16S, 1, 0, 3);
+      cv::Sobel(image, gradient.dy, CV_16S, 0, 1, 3);
+      return gradient;
+    });
+  }
+
+  // Local thresholds share the integral images of the frame
+  template <typename Rule>
+  SRegion WindowThresholdCached(const int MaskWidth, const int MaskHeight, const Rule& rule,
+                                const bool needs_deviation) const
+  {
+    CV_Assert(image_.type() == CV_8UC1);
+    if (MaskWidth < 1 || MaskHeight < 1)
+      CV_Error(cv::Error::StsBadArg, "Mask size must be positive");
+
+    SRegion region;
+    if (FitsUInt32Window(MaskWidth, MaskHeight))
+      WindowThresholdWith(image_, *CachedIntegral<uint32_t>(), MaskWidth, MaskHeight, rule,
+                          needs_deviation, NULL, &region);
+    else
+      WindowThresholdWith(image_, *CachedIntegral<uint64_t>(), MaskWidth, MaskHeight, rule,
+                          needs_deviation, NULL, &region);
+    return region;
+  }
+
+  friend struct ImageExprOf<SImage>;
+
   cv::Mat image_;
+  std::shared_ptr<DerivedDataCache> cache_;  ///< Shared by copies, entries check their source frame
+  std::shared_ptr<const void> storage_;      ///< Owner of external pixel memory, e.g. a file mapping
+};
+
+template <>
+struct ImageExprOf<SImage>
+{
+  typedef ImageTerm type;
+  static ImageTerm Get(const SImage& image) { return ImageTerm(image.image_); }
 };
 
 } // zvision
\ No newline at end of file
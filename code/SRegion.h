@@ -0,0 +1,212 @@
+﻿///*****************************************************************************
+///
+/// \file       SRegion.h
+/// \brief      游程编码区域
+///
+///             SRegion对应Halcon的HRegion，以按行、列排序的游程保存像素集合。
+///             阈值等算子可直接逐行输出游程，不必生成整幅二值图像
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+namespace my_cv {
+
+///
+/// \brief 一行中连续的像素，列范围为[ColumnBegin, ColumnEnd)
+///
+struct RegionRun
+{
+  int Row;
+  int ColumnBegin;
+  int ColumnEnd;
+};
+
+///
+/// \brief    将一行中非0像素编码为游程并追加到runs
+///
+static void AppendRowRuns(const uchar* mask, const int width, const int row,
+                          std::vector<RegionRun>& runs)
+{
+  int j = 0;
+  while (j < width)
+  {
+    while (j < width && mask[j] == 0)
+      j++;
+    if (j == width)
+      break;
+    const int begin = j;
+    while (j < width && mask[j] != 0)
+      j++;
+    const RegionRun run = { row, begin, j };
+    runs.push_back(run);
+  }
+}
+
+///
+/// \brief    合并按行条带并行生成的游程，条带按行序排列
+///
+static std::vector<RegionRun> ConcatRuns(const std::vector<std::vector<RegionRun> >& stripes)
+{
+  size_t total = 0;
+  for (size_t k = 0; k < stripes.size(); k++)
+    total += stripes[k].size();
+
+  std::vector<RegionRun> runs;
+  runs.reserve(total);
+  for (size_t k = 0; k < stripes.size(); k++)
+    runs.insert(runs.end(), stripes[k].begin(), stripes[k].end());
+  return runs;
+}
+
+class MaskToRunsRunner : public cv::ParallelLoopBody
+{
+public:
+  MaskToRunsRunner(const cv::Mat& _mask, int _stripe_rows,
+                   std::vector<std::vector<RegionRun> >& _stripes)
+    : mask(_mask), stripe_rows(_stripe_rows), stripes(_stripes)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    for (int s = range.start; s < range.end; s++)
+    {
+      const int row1 = std::min(mask.rows, (s + 1) * stripe_rows);
+      for (int i = s * stripe_rows; i < row1; i++)
+        AppendRowRuns(mask.ptr<uchar>(i), mask.cols, i, stripes[s]);
+    }
+  }
+
+private:
+  cv::Mat mask;
+  int stripe_rows;
+  std::vector<std::vector<RegionRun> >& stripes;
+};
+
+///
+/// \brief 游程编码区域
+///
+class SRegion
+{
+public:
+  SRegion()
+  { }
+  ///
+  /// \brief    构造函数
+  /// \param    [in]  runs 按行、列排序且互不重叠的游程
+  ///
+  explicit SRegion(const std::vector<RegionRun>& runs)
+    : runs_(runs)
+  { }
+
+  ///
+  /// \brief    生成矩形区域，行列范围均为闭区间
+  ///
+  static SRegion GenRectangle1(const int Row1, const int Column1, const int Row2,
+                               const int Column2)
+  {
+    SRegion region;
+    if (Row2 < Row1 || Column2 < Column1)
+      return region;
+    region.runs_.reserve(Row2 - Row1 + 1);
+    for (int i = Row1; i <= Row2; i++)
+    {
+      const RegionRun run = { i, Column1, Column2 + 1 };
+      region.runs_.push_back(run);
+    }
+    return region;
+  }
+
+  ///
+  /// \brief    由CV_8UC1掩膜生成区域，非0像素属于区域
+  ///
+  static SRegion FromMask(const cv::Mat& mask)
+  {
+    CV_Assert(mask.type() == CV_8UC1);
+
+    const int stripe_rows = 64;
+    const int nstripes = (mask.rows + stripe_rows - 1) / stripe_rows;
+    std::vector<std::vector<RegionRun> > stripes(nstripes);
+    cv::parallel_for_(cv::Range(0, nstripes), MaskToRunsRunner(mask, stripe_rows, stripes));
+    return SRegion(ConcatRuns(stripes));
+  }
+
+  ///
+  /// \brief    绘制为CV_8UC1掩膜，区域内为255
+  ///
+  cv::Mat ToMask(const cv::Size& size) const
+  {
+    cv::Mat mask = cv::Mat::zeros(size, CV_8UC1);
+    const SRegion clipped = Clip(size);
+    for (size_t k = 0; k < clipped.runs_.size(); k++)
+    {
+      const RegionRun& run = clipped.runs_[k];
+      uchar* p = mask.ptr<uchar>(run.Row);
+      std::fill(p + run.ColumnBegin, p + run.ColumnEnd, (uchar)255);
+    }
+    return mask;
+  }
+
+  ///
+  /// \brief    裁剪到[0, size)范围内
+  ///
+  SRegion Clip(const cv::Size& size) const
+  {
+    SRegion region;
+    region.runs_.reserve(runs_.size());
+    for (size_t k = 0; k < runs_.size(); k++)
+    {
+      RegionRun run = runs_[k];
+      if (run.Row < 0 || run.Row >= size.height)
+        continue;
+      run.ColumnBegin = std::max(run.ColumnBegin, 0);
+      run.ColumnEnd = std::min(run.ColumnEnd, size.width);
+      if (run.ColumnBegin < run.ColumnEnd)
+        region.runs_.push_back(run);
+    }
+    return region;
+  }
+
+  bool Empty() const { return runs_.empty(); }
+
+  int64_t Area() const
+  {
+    int64_t area = 0;
+    for (size_t k = 0; k < runs_.size(); k++)
+      area += runs_[k].ColumnEnd - runs_[k].ColumnBegin;
+    return area;
+  }
+
+  cv::Rect BoundingBox() const
+  {
+    if (runs_.empty())
+      return cv::Rect();
+    int col0 = INT_MAX, col1 = INT_MIN;
+    for (size_t k = 0; k < runs_.size(); k++)
+    {
+      col0 = std::min(col0, runs_[k].ColumnBegin);
+      col1 = std::max(col1, runs_[k].ColumnEnd);
+    }
+    return cv::Rect(col0, runs_.front().Row, col1 - col0,
+                    runs_.back().Row - runs_.front().Row + 1);
+  }
+
+  const std::vector<RegionRun>& Runs() const { return runs_; }
+
+private:
+  std::vector<RegionRun> runs_;  ///< 按行、列排序的游程
+};
+
+} // my_cv
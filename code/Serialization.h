@@ -0,0 +1,147 @@
+﻿///*****************************************************************************
+///
+/// \file       Serialization.h
+/// \brief      图像与区域的二进制序列化
+///
+///             序列化结果是一段连续的、带版本号的缓冲区，可直接发送或保存。图像的
+///             布局与.simg原生图像文件相同，反序列化时图像直接引用缓冲区中的像素，
+///             不做复制；缓冲区由SerializedItem共享持有，在图像使用期间保持有效
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "RawImageFile.h"
+#include "SRegion.h"
+
+namespace my_cv {
+
+///
+/// \brief 区域序列化的头
+///
+struct SerializedRegionHeader
+{
+  char magic[4];     ///< "SREG"
+  uint32_t version;  ///< 当前为1
+  uint64_t runs;     ///< 游程数，游程紧接在头之后
+};
+
+static_assert(sizeof(SerializedRegionHeader) == 16, "SerializedRegionHeader must be 16 bytes");
+
+///
+/// \brief 序列化结果，数据为只读，复制时共享同一缓冲区
+///
+class SerializedItem
+{
+public:
+  SerializedItem()
+    : data_(NULL), size_(0)
+  { }
+
+  ///
+  /// \brief    接管bytes
+  ///
+  explicit SerializedItem(std::vector<uchar>&& bytes)
+  {
+    std::shared_ptr<std::vector<uchar> > owner =
+      std::make_shared<std::vector<uchar> >(std::move(bytes));
+    data_ = owner->empty() ? NULL : &(*owner)[0];
+    size_ = owner->size();
+    owner_ = owner;
+  }
+
+  ///
+  /// \brief    引用外部内存（如共享内存或接收缓冲区）而不复制
+  /// \param    [in]  owner  持有data的对象，在SerializedItem及由其反序列化的图像使用期间保持
+  ///
+  static SerializedItem Wrap(const uchar* data, const size_t size,
+                             const std::shared_ptr<const void>& owner)
+  {
+    SerializedItem item;
+    item.data_ = data;
+    item.size_ = size;
+    item.owner_ = owner;
+    return item;
+  }
+
+  const uchar* Data() const { return data_; }
+  size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  const std::shared_ptr<const void>& Owner() const { return owner_; }
+
+private:
+  const uchar* data_;
+  size_t size_;
+  std::shared_ptr<const void> owner_;
+};
+
+///
+/// \brief    序列化图像，布局与.simg文件相同
+///
+static SerializedItem SerializeRawImage(const cv::Mat& image)
+{
+  CV_Assert(!image.empty() && image.dims == 2);
+  const RawImageHeader header = MakeRawImageHeader(image, NULL);
+  std::vector<uchar> bytes((size_t)RawImageBytes(header), 0);
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  const size_t row_bytes = image.cols * image.elemSize();
+  for (int i = 0; i < image.rows; i++)
+    std::memcpy(&bytes[(size_t)(header.data_offset + header.step * i)], image.ptr(i), row_bytes);
+  return SerializedItem(std::move(bytes));
+}
+
+///
+/// \brief    反序列化图像，结果引用item中的像素
+///
+static cv::Mat DeserializeRawImage(const SerializedItem& item)
+{
+  cv::Mat image;
+  if (!ViewRawImage(item.Data(), item.Size(), image, NULL))
+    CV_Error(cv::Error::StsParseError, "Not a serialized image");
+  return image;
+}
+
+static SerializedItem SerializeRegion(const SRegion& region)
+{
+  const std::vector<RegionRun>& runs = region.Runs();
+  SerializedRegionHeader header;
+  std::memcpy(header.magic, "SREG", 4);
+  header.version = 1;
+  header.runs = runs.size();
+
+  std::vector<uchar> bytes(sizeof(header) + runs.size() * sizeof(RegionRun));
+  std::memcpy(&bytes[0], &header, sizeof(header));
+  if (!runs.empty())
+    std::memcpy(&bytes[sizeof(header)], &runs[0], runs.size() * sizeof(RegionRun));
+  return SerializedItem(std::move(bytes));
+}
+
+static SRegion DeserializeRegion(const SerializedItem& item)
+{
+  SerializedRegionHeader header;
+  if (item.Size() < sizeof(header))
+    CV_Error(cv::Error::StsParseError, "Not a serialized region");
+  std::memcpy(&header, item.Data(), sizeof(header));
+  if (std::memcmp(header.magic, "SREG", 4) != 0 || header.version != 1 ||
+      header.runs > (item.Size() - sizeof(header)) / sizeof(RegionRun))
+    CV_Error(cv::Error::StsParseError, "Not a serialized region");
+
+  std::vector<RegionRun> runs((size_t)header.runs);
+  if (!runs.empty())
+    std::memcpy(&runs[0], item.Data() + sizeof(header), runs.size() * sizeof(RegionRun));
+  return SRegion(runs);
+}
+
+} // my_cv
@@ -0,0 +1,1200 @@
+﻿///*****************************************************************************
+///
+/// \file       ShapeModel.h
+/// \brief      基于形状的模板匹配
+///
+///             参照Halcon的create_shape_model/find_shape_model实现：梯度方向量化为
+///             8个方向，方向位图经扩散后通过查表生成响应图，在金字塔顶层按旋转步
+///             并行密集搜索，再逐层向下细化，支持贪婪度提前终止
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#if CV_SSSE3
+#include <tmmintrin.h>
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "GaussPyramid.h"
+
+namespace my_cv {
+
+/// 量化方向数，恰好用一个字节的位图表示
+static const int kShapeOrientations = 8;
+/// 单个特征点的最大响应值
+static const int kShapeMaxResponse = 16;
+/// 单个模板的最大特征点数，保证16位累加器不溢出
+static const int kShapeMaxFeatures = 65535 / kShapeMaxResponse;
+
+///
+/// \brief 形状模板的特征点
+///
+struct ShapeFeature
+{
+  int x;        ///< 相对参考点的列偏移
+  int y;        ///< 相对参考点的行偏移
+  int label;    ///< 量化后的梯度方向 [0, 8)
+};
+
+///
+/// \brief 某个角度、缩放下的形状模板
+///
+struct ShapeTemplate
+{
+  double angle;   ///< 旋转角度（弧度，逆时针为正）
+  double scale;   ///< 缩放系数
+  cv::Rect bound; ///< 特征点相对参考点的包围框
+  std::vector<ShapeFeature> features;
+};
+
+///
+/// \brief 形状匹配结果
+///
+struct ShapeMatch
+{
+  double row;     ///< 参考点行坐标
+  double column;  ///< 参考点列坐标
+  double angle;   ///< 旋转角度（弧度）
+  double scale;   ///< 缩放系数
+  double score;   ///< 匹配分数 [0, 1]
+};
+
+///
+/// \brief 搜索过程中的候选位置
+///
+struct ShapeCandidate
+{
+  int x;
+  int y;
+  int index;      ///< 当前金字塔层中的模板序号
+  double score;
+};
+
+///
+/// \brief    将角度归一化到 [0, 2*pi)
+///
+static inline double NormalizeAngle(double angle)
+{
+  angle = std::fmod(angle, 2 * CV_PI);
+  return angle < 0 ? angle + 2 * CV_PI : angle;
+}
+
+///
+/// \brief    判断角度是否落在 [start, start + extent] 范围内
+///
+static inline bool AngleInRange(double angle, double start, double extent)
+{
+  if (extent >= 2 * CV_PI)
+    return true;
+  return NormalizeAngle(angle - start) <= extent + 1e-9;
+}
+
+///
+/// \brief    梯度方向（度）量化为方向序号
+/// \param    [in]  degree    梯度方向 [0, 360)
+/// \param    [in]  polarity  是否区分极性，区分时8个方向覆盖360度，否则覆盖180度
+///
+static inline int QuantizeOrientation(float degree, bool polarity)
+{
+  const float bin_width = polarity ? 45.f : 22.5f;
+  int label = cvFloor(degree / bin_width);
+  return label & (kShapeOrientations - 1);
+}
+
+class QuantizeGradientRunner : public cv::ParallelLoopBody
+{
+public:
+  QuantizeGradientRunner(const cv::Mat& _dx, const cv::Mat& _dy, cv::Mat& _quantized,
+                         cv::Mat* _magnitude, cv::Mat* _direction,
+                         float _min_contrast, bool _polarity)
+    : dx(_dx), dy(_dy), quantized(_quantized), magnitude(_magnitude),
+      direction(_direction), min_contrast(_min_contrast), polarity(_polarity)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    // Sobel responds with 4x the gray value step, compare squared magnitudes
+    const int threshold = cvRound(16.f * min_contrast * min_contrast);
+
+    for (int i = range.start; i < range.end; i++)
+    {
+      const short* gx = dx.ptr<short>(i);
+      const short* gy = dy.ptr<short>(i);
+      uchar* q = quantized.ptr<uchar>(i);
+      float* mag = magnitude ? magnitude->ptr<float>(i) : nullptr;
+      float* dir = direction ? direction->ptr<float>(i) : nullptr;
+
+      for (int j = 0; j < dx.cols; j++)
+      {
+        const int m2 = gx[j] * gx[j] + gy[j] * gy[j];
+        if (m2 < threshold || m2 == 0)
+        {
+          q[j] = 0;
+          if (mag)
+            mag[j] = 0;
+          continue;
+        }
+
+        const float degree = cv::fastAtan2((float)gy[j], (float)gx[j]);
+        q[j] = (uchar)(1 << QuantizeOrientation(degree, polarity));
+        if (mag)
+          mag[j] = std::sqrt((float)m2) * 0.25f;
+        if (dir)
+          dir[j] = degree;
+      }
+    }
+  }
+
+private:
+  cv::Mat dx;
+  cv::Mat dy;
+  cv::Mat& quantized;
+  cv::Mat* magnitude;
+  cv::Mat* direction;
+
+  float min_contrast;
+  bool polarity;
+};
+
+///
+/// \brief    计算梯度并量化为方向位图
+///
+/// 每个像素输出一个字节，梯度幅值低于min_contrast的像素为0，否则第label位置1
+///
+/// \param    [in]  src           8位单通道图像
+/// \param    [out] quantized     方向位图
+/// \param    [out] magnitude     梯度幅值（灰度差单位），可为空
+/// \param    [out] direction     梯度方向（度），可为空
+/// \param    [in]  min_contrast  最小对比度
+/// \param    [in]  polarity      是否区分极性
+///
+static void QuantizeGradients(const cv::Mat& src, cv::Mat& quantized,
+                              cv::Mat* magnitude, cv::Mat* direction,
+                              float min_contrast, bool polarity)
+{
+  CV_Assert(src.type() == CV_8UC1);
+
+  cv::Mat dx, dy;
+  cv::Sobel(src, dx, CV_16S, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+  cv::Sobel(src, dy, CV_16S, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+
+  quantized.create(src.size(), CV_8UC1);
+  if (magnitude)
+    magnitude->create(src.size(), CV_32FC1);
+  if (direction)
+    direction->create(src.size(), CV_32FC1);
+
+  cv::parallel_for_(cv::Range(0, src.rows),
+                    QuantizeGradientRunner(dx, dy, quantized, magnitude, direction,
+                                           min_contrast, polarity),
+                    src.total() / (double)(1 << 16));
+}
+
+class SpreadRunner : public cv::ParallelLoopBody
+{
+public:
+  SpreadRunner(const cv::Mat& _src, cv::Mat& _dst, int _radius)
+    : src(_src), dst(_dst), radius(_radius)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int width = src.cols;
+    std::vector<uchar> row(width);
+
+    for (int i = range.start; i < range.end; i++)
+    {
+      // Vertical OR over the clamped row window
+      const int r0 = std::max(i - radius, 0);
+      const int r1 = std::min(i + radius, src.rows - 1);
+      std::memcpy(row.data(), src.ptr<uchar>(r0), width);
+      for (int r = r0 + 1; r <= r1; r++)
+      {
+        const uchar* s = src.ptr<uchar>(r);
+        int j = 0;
+#if CV_SIMD128
+        for (; j <= width - 16; j += 16)
+          cv::v_store(row.data() + j, cv::v_load(row.data() + j) | cv::v_load(s + j));
+#endif
+        for (; j < width; j++)
+          row[j] |= s[j];
+      }
+
+      // Horizontal OR over the column window
+      uchar* d = dst.ptr<uchar>(i);
+      int j = 0;
+      for (; j < std::min(radius, width); j++)
+      {
+        uchar v = 0;
+        for (int k = std::max(j - radius, 0); k <= std::min(j + radius, width - 1); k++)
+          v |= row[k];
+        d[j] = v;
+      }
+#if CV_SIMD128
+      for (; j <= width - radius - 16; j += 16)
+      {
+        cv::v_uint8x16 v = cv::v_load(row.data() + j - radius);
+        for (int k = -radius + 1; k <= radius; k++)
+          v = v | cv::v_load(row.data() + j + k);
+        cv::v_store(d + j, v);
+      }
+#endif
+      for (; j < width; j++)
+      {
+        uchar v = 0;
+        for (int k = std::max(j - radius, 0); k <= std::min(j + radius, width - 1); k++)
+          v |= row[k];
+        d[j] = v;
+      }
+    }
+  }
+
+private:
+  cv::Mat src;
+  cv::Mat& dst;
+  int radius;
+};
+
+///
+/// \brief    方向位图扩散
+///
+/// 对 (2*radius+1)^2 邻域内的方向位图做按位或，使匹配对小的位置偏差不敏感
+///
+static void SpreadOrientations(const cv::Mat& quantized, cv::Mat& spread, int radius)
+{
+  if (radius <= 0)
+  {
+    spread = quantized;
+    return;
+  }
+
+  spread.create(quantized.size(), CV_8UC1);
+  cv::parallel_for_(cv::Range(0, quantized.rows),
+                    SpreadRunner(quantized, spread, radius),
+                    quantized.total() / (double)(1 << 16));
+}
+
+///
+/// \brief    生成方向位图到响应值的查找表
+///
+/// lut[o][m] 为方向o与位图m中各方向相似度的最大值，相似度取夹角余弦
+///
+static void BuildResponseTables(bool polarity, uchar lut[kShapeOrientations][256])
+{
+  const double bin_width = polarity ? CV_PI / 4 : CV_PI / 8;
+  uchar similarity[kShapeOrientations][kShapeOrientations];
+  for (int o = 0; o < kShapeOrientations; o++)
+  {
+    for (int b = 0; b < kShapeOrientations; b++)
+    {
+      double c = std::cos((o - b) * bin_width);
+      if (!polarity)
+        c = std::fabs(c);
+      similarity[o][b] = (uchar)std::max(cvRound(kShapeMaxResponse * c), 0);
+    }
+  }
+
+  for (int o = 0; o < kShapeOrientations; o++)
+  {
+    for (int m = 0; m < 256; m++)
+    {
+      uchar v = 0;
+      for (int b = 0; b < kShapeOrientations; b++)
+        if (m & (1 << b))
+          v = std::max(v, similarity[o][b]);
+      lut[o][m] = v;
+    }
+  }
+}
+
+class ResponseRunner : public cv::ParallelLoopBody
+{
+public:
+  ResponseRunner(const cv::Mat& _spread, std::vector<cv::Mat>& _responses, bool polarity)
+    : spread(_spread), responses(_responses)
+  {
+    BuildResponseTables(polarity, lut);
+  }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int width = spread.cols;
+
+#if CV_SSSE3
+    // Split the 8-bit mask into two nibbles and look both up with pshufb
+    __m128i lut_lo[kShapeOrientations], lut_hi[kShapeOrientations];
+    for (int o = 0; o < kShapeOrientations; o++)
+    {
+      alignas(16) uchar lo[16], hi[16];
+      for (int n = 0; n < 16; n++)
+      {
+        lo[n] = lut[o][n];
+        hi[n] = lut[o][n << 4];
+      }
+      lut_lo[o] = _mm_load_si128((const __m128i*)lo);
+      lut_hi[o] = _mm_load_si128((const __m128i*)hi);
+    }
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+#endif
+
+    for (int i = range.start; i < range.end; i++)
+    {
+      const uchar* s = spread.ptr<uchar>(i);
+      uchar* r[kShapeOrientations];
+      for (int o = 0; o < kShapeOrientations; o++)
+        r[o] = responses[o].ptr<uchar>(i);
+
+      int j = 0;
+#if CV_SSSE3
+      for (; j <= width - 16; j += 16)
+      {
+        const __m128i v = _mm_loadu_si128((const __m128i*)(s + j));
+        const __m128i lo = _mm_and_si128(v, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+        for (int o = 0; o < kShapeOrientations; o++)
+        {
+          const __m128i res = _mm_max_epu8(_mm_shuffle_epi8(lut_lo[o], lo),
+                                           _mm_shuffle_epi8(lut_hi[o], hi));
+          _mm_storeu_si128((__m128i*)(r[o] + j), res);
+        }
+      }
+#endif
+      for (; j < width; j++)
+        for (int o = 0; o < kShapeOrientations; o++)
+          r[o][j] = lut[o][s[j]];
+    }
+  }
+
+private:
+  cv::Mat spread;
+  std::vector<cv::Mat>& responses;
+  uchar lut[kShapeOrientations][256];
+};
+
+///
+/// \brief    由扩散后的方向位图计算8幅响应图
+///
+static void ComputeResponseMaps(const cv::Mat& spread, std::vector<cv::Mat>& responses,
+                                bool polarity)
+{
+  responses.resize(kShapeOrientations);
+  for (int o = 0; o < kShapeOrientations; o++)
+    responses[o].create(spread.size(), CV_8UC1);
+
+  cv::parallel_for_(cv::Range(0, spread.rows),
+                    ResponseRunner(spread, responses, polarity),
+                    spread.total() / (double)(1 << 16));
+}
+
+///
+/// \brief 基于形状的匹配模型
+///
+/// 与Halcon的HShapeModel对应，模型在每一层金字塔上保存全部角度、缩放下的模板，
+/// 角度步长随层数加倍
+///
+class ShapeModel
+{
+public:
+  ShapeModel()
+    : polarity_(true), min_contrast_(0)
+  { }
+
+  ///
+  /// \brief    创建模型
+  /// \param    [in]  templ         8位单通道模板图像
+  /// \param    [in]  mask          模板区域，为空时使用整幅图像
+  /// \param    [in]  NumLevels     金字塔层数，0为自动
+  /// \param    [in]  AngleStart    起始角度（弧度）
+  /// \param    [in]  AngleExtent   角度范围（弧度）
+  /// \param    [in]  AngleStep     角度步长（弧度），0为自动
+  /// \param    [in]  ScaleMin      最小缩放
+  /// \param    [in]  ScaleMax      最大缩放
+  /// \param    [in]  ScaleStep     缩放步长，0为自动
+  /// \param    [in]  Optimization  特征点缩减："none"、"point_reduction_low"、
+  ///                               "point_reduction_medium"、"point_reduction_high"、"auto"
+  /// \param    [in]  Metric        "use_polarity"或"ignore_local_polarity"
+  /// \param    [in]  Contrast      模板边缘的最小对比度
+  /// \param    [in]  MinContrast   搜索图像中边缘的最小对比度
+  ///
+  void Create(const cv::Mat& templ, const cv::Mat& mask, int NumLevels,
+              double AngleStart, double AngleExtent, double AngleStep,
+              double ScaleMin, double ScaleMax, double ScaleStep,
+              const std::string& Optimization, const std::string& Metric,
+              int Contrast, int MinContrast)
+  {
+    CV_Assert(templ.type() == CV_8UC1 && !templ.empty());
+    CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == templ.size()));
+    CV_Assert(AngleExtent >= 0 && ScaleMin > 0 && ScaleMax >= ScaleMin);
+
+    if (Metric == "use_polarity")
+      polarity_ = true;
+    else if (Metric == "ignore_local_polarity")
+      polarity_ = false;
+    else
+      CV_Error(cv::Error::StsBadArg, "Unsupported shape model metric: " + Metric);
+
+    int max_features = kShapeMaxFeatures;
+    if (Optimization == "point_reduction_low")
+      max_features = 512;
+    else if (Optimization == "point_reduction_medium")
+      max_features = 256;
+    else if (Optimization == "point_reduction_high" || Optimization == "auto")
+      max_features = 128;
+    else if (Optimization != "none")
+      CV_Error(cv::Error::StsBadArg, "Unsupported shape model optimization: " + Optimization);
+
+    min_contrast_ = MinContrast;
+    levels_.clear();
+
+    cv::Mat domain = mask.empty() ? cv::Mat(templ.size(), CV_8UC1, cv::Scalar(255)) : mask;
+    origin_ = DomainCenter(domain);
+    bound_ = cv::Rect(0, 0, templ.cols, templ.rows);
+    if (!mask.empty())
+    {
+      std::vector<cv::Point> points;
+      for (int i = 0; i < domain.rows; i++)
+      {
+        const uchar* m = domain.ptr<uchar>(i);
+        for (int j = 0; j < domain.cols; j++)
+          if (m[j])
+            points.push_back(cv::Point(j, i));
+      }
+      CV_Assert(!points.empty());
+      int x0 = templ.cols, y0 = templ.rows, x1 = 0, y1 = 0;
+      for (size_t k = 0; k < points.size(); k++)
+      {
+        x0 = std::min(x0, points[k].x);
+        y0 = std::min(y0, points[k].y);
+        x1 = std::max(x1, points[k].x);
+        y1 = std::max(y1, points[k].y);
+      }
+      bound_ = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+    }
+
+    const int max_levels = NumLevels > 0 ? NumLevels : 10;
+    cv::Mat image = templ;
+    double angle_step = AngleStep;
+    double scale_step = ScaleStep;
+
+    for (int level = 0; level < max_levels; level++)
+    {
+      if (level > 0)
+      {
+        cv::Mat down;
+        cv::pyrDown(image, down);
+        image = down;
+        cv::resize(domain, down, image.size(), 0, 0, cv::INTER_NEAREST);
+        domain = down;
+      }
+
+      const double factor = 1.0 / (1 << level);
+      std::vector<ShapeFeature> base;
+      std::vector<float> degrees;
+      ExtractFeatures(image, domain, cv::Point2d(origin_.x * factor, origin_.y * factor),
+                      (float)Contrast, max_features, base, degrees);
+
+      // In auto mode stop once the template no longer carries enough structure
+      if (NumLevels <= 0 && level > 0 &&
+          (base.size() < 16 || std::min(image.cols, image.rows) < 16))
+        break;
+      if (base.empty())
+      {
+        if (level == 0)
+          CV_Error(cv::Error::StsError, "Shape model has no edge points with the given contrast");
+        break;
+      }
+
+      double radius = 1;
+      for (size_t k = 0; k < base.size(); k++)
+        radius = std::max(radius, std::sqrt((double)base[k].x * base[k].x + (double)base[k].y * base[k].y));
+
+      if (level == 0)
+      {
+        if (angle_step <= 0)
+          angle_step = std::atan(1.0 / radius);
+        if (scale_step <= 0)
+          scale_step = 1.0 / radius;
+      }
+
+      Level data;
+      data.angle_start = AngleStart;
+      data.angle_step = angle_step * (1 << level);
+      data.scale_start = ScaleMin;
+      data.scale_step = scale_step * (1 << level);
+      data.full_circle = AngleExtent >= 2 * CV_PI - data.angle_step / 2;
+      data.num_angles = data.full_circle ? std::max(cvRound(2 * CV_PI / data.angle_step), 1)
+                                         : cvFloor(AngleExtent / data.angle_step + 1e-9) + 1;
+      data.num_scales = cvFloor((ScaleMax - ScaleMin) / data.scale_step + 1e-9) + 1;
+
+      data.templates.resize((size_t)data.num_angles * data.num_scales);
+      for (int s = 0; s < data.num_scales; s++)
+        for (int a = 0; a < data.num_angles; a++)
+          BuildTemplate(base, degrees, AngleStart + a * data.angle_step,
+                        ScaleMin + s * data.scale_step,
+                        data.templates[(size_t)s * data.num_angles + a]);
+
+      levels_.push_back(data);
+    }
+  }
+
+  ///
+  /// \brief    在图像中搜索模型
+  /// \param    [in]  image       8位单通道搜索图像
+  /// \param    [in]  AngleStart  搜索起始角度（弧度）
+  /// \param    [in]  AngleExtent 搜索角度范围（弧度）
+  /// \param    [in]  ScaleMin    最小缩放
+  /// \param    [in]  ScaleMax    最大缩放
+  /// \param    [in]  MinScore    最小匹配分数
+  /// \param    [in]  NumMatches  最多返回的结果数，0为全部
+  /// \param    [in]  MaxOverlap  两个结果包围框允许的最大重叠比例
+  /// \param    [in]  SubPixel    "none"或"interpolation"
+  /// \param    [in]  NumLevels   使用的金字塔层数，0为模型层数
+  /// \param    [in]  Greediness  贪婪度 [0, 1]，越大越早终止不可能达标的评分
+  /// \return   按分数降序排列的匹配结果
+  ///
+  std::vector<ShapeMatch> Find(const cv::Mat& image, double AngleStart, double AngleExtent,
+                               double ScaleMin, double ScaleMax, double MinScore,
+                               int NumMatches, double MaxOverlap, const std::string& SubPixel,
+                               int NumLevels, double Greediness) const
+  {
+    CV_Assert(!levels_.empty());
+    GaussPyramid pyramid;
+    pyramid.Build(image, "weighted", NumLevels > 0 ? std::min(NumLevels, (int)levels_.size())
+                                                   : (int)levels_.size());
+    return Find(pyramid.Levels(), AngleStart, AngleExtent, ScaleMin, ScaleMax, MinScore,
+                NumMatches, MaxOverlap, SubPixel, NumLevels, Greediness);
+  }
+
+  ///
+  /// \brief    在已生成的"weighted"高斯金字塔上搜索模型，参数同上
+  ///
+  std::vector<ShapeMatch> Find(const std::vector<cv::Mat>& pyramid, double AngleStart,
+                               double AngleExtent, double ScaleMin, double ScaleMax,
+                               double MinScore, int NumMatches, double MaxOverlap,
+                               const std::string& SubPixel, int NumLevels,
+                               double Greediness) const
+  {
+    CV_Assert(!levels_.empty() && !pyramid.empty());
+    CV_Assert(pyramid[0].type() == CV_8UC1);
+    CV_Assert(MinScore >= 0 && MinScore <= 1 && Greediness >= 0 && Greediness <= 1);
+
+    int num_levels = NumLevels > 0 ? std::min(NumLevels, (int)levels_.size())
+                                   : (int)levels_.size();
+    num_levels = std::min(num_levels, (int)pyramid.size());
+
+    SearchRange search = { AngleStart, AngleExtent, ScaleMin, ScaleMax, MinScore, Greediness };
+
+    std::vector<ShapeCandidate> candidates;
+    for (int level = num_levels - 1; level >= 0; level--)
+    {
+      // Spread at coarse levels to tolerate the coarse angle sampling
+      std::vector<cv::Mat> responses;
+      cv::Mat quantized, spread;
+      QuantizeGradients(pyramid[level], quantized, nullptr, nullptr,
+                        (float)min_contrast_, polarity_);
+      SpreadOrientations(quantized, spread, level > 0 ? 1 : 0);
+      ComputeResponseMaps(spread, responses, polarity_);
+
+      if (level == num_levels - 1)
+      {
+        candidates = SearchTopLevel(levels_[level], responses, search);
+        const size_t max_candidates = NumMatches > 0 ? (size_t)NumMatches * 32 : 1024;
+        SuppressCandidates(candidates, 2, max_candidates);
+      }
+      else
+      {
+        candidates = RefineCandidates(levels_[level], levels_[level + 1], responses,
+                                      candidates, search);
+      }
+
+      if (candidates.empty())
+        return std::vector<ShapeMatch>();
+
+      if (level == 0)
+        return CollectMatches(levels_[0], responses, candidates, NumMatches, MaxOverlap,
+                              SubPixel != "none" && SubPixel != "false");
+    }
+    return std::vector<ShapeMatch>();
+  }
+
+  bool Empty() const { return levels_.empty(); }
+  int NumLevels() const { return (int)levels_.size(); }
+  ///
+  /// \brief    模型参考点（模板区域重心）在模板图像中的位置
+  ///
+  cv::Point2d Origin() const { return origin_; }
+  ///
+  /// \brief    第level层在原始角度、缩放下的模板
+  ///
+  const ShapeTemplate& Template(int level) const
+  {
+    const Level& data = levels_[level];
+    const int s = std::min(std::max(cvRound((1.0 - data.scale_start) / data.scale_step), 0),
+                           data.num_scales - 1);
+    const int a = std::min(std::max(cvRound(-data.angle_start / data.angle_step), 0),
+                           data.num_angles - 1);
+    return data.templates[(size_t)s * data.num_angles + a];
+  }
+
+private:
+  struct Level
+  {
+    double angle_start;
+    double angle_step;
+    double scale_start;
+    double scale_step;
+    int num_angles;
+    int num_scales;
+    bool full_circle;
+    std::vector<ShapeTemplate> templates;   ///< 序号为 scale * num_angles + angle
+  };
+
+  struct SearchRange
+  {
+    double angle_start;
+    double angle_extent;
+    double scale_min;
+    double scale_max;
+    double min_score;
+    double greediness;
+  };
+
+  static cv::Point2d DomainCenter(const cv::Mat& domain)
+  {
+    double sx = 0, sy = 0, n = 0;
+    for (int i = 0; i < domain.rows; i++)
+    {
+      const uchar* m = domain.ptr<uchar>(i);
+      for (int j = 0; j < domain.cols; j++)
+      {
+        if (m[j])
+        {
+          sx += j;
+          sy += i;
+          n++;
+        }
+      }
+    }
+    CV_Assert(n > 0);
+    return cv::Point2d(sx / n, sy / n);
+  }
+
+  ///
+  /// \brief    提取某一层的特征点
+  ///
+  /// 沿梯度方向做非极大值抑制得到单像素宽的边缘，特征点过多时按最小间距均匀
+  /// 抽稀，并打乱顺序使贪婪终止不偏向模板某一侧
+  ///
+  void ExtractFeatures(const cv::Mat& image, const cv::Mat& domain, const cv::Point2d& origin,
+                       float contrast, int max_features,
+                       std::vector<ShapeFeature>& features, std::vector<float>& degrees) const
+  {
+    cv::Mat quantized, magnitude, direction;
+    QuantizeGradients(image, quantized, &magnitude, &direction, contrast, polarity_);
+
+    struct Candidate { int x; int y; float magnitude; float degree; };
+    std::vector<Candidate> candidates;
+    for (int i = 1; i < image.rows - 1; i++)
+    {
+      const uchar* q = quantized.ptr<uchar>(i);
+      const uchar* m = domain.ptr<uchar>(i);
+      const float* mag = magnitude.ptr<float>(i);
+      const float* dir = direction.ptr<float>(i);
+      for (int j = 1; j < image.cols - 1; j++)
+      {
+        if (!q[j] || !m[j])
+          continue;
+
+        const double rad = dir[j] * CV_PI / 180;
+        const int ox = cvRound(std::cos(rad));
+        const int oy = cvRound(std::sin(rad));
+        if (mag[j] < magnitude.at<float>(i + oy, j + ox) ||
+            mag[j] < magnitude.at<float>(i - oy, j - ox))
+          continue;
+
+        Candidate c = { j, i, mag[j], dir[j] };
+        candidates.push_back(c);
+      }
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+              [](const Candidate& a, const Candidate& b) { return a.magnitude > b.magnitude; });
+
+    std::vector<Candidate> selected;
+    if ((int)candidates.size() <= max_features)
+    {
+      selected = candidates;
+    }
+    else
+    {
+      int distance = std::max(cvFloor(std::sqrt((double)candidates.size() / max_features)), 1);
+      for (;; distance++)
+      {
+        selected.clear();
+        const int d2 = distance * distance;
+        for (size_t k = 0; k < candidates.size(); k++)
+        {
+          bool keep = true;
+          for (size_t n = 0; n < selected.size() && keep; n++)
+          {
+            const int ddx = candidates[k].x - selected[n].x;
+            const int ddy = candidates[k].y - selected[n].y;
+            keep = ddx * ddx + ddy * ddy >= d2;
+          }
+          if (keep)
+            selected.push_back(candidates[k]);
+        }
+        if ((int)selected.size() <= max_features)
+          break;
+      }
+    }
+
+    std::mt19937 rng(0x5eed);
+    std::shuffle(selected.begin(), selected.end(), rng);
+
+    features.clear();
+    degrees.clear();
+    for (size_t k = 0; k < selected.size(); k++)
+    {
+      ShapeFeature f = { cvRound(selected[k].x - origin.x), cvRound(selected[k].y - origin.y),
+                         QuantizeOrientation(selected[k].degree, polarity_) };
+      features.push_back(f);
+      degrees.push_back(selected[k].degree);
+    }
+  }
+
+  ///
+  /// \brief    旋转、缩放特征点生成模板
+  ///
+  /// 图像坐标系y轴向下，逆时针旋转angle后梯度方向减小angle
+  ///
+  void BuildTemplate(const std::vector<ShapeFeature>& base, const std::vector<float>& degrees,
+                     double angle, double scale, ShapeTemplate& templ) const
+  {
+    const double c = std::cos(angle) * scale;
+    const double s = std::sin(angle) * scale;
+    const float rotation = (float)(angle * 180 / CV_PI);
+
+    templ.angle = angle;
+    templ.scale = scale;
+    templ.features.resize(base.size());
+
+    int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+    for (size_t k = 0; k < base.size(); k++)
+    {
+      ShapeFeature& f = templ.features[k];
+      f.x = cvRound(base[k].x * c + base[k].y * s);
+      f.y = cvRound(-base[k].x * s + base[k].y * c);
+
+      float degree = std::fmod(degrees[k] - rotation, 360.f);
+      if (degree < 0)
+        degree += 360.f;
+      f.label = QuantizeOrientation(degree, polarity_);
+
+      x0 = std::min(x0, f.x);
+      y0 = std::min(y0, f.y);
+      x1 = std::max(x1, f.x);
+      y1 = std::max(y1, f.y);
+    }
+    templ.bound = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+  }
+
+  ///
+  /// \brief    计算模板在(x, y)处的累加响应
+  /// \return   累加响应，越界或被贪婪判据终止时返回-1
+  ///
+  static int ScoreAt(const std::vector<cv::Mat>& responses, const ShapeTemplate& templ,
+                     int x, int y, double min_score, double greediness)
+  {
+    const cv::Mat& r0 = responses[0];
+    if (x + templ.bound.x < 0 || y + templ.bound.y < 0 ||
+        x + templ.bound.x + templ.bound.width > r0.cols ||
+        y + templ.bound.y + templ.bound.height > r0.rows)
+      return -1;
+
+    const int n = (int)templ.features.size();
+    // Halcon's termination criterion, safe part weighted by the greediness
+    const double f = greediness >= 1 ? 1e9 : (1 - greediness * min_score) / (1 - greediness);
+    const double norm = 1.0 / (kShapeMaxResponse * (double)n);
+
+    int sum = 0;
+    for (int k = 0; k < n; k++)
+    {
+      const ShapeFeature& feature = templ.features[k];
+      sum += responses[feature.label].ptr<uchar>(y + feature.y)[x + feature.x];
+
+      if ((k & 7) == 7 && min_score > 0)
+      {
+        const double j = (k + 1.0) / n;
+        if (sum * norm < std::min(min_score - 1 + f * j, min_score * j))
+          return -1;
+      }
+    }
+    return sum;
+  }
+
+  static double Normalize(const ShapeTemplate& templ, int sum)
+  {
+    return sum / (double)(kShapeMaxResponse * templ.features.size());
+  }
+
+  class TopLevelRunner : public cv::ParallelLoopBody
+  {
+  public:
+    TopLevelRunner(const Level& _level, const std::vector<cv::Mat>& _responses,
+                   const std::vector<int>& _indices, double _min_score,
+                   std::vector<std::vector<ShapeCandidate> >& _found)
+      : level(_level), responses(_responses), indices(_indices),
+        min_score(_min_score), found(_found)
+    { }
+
+    void operator () (const cv::Range& range) const CV_OVERRIDE
+    {
+      const int width = responses[0].cols;
+      const int height = responses[0].rows;
+      cv::Mat acc;
+
+      for (int t = range.start; t < range.end; t++)
+      {
+        const ShapeTemplate& templ = level.templates[indices[t]];
+        const int x0 = -templ.bound.x;
+        const int y0 = -templ.bound.y;
+        const int cols = width - templ.bound.width + 1;
+        const int rows = height - templ.bound.height + 1;
+        if (cols <= 0 || rows <= 0 || templ.features.empty())
+          continue;
+
+        // Dense accumulation over all positions, one feature at a time
+        acc.create(rows, cols, CV_16UC1);
+        acc.setTo(cv::Scalar::all(0));
+        for (size_t k = 0; k < templ.features.size(); k++)
+        {
+          const ShapeFeature& f = templ.features[k];
+          for (int i = 0; i < rows; i++)
+          {
+            const uchar* src = responses[f.label].ptr<uchar>(y0 + i + f.y) + x0 + f.x;
+            ushort* dst = acc.ptr<ushort>(i);
+            int j = 0;
+#if CV_SIMD128
+            for (; j <= cols - 16; j += 16)
+            {
+              cv::v_uint16x8 lo, hi;
+              cv::v_expand(cv::v_load(src + j), lo, hi);
+              cv::v_store(dst + j, cv::v_load(dst + j) + lo);
+              cv::v_store(dst + j + 8, cv::v_load(dst + j + 8) + hi);
+            }
+#endif
+            for (; j < cols; j++)
+              dst[j] = (ushort)(dst[j] + src[j]);
+          }
+        }
+
+        const int threshold = std::max(
+          cvCeil(min_score * kShapeMaxResponse * templ.features.size()), 1);
+        std::vector<ShapeCandidate>& out = found[t];
+        for (int i = 0; i < rows; i++)
+        {
+          const ushort* a = acc.ptr<ushort>(i);
+          for (int j = 0; j < cols; j++)
+          {
+            const int v = a[j];
+            if (v < threshold || !IsLocalMax(acc, i, j))
+              continue;
+            ShapeCandidate c = { x0 + j, y0 + i, indices[t], Normalize(templ, v) };
+            out.push_back(c);
+          }
+        }
+      }
+    }
+
+  private:
+    static bool IsLocalMax(const cv::Mat& acc, int i, int j)
+    {
+      const ushort v = acc.ptr<ushort>(i)[j];
+      for (int di = -1; di <= 1; di++)
+      {
+        const int r = i + di;
+        if (r < 0 || r >= acc.rows)
+          continue;
+        const ushort* a = acc.ptr<ushort>(r);
+        for (int dj = -1; dj <= 1; dj++)
+        {
+          const int c = j + dj;
+          if (c < 0 || c >= acc.cols || (di == 0 && dj == 0))
+            continue;
+          // Break plateaus towards the top-left neighbour
+          if (a[c] > v || (a[c] == v && (di < 0 || (di == 0 && dj < 0))))
+            return false;
+        }
+      }
+      return true;
+    }
+
+    const Level& level;
+    const std::vector<cv::Mat>& responses;
+    const std::vector<int>& indices;
+    double min_score;
+    std::vector<std::vector<ShapeCandidate> >& found;
+  };
+
+  static std::vector<ShapeCandidate> SearchTopLevel(const Level& level,
+                                                    const std::vector<cv::Mat>& responses,
+                                                    const SearchRange& search)
+  {
+    std::vector<int> indices;
+    for (int s = 0; s < level.num_scales; s++)
+    {
+      const double scale = level.scale_start + s * level.scale_step;
+      if (scale < search.scale_min - level.scale_step / 2 ||
+          scale > search.scale_max + level.scale_step / 2)
+        continue;
+      for (int a = 0; a < level.num_angles; a++)
+      {
+        const double angle = level.angle_start + a * level.angle_step;
+        if (AngleInRange(angle + level.angle_step / 2, search.angle_start,
+                         search.angle_extent + level.angle_step))
+          indices.push_back(s * level.num_angles + a);
+      }
+    }
+
+    std::vector<std::vector<ShapeCandidate> > found(indices.size());
+    cv::parallel_for_(cv::Range(0, (int)indices.size()),
+                      TopLevelRunner(level, responses, indices, search.min_score, found));
+
+    std::vector<ShapeCandidate> candidates;
+    for (size_t t = 0; t < found.size(); t++)
+      candidates.insert(candidates.end(), found[t].begin(), found[t].end());
+    return candidates;
+  }
+
+  ///
+  /// \brief    按分数排序，去除距离更好候选过近的候选，并截断数量
+  ///
+  static void SuppressCandidates(std::vector<ShapeCandidate>& candidates, int radius,
+                                 size_t max_count)
+  {
+    std::sort(candidates.begin(), candidates.end(),
+              [](const ShapeCandidate& a, const ShapeCandidate& b) { return a.score > b.score; });
+
+    std::vector<ShapeCandidate> kept;
+    const int r2 = radius * radius;
+    for (size_t k = 0; k < candidates.size() && kept.size() < max_count; k++)
+    {
+      bool keep = true;
+      for (size_t n = 0; n < kept.size() && keep; n++)
+      {
+        const int dx = candidates[k].x - kept[n].x;
+        const int dy = candidates[k].y - kept[n].y;
+        keep = dx * dx + dy * dy > r2;
+      }
+      if (keep)
+        kept.push_back(candidates[k]);
+    }
+    candidates.swap(kept);
+  }
+
+  class RefineRunner : public cv::ParallelLoopBody
+  {
+  public:
+    RefineRunner(const Level& _lower, const Level& _upper, const std::vector<cv::Mat>& _responses,
+                 const std::vector<ShapeCandidate>& _candidates, const SearchRange& _search,
+                 std::vector<ShapeCandidate>& _refined)
+      : lower(_lower), upper(_upper), responses(_responses), candidates(_candidates),
+        search(_search), refined(_refined)
+    { }
+
+    void operator () (const cv::Range& range) const CV_OVERRIDE
+    {
+      const int ka = std::max(cvCeil(upper.angle_step / lower.angle_step - 1e-9), 1);
+      const int ks = std::max(cvCeil(upper.scale_step / lower.scale_step - 1e-9), 1);
+
+      for (int n = range.start; n < range.end; n++)
+      {
+        const ShapeCandidate& c = candidates[n];
+        const ShapeTemplate& coarse = upper.templates[c.index];
+        const int ca = cvRound((coarse.angle - lower.angle_start) / lower.angle_step);
+        const int cs = cvRound((coarse.scale - lower.scale_start) / lower.scale_step);
+
+        ShapeCandidate best = { 0, 0, -1, -1 };
+        for (int s = std::max(cs - ks, 0); s <= std::min(cs + ks, lower.num_scales - 1); s++)
+        {
+          const double scale = lower.scale_start + s * lower.scale_step;
+          if (scale < search.scale_min - 1e-9 || scale > search.scale_max + 1e-9)
+            continue;
+          for (int da = -ka; da <= ka; da++)
+          {
+            int a = ca + da;
+            if (lower.full_circle)
+              a = (a % lower.num_angles + lower.num_angles) % lower.num_angles;
+            else if (a < 0 || a >= lower.num_angles)
+              continue;
+
+            const double angle = lower.angle_start + a * lower.angle_step;
+            if (!AngleInRange(angle, search.angle_start, search.angle_extent))
+              continue;
+
+            const ShapeTemplate& templ = lower.templates[(size_t)s * lower.num_angles + a];
+            for (int y = 2 * c.y - 2; y <= 2 * c.y + 2; y++)
+            {
+              for (int x = 2 * c.x - 2; x <= 2 * c.x + 2; x++)
+              {
+                const int sum = ScoreAt(responses, templ, x, y, search.min_score,
+                                        search.greediness);
+                if (sum < 0)
+                  continue;
+                const double score = Normalize(templ, sum);
+                if (score > best.score)
+                {
+                  best.x = x;
+                  best.y = y;
+                  best.index = s * lower.num_angles + a;
+                  best.score = score;
+                }
+              }
+            }
+          }
+        }
+        refined[n] = best;
+      }
+    }
+
+  private:
+    const Level& lower;
+    const Level& upper;
+    const std::vector<cv::Mat>& responses;
+    const std::vector<ShapeCandidate>& candidates;
+    const SearchRange& search;
+    std::vector<ShapeCandidate>& refined;
+  };
+
+  static std::vector<ShapeCandidate> RefineCandidates(const Level& lower, const Level& upper,
+                                                      const std::vector<cv::Mat>& responses,
+                                                      const std::vector<ShapeCandidate>& candidates,
+                                                      const SearchRange& search)
+  {
+    std::vector<ShapeCandidate> refined(candidates.size());
+    cv::parallel_for_(cv::Range(0, (int)candidates.size()),
+                      RefineRunner(lower, upper, responses, candidates, search, refined));
+
+    std::vector<ShapeCandidate> kept;
+    for (size_t n = 0; n < refined.size(); n++)
+      if (refined[n].index >= 0 && refined[n].score >= search.min_score)
+        kept.push_back(refined[n]);
+    SuppressCandidates(kept, 1, kept.size());
+    return kept;
+  }
+
+  ///
+  /// \brief    抛物线拟合三点极值位置的偏移量
+  ///
+  static double ParabolaOffset(double left, double center, double right)
+  {
+    const double denom = left - 2 * center + right;
+    if (denom >= 0)
+      return 0;
+    return std::min(std::max(0.5 * (left - right) / denom, -0.5), 0.5);
+  }
+
+  double ScoreOrZero(const std::vector<cv::Mat>& responses, const ShapeTemplate& templ,
+                     int x, int y) const
+  {
+    const int sum = ScoreAt(responses, templ, x, y, 0, 0);
+    return sum < 0 ? 0 : Normalize(templ, sum);
+  }
+
+  ///
+  /// \brief    计算结果的包围框（外接旋转矩形）
+  ///
+  cv::RotatedRect MatchBox(const ShapeMatch& match) const
+  {
+    const double cx = bound_.x + (bound_.width - 1) * 0.5 - origin_.x;
+    const double cy = bound_.y + (bound_.height - 1) * 0.5 - origin_.y;
+    const double c = std::cos(match.angle) * match.scale;
+    const double s = std::sin(match.angle) * match.scale;
+    const cv::Point2f center((float)(match.column + cx * c + cy * s),
+                             (float)(match.row - cx * s + cy * c));
+    const cv::Size2f size((float)(bound_.width * match.scale), (float)(bound_.height * match.scale));
+    return cv::RotatedRect(center, size, (float)(-match.angle * 180 / CV_PI));
+  }
+
+  double Overlap(const ShapeMatch& a, const ShapeMatch& b) const
+  {
+    const cv::RotatedRect ra = MatchBox(a);
+    const cv::RotatedRect rb = MatchBox(b);
+    std::vector<cv::Point2f> region;
+    if (cv::rotatedRectangleIntersection(ra, rb, region) == cv::INTERSECT_NONE || region.size() < 3)
+      return 0;
+    const double area = std::min(ra.size.area(), rb.size.area());
+    return area > 0 ? cv::contourArea(region) / area : 0;
+  }
+
+  std::vector<ShapeMatch> CollectMatches(const Level& level, const std::vector<cv::Mat>& responses,
+                                         const std::vector<ShapeCandidate>& candidates,
+                                         int num_matches, double max_overlap, bool subpixel) const
+  {
+    std::vector<ShapeMatch> matches;
+    for (size_t n = 0; n < candidates.size(); n++)
+    {
+      const ShapeCandidate& c = candidates[n];
+      const ShapeTemplate& templ = level.templates[c.index];
+
+      ShapeMatch m = { (double)c.y, (double)c.x, templ.angle, templ.scale, c.score };
+      if (subpixel)
+      {
+        m.column += ParabolaOffset(ScoreOrZero(responses, templ, c.x - 1, c.y), c.score,
+                                   ScoreOrZero(responses, templ, c.x + 1, c.y));
+        m.row += ParabolaOffset(ScoreOrZero(responses, templ, c.x, c.y - 1), c.score,
+                                ScoreOrZero(responses, templ, c.x, c.y + 1));
+
+        const int a = c.index % level.num_angles;
+        const int s = c.index / level.num_angles;
+        if (level.full_circle || (a > 0 && a < level.num_angles - 1))
+        {
+          const int prev = (a + level.num_angles - 1) % level.num_angles;
+          const int next = (a + 1) % level.num_angles;
+          const double left = ScoreOrZero(responses, level.templates[(size_t)s * level.num_angles + prev], c.x, c.y);
+          const double right = ScoreOrZero(responses, level.templates[(size_t)s * level.num_angles + next], c.x, c.y);
+          m.angle += ParabolaOffset(left, c.score, right) * level.angle_step;
+        }
+      }
+      matches.push_back(m);
+    }
+
+    std::sort(matches.begin(), matches.end(),
+              [](const ShapeMatch& a, const ShapeMatch& b) { return a.score > b.score; });
+
+    std::vector<ShapeMatch> kept;
+    for (size_t n = 0; n < matches.size(); n++)
+    {
+      if (num_matches > 0 && (int)kept.size() >= num_matches)
+        break;
+      bool keep = true;
+      for (size_t k = 0; k < kept.size() && keep; k++)
+        keep = Overlap(matches[n], kept[k]) <= max_overlap;
+      if (keep)
+        kept.push_back(matches[n]);
+    }
+    return kept;
+  }
+
+  std::vector<Level> levels_;   ///< 各层金字塔的模板
+  cv::Point2d origin_;          ///< 参考点
+  cv::Rect bound_;              ///< 模板区域包围框
+  bool polarity_;               ///< 是否区分极性
+  int min_contrast_;            ///< 搜索时的最小对比度
+};
+
+} // my_cv
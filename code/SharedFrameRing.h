@@ -0,0 +1,410 @@
+﻿///*****************************************************************************
+///
+/// \file       SharedFrameRing.h
+/// \brief      进程间共享内存图像环形缓冲
+///
+///             一个生产者（采集进程）把图像写入共享内存中的若干槽，多个消费者（检测
+///             进程、界面进程）按序号直接引用槽中的像素，不经过套接字复制。每个槽的
+///             占用计数用原子操作维护：生产者只写入没有消费者占用的槽，所有槽都被
+///             占用时丢弃该帧而不等待；消费者占用槽期间该帧不会被覆盖。槽内布局与
+///             .simg文件相同
+///
+///             消费者进程异常退出时其占用的槽不会释放，需重建环形缓冲。同名环形缓冲
+///             已存在时Create失败，不会破坏正在使用的缓冲
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "RawImageFile.h"
+
+namespace my_cv {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Shared-memory sequencing needs lock-free atomics");
+
+///
+/// \brief 命名共享内存，创建者析构时删除名称
+///
+class SharedMemory
+{
+public:
+  ///
+  /// \brief    创建共享内存，名称已存在时返回空指针，不会截断或重新初始化正在使用的内存
+  ///
+  static std::shared_ptr<SharedMemory> Create(const std::string& name, const size_t size)
+  {
+    std::shared_ptr<SharedMemory> memory(new SharedMemory());
+#ifdef _WIN32
+    memory->mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                          (DWORD)((uint64_t)size >> 32), (DWORD)size,
+                                          name.c_str());
+    if (memory->mapping_ == NULL || GetLastError() == ERROR_ALREADY_EXISTS)
+      return std::shared_ptr<SharedMemory>();
+    memory->data_ = (uchar*)MapViewOfFile(memory->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+#else
+    memory->name_ = "/" + name;
+    const int fd = shm_open(memory->name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+      return std::shared_ptr<SharedMemory>();
+    memory->owner_ = true;
+    if (ftruncate(fd, (off_t)size) == 0)
+    {
+      void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      memory->data_ = p == MAP_FAILED ? NULL : (uchar*)p;
+    }
+    close(fd);
+#endif
+    memory->size_ = size;
+    return memory->data_ ? memory : std::shared_ptr<SharedMemory>();
+  }
+
+  static std::shared_ptr<SharedMemory> Open(const std::string& name)
+  {
+    std::shared_ptr<SharedMemory> memory(new SharedMemory());
+#ifdef _WIN32
+    memory->mapping_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (memory->mapping_ == NULL)
+      return std::shared_ptr<SharedMemory>();
+    memory->data_ = (uchar*)MapViewOfFile(memory->mapping_, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (memory->data_ && VirtualQuery(memory->data_, &info, sizeof(info)) != 0)
+      memory->size_ = info.RegionSize;
+#else
+    const int fd = shm_open(("/" + name).c_str(), O_RDWR, 0600);
+    if (fd < 0)
+      return std::shared_ptr<SharedMemory>();
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      memory->data_ = p == MAP_FAILED ? NULL : (uchar*)p;
+      memory->size_ = (size_t)st.st_size;
+    }
+    close(fd);
+#endif
+    return memory->data_ ? memory : std::shared_ptr<SharedMemory>();
+  }
+
+  ///
+  /// \brief    删除异常退出的进程遗留的名称，已映射的进程不受影响
+  ///
+  /// Windows下名称随最后一个句柄关闭而消失，无需删除，总是返回false
+  ///
+  static bool Remove(const std::string& name)
+  {
+#ifdef _WIN32
+    (void)name;
+    return false;
+#else
+    return shm_unlink(("/" + name).c_str()) == 0;
+#endif
+  }
+
+  ~SharedMemory()
+  {
+#ifdef _WIN32
+    if (data_)
+      UnmapViewOfFile(data_);
+    if (mapping_)
+      CloseHandle(mapping_);
+#else
+    if (data_)
+      munmap(data_, size_);
+    if (owner_)
+      shm_unlink(name_.c_str());
+#endif
+  }
+
+  uchar* Data() const { return data_; }
+  size_t Size() const { return size_; }
+
+private:
+  SharedMemory()
+    : data_(NULL), size_(0)
+#ifdef _WIN32
+    , mapping_(NULL)
+#else
+    , owner_(false)
+#endif
+  { }
+
+  SharedMemory(const SharedMemory&);
+  SharedMemory& operator=(const SharedMemory&);
+
+  uchar* data_;
+  size_t size_;
+#ifdef _WIN32
+  HANDLE mapping_;
+#else
+  std::string name_;
+  bool owner_;
+#endif
+};
+
+///
+/// \brief 共享内存开头的环形缓冲头
+///
+struct FrameRingHeader
+{
+  std::atomic<uint32_t> ready;      ///< 初始化完成后为kFrameRingMagic
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t reserved;
+  uint64_t slot_bytes;              ///< 每个槽的数据字节数
+  std::atomic<uint64_t> published;  ///< 最新一帧的序号，0表示还没有帧
+  std::atomic<uint64_t> dropped;    ///< 因所有槽都被占用而丢弃的帧数
+  uint8_t padding[24];
+};
+
+///
+/// \brief 每个槽的头，之后是槽数据
+///
+struct FrameSlotHeader
+{
+  std::atomic<uint64_t> sequence;  ///< 槽中帧的序号，0表示正在写入或为空
+  std::atomic<uint32_t> pins;      ///< 消费者占用数，kFrameSlotWriter位表示生产者正在写入
+  uint8_t padding[52];
+};
+
+static_assert(sizeof(FrameRingHeader) == 64 && sizeof(FrameSlotHeader) == 64,
+              "Ring headers must be one cache line");
+
+static const uint32_t kFrameRingMagic = 0x474e5253;  // "SRNG"
+static const uint32_t kFrameSlotWriter = 0x80000000u;
+
+///
+/// \brief 消费者对一个槽的占用，析构时释放，同时保持共享内存映射
+///
+class FrameSlotPin
+{
+public:
+  FrameSlotPin(const std::shared_ptr<SharedMemory>& _memory, FrameSlotHeader* _slot)
+    : memory(_memory), slot(_slot)
+  { }
+
+  ~FrameSlotPin() { slot->pins.fetch_sub(1, std::memory_order_release); }
+
+private:
+  FrameSlotPin(const FrameSlotPin&);
+  FrameSlotPin& operator=(const FrameSlotPin&);
+
+  std::shared_ptr<SharedMemory> memory;
+  FrameSlotHeader* slot;
+};
+
+///
+/// \brief 单生产者多消费者的共享内存图像环形缓冲
+///
+class SharedFrameRing
+{
+public:
+  ///
+  /// \brief    生产者创建环形缓冲
+  /// \param    [in]  name        共享内存名称
+  /// \param    [in]  slot_count  槽数，应大于同时占用帧的消费者数
+  /// \param    [in]  max_size    最大图像尺寸
+  /// \param    [in]  max_type    最大图像类型，决定每个槽的字节数
+  /// \return   同名环形缓冲已存在时返回空指针，上次运行遗留的名称需先用Remove删除
+  ///
+  static std::shared_ptr<SharedFrameRing> Create(const std::string& name, const int slot_count,
+                                                 const cv::Size& max_size, const int max_type)
+  {
+    CV_Assert(slot_count >= 2);
+    const uint64_t slot_bytes = AlignRawImage((size_t)RawImageBytes(
+                                  MakeRawImageHeader(max_size, max_type, 0)));
+    const size_t total = sizeof(FrameRingHeader) +
+                         (size_t)slot_count * (sizeof(FrameSlotHeader) + slot_bytes);
+    std::shared_ptr<SharedMemory> memory = SharedMemory::Create(name, total);
+    if (!memory)
+      return std::shared_ptr<SharedFrameRing>();
+
+    FrameRingHeader* header = new (memory->Data()) FrameRingHeader();
+    header->version = 1;
+    header->slot_count = slot_count;
+    header->slot_bytes = slot_bytes;
+    header->published.store(0);
+    header->dropped.store(0);
+    std::shared_ptr<SharedFrameRing> ring(new SharedFrameRing(memory));
+    for (int k = 0; k < slot_count; k++)
+    {
+      FrameSlotHeader* slot = new (ring->Slot(k)) FrameSlotHeader();
+      slot->sequence.store(0);
+      slot->pins.store(0);
+    }
+    header->ready.store(kFrameRingMagic, std::memory_order_release);
+    return ring;
+  }
+
+  ///
+  /// \brief    删除名称以便重新创建，仍在使用旧环形缓冲的进程继续引用原来的内存
+  ///
+  static bool Remove(const std::string& name)
+  {
+    return SharedMemory::Remove(name);
+  }
+
+  ///
+  /// \brief    消费者打开已创建的环形缓冲，不存在或未初始化完成时返回空指针
+  ///
+  static std::shared_ptr<SharedFrameRing> Open(const std::string& name)
+  {
+    std::shared_ptr<SharedMemory> memory = SharedMemory::Open(name);
+    if (!memory || memory->Size() < sizeof(FrameRingHeader))
+      return std::shared_ptr<SharedFrameRing>();
+    const FrameRingHeader* header = (const FrameRingHeader*)memory->Data();
+    if (header->ready.load(std::memory_order_acquire) != kFrameRingMagic || header->version != 1)
+      return std::shared_ptr<SharedFrameRing>();
+    return std::shared_ptr<SharedFrameRing>(new SharedFrameRing(memory));
+  }
+
+  ///
+  /// \brief    生产者占用一个空闲槽并返回可写入像素的图像，之后必须调用EndWrite
+  ///
+  /// 相机可直接采集到返回的图像中；没有空闲槽或图像过大时返回空图像，该帧计为丢弃
+  ///
+  cv::Mat BeginWrite(const cv::Size& size, const int type)
+  {
+    CV_Assert(writing_ < 0);
+    const RawImageHeader image_header = MakeRawImageHeader(size, type, 0);
+    if (RawImageBytes(image_header) > Header()->slot_bytes)
+      CV_Error(cv::Error::StsOutOfRange, "Frame does not fit into a ring slot");
+
+    const int n = (int)Header()->slot_count;
+    for (int k = 1; k <= n; k++)
+    {
+      const int s = (last_slot_ + k) % n;
+      FrameSlotHeader* slot = Slot(s);
+      uint32_t expected = 0;
+      if (!slot->pins.compare_exchange_strong(expected, kFrameSlotWriter,
+                                              std::memory_order_acquire))
+        continue;
+      slot->sequence.store(0, std::memory_order_release);
+      std::memcpy(SlotData(s), &image_header, sizeof(image_header));
+      writing_ = s;
+      return cv::Mat(size, type, SlotData(s) + image_header.data_offset,
+                     (size_t)image_header.step);
+    }
+    Header()->dropped.fetch_add(1, std::memory_order_relaxed);
+    return cv::Mat();
+  }
+
+  ///
+  /// \brief    发布BeginWrite写入的帧
+  /// \return   帧序号
+  ///
+  uint64_t EndWrite()
+  {
+    CV_Assert(writing_ >= 0);
+    FrameSlotHeader* slot = Slot(writing_);
+    const uint64_t sequence = Header()->published.load(std::memory_order_relaxed) + 1;
+    slot->sequence.store(sequence, std::memory_order_release);
+    slot->pins.fetch_sub(kFrameSlotWriter, std::memory_order_release);
+    Header()->published.store(sequence, std::memory_order_release);
+    last_slot_ = writing_;
+    writing_ = -1;
+    return sequence;
+  }
+
+  ///
+  /// \brief    复制图像到空闲槽并发布
+  /// \return   帧序号，没有空闲槽时为0
+  ///
+  uint64_t Publish(const cv::Mat& image)
+  {
+    cv::Mat slot = BeginWrite(image.size(), image.type());
+    if (slot.empty())
+      return 0;
+    image.copyTo(slot);
+    return EndWrite();
+  }
+
+  ///
+  /// \brief    最新一帧的序号，0表示还没有帧
+  ///
+  uint64_t LatestSequence() const
+  {
+    return Header()->published.load(std::memory_order_acquire);
+  }
+
+  uint64_t DroppedFrames() const
+  {
+    return Header()->dropped.load(std::memory_order_relaxed);
+  }
+
+  ///
+  /// \brief    消费者占用序号为sequence的帧
+  /// \param    [out] image  引用槽中像素的图像
+  /// \param    [out] pin    占用，释放前该帧不会被覆盖
+  /// \return   该帧已被覆盖或尚未发布时返回false
+  ///
+  bool Acquire(const uint64_t sequence, cv::Mat& image, std::shared_ptr<const void>& pin) const
+  {
+    if (sequence == 0)
+      return false;
+    for (int s = 0; s < (int)Header()->slot_count; s++)
+    {
+      FrameSlotHeader* slot = Slot(s);
+      if (slot->sequence.load(std::memory_order_acquire) != sequence)
+        continue;
+      // Pin first, then confirm that the producer did not take the slot in between
+      const uint32_t pins = slot->pins.fetch_add(1, std::memory_order_acq_rel);
+      if ((pins & kFrameSlotWriter) != 0 ||
+          slot->sequence.load(std::memory_order_acquire) != sequence)
+      {
+        slot->pins.fetch_sub(1, std::memory_order_release);
+        return false;
+      }
+      pin = std::make_shared<FrameSlotPin>(memory_, slot);
+      return ViewRawImage(SlotData(s), (size_t)Header()->slot_bytes, image, NULL);
+    }
+    return false;
+  }
+
+private:
+  explicit SharedFrameRing(const std::shared_ptr<SharedMemory>& memory)
+    : memory_(memory), writing_(-1), last_slot_(-1)
+  { }
+
+  FrameRingHeader* Header() const { return (FrameRingHeader*)memory_->Data(); }
+
+  FrameSlotHeader* Slot(const int s) const
+  {
+    return (FrameSlotHeader*)(memory_->Data() + sizeof(FrameRingHeader) +
+                              (size_t)s * (sizeof(FrameSlotHeader) + Header()->slot_bytes));
+  }
+
+  uchar* SlotData(const int s) const { return (uchar*)Slot(s) + sizeof(FrameSlotHeader); }
+
+  std::shared_ptr<SharedMemory> memory_;
+  int writing_;    ///< Slot between BeginWrite and EndWrite, producer only
+  int last_slot_;  ///< Producer only
+};
+
+} // my_cv
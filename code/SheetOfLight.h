@@ -0,0 +1,282 @@
+﻿///*****************************************************************************
+///
+/// \file       SheetOfLight.h
+/// \brief      激光三角测量的光条中心提取
+///
+///             激光线大致沿图像行方向，逐列在行范围内找灰度最大的行，再用重心法或
+///             三点高斯拟合求亚像素中心，得到一条轮廓。找最大值时按行遍历图像，
+///             同时更新一行中所有列的最大值和所在行，可用SIMD一次处理多列。连续的
+///             轮廓按行累积为视差图（浮点或16位定点）和灰度图，对应Halcon的
+///             MeasureProfileSheetOfLight
+///
+/// \author     诸佳琪/zhujiaqi@jsjd.cc
+/// \version    V1.0
+/// \date       2026-10-19
+/// \copyright  杭州中为光电技术有限公司
+///
+///*****************************************************************************
+
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace my_cv {
+
+enum LaserSubpixel
+{
+  kLaserCenterOfGravity,
+  kLaserGaussian
+};
+
+static LaserSubpixel ParseLaserSubpixel(const std::string& Method)
+{
+  if (Method == "center_of_gravity")
+    return kLaserCenterOfGravity;
+  if (Method == "gaussian")
+    return kLaserGaussian;
+  CV_Error(cv::Error::StsBadArg, "Unsupported subpixel method: " + Method);
+}
+
+struct SheetOfLightParams
+{
+  SheetOfLightParams()
+    : min_gray(100), row1(0), row2(-1), window(3), method(kLaserCenterOfGravity)
+  { }
+
+  int min_gray;           ///< 峰值灰度低于它的列没有光条
+  int row1;               ///< 搜索的行范围[row1, row2]，row2为负数时到最后一行
+  int row2;
+  int window;             ///< 重心法使用峰值上下各window行
+  LaserSubpixel method;
+};
+
+///
+/// \brief    由峰值行和灰度计算亚像素行，没有光条时返回NaN
+///
+template <typename T>
+static float LaserSubpixelRow(const cv::Mat& image, const int j, const int peak_row,
+                              const int peak, const int row1, const int row2,
+                              const SheetOfLightParams& params)
+{
+  if (peak < params.min_gray)
+    return std::numeric_limits<float>::quiet_NaN();
+
+  if (params.method == kLaserGaussian)
+  {
+    if (peak_row <= row1 || peak_row >= row2)
+      return (float)peak_row;
+    const double a = std::log(std::max<double>(image.ptr<T>(peak_row - 1)[j], 1));
+    const double b = std::log(std::max<double>(peak, 1));
+    const double c = std::log(std::max<double>(image.ptr<T>(peak_row + 1)[j], 1));
+    const double denom = a - 2 * b + c;
+    return denom < 0 ? (float)(peak_row + 0.5 * (a - c) / denom) : (float)peak_row;
+  }
+
+  // Weights are the gray values above the threshold
+  double sum = 0, moment = 0;
+  const int lo = std::max(row1, peak_row - params.window);
+  const int hi = std::min(row2, peak_row + params.window);
+  for (int i = lo; i <= hi; i++)
+  {
+    const int w = (int)image.ptr<T>(i)[j] - params.min_gray;
+    if (w > 0)
+    {
+      sum += w;
+      moment += (double)w * i;
+    }
+  }
+  return sum > 0 ? (float)(moment / sum) : (float)peak_row;
+}
+
+#if CV_SIMD128
+static inline cv::v_uint16x8 LoadLaserRow(const uchar* p) { return cv::v_load_expand(p); }
+static inline cv::v_uint16x8 LoadLaserRow(const ushort* p) { return cv::v_load(p); }
+#endif
+
+///
+/// \brief    逐列求光条的亚像素行和峰值灰度，每个线程处理一段列
+///
+class LaserProfileRunner : public cv::ParallelLoopBody
+{
+public:
+  LaserProfileRunner(const cv::Mat& _image, const SheetOfLightParams& _params, float* _rows,
+                     float* _scores, const int _block_cols)
+    : image(_image), params(_params), rows(_rows), scores(_scores), block_cols(_block_cols)
+  { }
+
+  void operator () (const cv::Range& range) const CV_OVERRIDE
+  {
+    const int col0 = range.start * block_cols;
+    const int col1 = std::min(range.end * block_cols, image.cols);
+    if (image.depth() == CV_8U)
+      Measure<uchar>(col0, col1);
+    else
+      Measure<ushort>(col0, col1);
+  }
+
+private:
+  template <typename T>
+  void Measure(const int col0, const int col1) const
+  {
+    const int row1 = std::max(params.row1, 0);
+    const int row2 = params.row2 < 0 ? image.rows - 1 : std::min(params.row2, image.rows - 1);
+    const int n = col1 - col0;
+    std::vector<ushort> best(n, 0), best_row(n, (ushort)row1);
+
+    // Row by row over all columns of the block, the first maximum of each column wins
+    for (int i = row1; i <= row2; i++)
+    {
+      const T* src = image.ptr<T>(i) + col0;
+      int j = 0;
+#if CV_SIMD128
+      const cv::v_uint16x8 row_index = cv::v_setall_u16((ushort)i);
+      for (; j <= n - cv::v_uint16x8::nlanes; j += cv::v_uint16x8::nlanes)
+      {
+        const cv::v_uint16x8 v = LoadLaserRow(src + j);
+        const cv::v_uint16x8 b = cv::v_load(&best[j]);
+        const cv::v_uint16x8 greater = v > b;
+        cv::v_store(&best[j], cv::v_max(v, b));
+        cv::v_store(&best_row[j], cv::v_select(greater, row_index, cv::v_load(&best_row[j])));
+      }
+#endif
+      for (; j < n; j++)
+        if (src[j] > best[j])
+        {
+          best[j] = src[j];
+          best_row[j] = (ushort)i;
+        }
+    }
+
+    for (int j = 0; j < n; j++)
+    {
+      rows[col0 + j] = LaserSubpixelRow<T>(image, col0 + j, best_row[j], best[j], row1, row2,
+                                           params);
+      if (scores)
+        scores[col0 + j] = rows[col0 + j] == rows[col0 + j] ? (float)best[j] : 0.f;
+    }
+  }
+
+  const cv::Mat image;
+  const SheetOfLightParams params;
+  float* rows;
+  float* scores;
+  const int block_cols;
+};
+
+///
+/// \brief    提取一条激光轮廓
+/// \param    [out] rows    每列的亚像素行，没有光条为NaN
+/// \param    [out] scores  非NULL时输出每列的峰值灰度，没有光条为0
+///
+static void MeasureLaserProfile(const cv::Mat& image, const SheetOfLightParams& params,
+                                float* rows, float* scores)
+{
+  CV_Assert(image.type() == CV_8UC1 || image.type() == CV_16UC1);
+  CV_Assert(image.rows <= 65536 && params.window >= 0);
+
+  // Blocks are whole SIMD widths so that only the last block has a scalar tail
+  const int block_cols = 256;
+  const int nblocks = (image.cols + block_cols - 1) / block_cols;
+  const double total = (double)image.rows * image.cols;
+  cv::parallel_for_(cv::Range(0, nblocks),
+                    LaserProfileRunner(image, params, rows, scores, block_cols),
+                    std::min<double>(nblocks, total / (1 << 16)));
+}
+
+///
+/// \brief 光片模型：测量参数和累积的视差图
+///
+class SheetOfLightModel
+{
+public:
+  ///
+  /// \param    [in]  num_profiles    视差图的行数
+  /// \param    [in]  disparity_type  CV_32FC1时无效点为NaN；CV_16UC1时保存
+  ///                                 1 + round(行 * subpixel_scale)，无效点为0
+  ///
+  SheetOfLightModel(const SheetOfLightParams& params, const int num_profiles,
+                    const int disparity_type = CV_32FC1, const double subpixel_scale = 32)
+    : params_(params), num_profiles_(num_profiles), disparity_type_(disparity_type),
+      subpixel_scale_(subpixel_scale), count_(0)
+  {
+    CV_Assert(num_profiles > 0 && subpixel_scale > 0 &&
+              (disparity_type == CV_32FC1 || disparity_type == CV_16UC1));
+  }
+
+  const SheetOfLightParams& Params() const { return params_; }
+
+  ///
+  /// \brief    测量一条轮廓并写入视差图的下一行
+  /// \return   该轮廓的行号
+  ///
+  int Measure(const cv::Mat& image)
+  {
+    if (count_ >= num_profiles_)
+      CV_Error(cv::Error::StsOutOfRange, "Sheet-of-light model is full, call ResetProfile");
+    if (disparity_.empty() || disparity_.cols != image.cols)
+    {
+      CV_Assert(count_ == 0);
+      disparity_.create(num_profiles_, image.cols, disparity_type_);
+      score_.create(num_profiles_, image.cols, CV_32FC1);
+    }
+
+    float* scores = score_.ptr<float>(count_);
+    if (disparity_type_ == CV_32FC1)
+      MeasureLaserProfile(image, params_, disparity_.ptr<float>(count_), scores);
+    else
+    {
+      profile_.resize(image.cols);
+      MeasureLaserProfile(image, params_, &profile_[0], scores);
+      ushort* dst = disparity_.ptr<ushort>(count_);
+      for (int j = 0; j < image.cols; j++)
+        dst[j] = profile_[j] == profile_[j]
+                   ? cv::saturate_cast<ushort>(1 + profile_[j] * subpixel_scale_)
+                   : (ushort)0;
+    }
+    return count_++;
+  }
+
+  ///
+  /// \brief    清空已累积的轮廓
+  ///
+  void ResetProfile()
+  {
+    count_ = 0;
+  }
+
+  int ProfileCount() const { return count_; }
+
+  ///
+  /// \brief    已累积的视差图，每行一条轮廓
+  ///
+  cv::Mat Disparity() const
+  {
+    return count_ > 0 ? disparity_.rowRange(0, count_) : cv::Mat();
+  }
+
+  ///
+  /// \brief    已累积的峰值灰度图
+  ///
+  cv::Mat Score() const
+  {
+    return count_ > 0 ? score_.rowRange(0, count_) : cv::Mat();
+  }
+
+private:
+  const SheetOfLightParams params_;
+  const int num_profiles_;
+  const int disparity_type_;
+  const double subpixel_scale_;
+  cv::Mat disparity_;
+  cv::Mat score_;
+  std::vector<float> profile_;  ///< Float profile before fixed-point conversion
+  int count_;
+};
+
+} // my_cv